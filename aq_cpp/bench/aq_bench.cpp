@@ -0,0 +1,241 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <filesystem>
+#include <ctime>
+#include "polylog_port.hpp"
+#include "legendre_quadrature.hpp"
+#include "laguerre_singular_endpoint.hpp"
+#include "adaptive_gauss_tree.hpp"
+#include "adaptive_gauss_batch.hpp"
+#include "json_sax_loader.hpp"
+
+// Benchmark suite, built and run by `make bench`.
+//
+//   aq_bench [--reps N] [--json results.json] [--compare baseline.json] [--filter substring]
+//
+// Every case is timed N times (default 5) after one warm up run.  The report gives min / median / mean / stddev of
+// the wall time per repetition and the case's throughput (ns per integrand evaluation, nodes/s, trees/s or MB/s),
+// computed from the median.  --json writes the same numbers for diffing between releases; --compare prints the
+// change of every median against such a file.
+
+struct BenchResult {
+    std::string name;
+    int reps = 0;
+    double min_ms = 0, median_ms = 0, mean_ms = 0, stddev_ms = 0;
+    std::string rate_unit;   // "ns/eval", "nodes/s", "trees/s", "MB/s"
+    double rate = 0;
+};
+
+struct BenchContext {
+    int reps = 5;
+    std::string filter;
+    std::vector<BenchResult> results;
+};
+
+volatile double bench_sink = 0.0;   // keeps results alive so that nothing is optimized away
+
+// Times `body` and converts the median into a rate: `work` units per repetition, `per_time` = true for units/s
+// (nodes/s, MB/s), false for ns per unit (ns/eval).
+void run_case(BenchContext& ctx, const std::string& name, const std::string& rate_unit, const std::function<double()>& body,
+              const std::function<double()>& work, bool per_time) {
+    if (!ctx.filter.empty() && name.find(ctx.filter) == std::string::npos) return;
+    bench_sink = bench_sink + body();   // warm up (loads caches, first-touch allocations)
+    std::vector<double> times;
+    for (int i = 0; i < ctx.reps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        bench_sink = bench_sink + body();
+        auto stop = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    BenchResult r;
+    r.name = name;
+    r.reps = ctx.reps;
+    r.min_ms = times.front();
+    r.median_ms = times.size() % 2 ? times[times.size() / 2] : 0.5 * (times[times.size() / 2 - 1] + times[times.size() / 2]);
+    r.mean_ms = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+    double var = 0;
+    for (double t : times) var += (t - r.mean_ms) * (t - r.mean_ms);
+    r.stddev_ms = times.size() > 1 ? std::sqrt(var / (times.size() - 1)) : 0.0;
+    r.rate_unit = rate_unit;
+    double units = work();
+    r.rate = per_time ? units / (r.median_ms * 1e-3) : r.median_ms * 1e6 / units;
+    ctx.results.push_back(r);
+
+    std::cout << std::left << std::setw(44) << r.name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << r.median_ms << " ms  (min " << r.min_ms << ", sd " << r.stddev_ms << ")  "
+              << std::setprecision(r.rate < 100 ? 2 : 0) << r.rate << " " << r.rate_unit << std::endl;
+}
+
+double file_mb(const std::string& filename) {
+    return static_cast<double>(std::filesystem::file_size(filename)) / (1024.0 * 1024.0);
+}
+
+// --- integrands --------------------------------------------------------------------------------------------
+
+double smooth_integrand(ParamMap parameters, double t) {
+    double k = std::get<double>(parameters["k"]);
+    return std::cos(k * t) * std::exp(-t);
+}
+
+int main(int argc, char* argv[]) {
+    BenchContext ctx;
+    std::string json_file, compare_file;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--reps" && i + 1 < argc) ctx.reps = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--json" && i + 1 < argc) json_file = argv[++i];
+        else if (arg == "--compare" && i + 1 < argc) compare_file = argv[++i];
+        else if (arg == "--filter" && i + 1 < argc) ctx.filter = argv[++i];
+        else {
+            std::cerr << "usage: " << argv[0] << " [--reps N] [--json results.json] [--compare baseline.json] [--filter substring]" << std::endl;
+            return 2;
+        }
+    }
+
+    try {
+        const std::string legendre_file = "../model_json/legendre.json";
+        const std::string laguerre_file = "../model_json/laguerre.json";
+        const std::string polylogs_file = "../model_json/polylogs.json";
+        WeightsLoader legendre(legendre_file);
+        WeightsLoader laguerre(laguerre_file);
+        std::function<double(ParamMap, double)> polylog = polylog_wrapper;
+        ParamMap polylog_args{{"s", 3}, {"z", 0.5}};
+
+        // --- single node quadrature -------------------------------------------------------------------------
+        const int calls = 2000;
+        for (auto [n1, n2] : std::vector<std::pair<int, int>>{{10, 20}, {50, 100}, {100, 150}}) {
+            std::string orders = std::to_string(n1) + "/" + std::to_string(n2);
+            run_case(ctx, "node/legendre " + orders, "ns/eval", [&]() {
+                double sum = 0;
+                for (int i = 0; i < calls; ++i) {
+                    LegendreQuadrature q(legendre, n1, n2, 0.25, 0.5);
+                    sum += q.integrate(polylog, polylog_args);
+                }
+                return sum;
+            }, [&]() { return static_cast<double>(calls) * (n1 + n2); }, false);
+            run_case(ctx, "node/laguerre_endpoint " + orders, "ns/eval", [&]() {
+                double sum = 0;
+                for (int i = 0; i < calls; ++i) {
+                    LaguerreSingularEndpoint q(laguerre, n1, n2, 0.0, 0.25);
+                    sum += q.integrate(polylog, polylog_args);
+                }
+                return sum;
+            }, [&]() { return static_cast<double>(calls) * (n1 + n2); }, false);
+        }
+
+        // --- build_tree on representative integrands --------------------------------------------------------
+        struct TreeCase { std::string name; std::function<double(ParamMap, double)> func; ParamMap args; bool singular; };
+        std::vector<TreeCase> tree_cases = {
+            {"tree/smooth", smooth_integrand, {{"k", 20.0}}, false},
+            {"tree/log_singular s=4 z=0.5", polylog, {{"s", 4}, {"z", 0.5}}, true},
+            {"tree/near_pole s=2 z=0.999", polylog, {{"s", 2}, {"z", 0.999}}, true},
+        };
+        for (const auto& tc : tree_cases) {
+            size_t nodes = 0;
+            run_case(ctx, tc.name, "nodes/s", [&]() {
+                AdaptiveGaussTree tree(tc.func, 0.0, 1.0, 1e-14, 2, 20, 20, 40, 0.0, 0.0, tc.singular, false,
+                    legendre, legendre, laguerre, laguerre, tc.args);
+                nodes = tree.node_count();
+                return tree.get_integral_and_error().first;
+            }, [&]() { return static_cast<double>(nodes); }, true);
+        }
+
+        // --- batch construction -----------------------------------------------------------------------------
+        ParamCollection params;
+        params["s"] = std::vector<int>{2, 3, 4, 5, 6, 7, 8, 9, 10};
+        params["z"] = std::vector<double>{-1.0, -0.5, 0.1, 0.5, 0.9, 0.99, 1.0};
+        size_t batch_trees = 0;
+        run_case(ctx, "batch/construct 9x7 polylog", "trees/s", [&]() {
+            AdaptiveGaussTreeBatch batch(polylog, 0.0, 1.0, 1e-12, 2, 20, 100, 150, 0.0, 0.0, true, false,
+                legendre, legendre, laguerre, laguerre, params);
+            batch_trees = batch.getCollection().size();
+            return static_cast<double>(batch_trees);
+        }, [&]() { return static_cast<double>(batch_trees); }, true);
+
+        // --- WeightsLoader startup --------------------------------------------------------------------------
+        run_case(ctx, "weights/index laguerre.json", "MB/s", [&]() {
+            RuleIndex index(laguerre_file);   // bypasses the process-wide registry
+            return index.getRule(150)->nodes[0];
+        }, [&]() { return file_mb(laguerre_file); }, true);
+        run_case(ctx, "weights/eager laguerre.json", "MB/s", [&]() {
+            WeightsLoader loader;
+            JsonSaxLoader::load_weights(laguerre_file, loader);
+            return loader.getNodes(150)[0];
+        }, [&]() { return file_mb(laguerre_file); }, true);
+
+        // --- JSON save / load -------------------------------------------------------------------------------
+        AdaptiveGaussTreeBatch polylogs(polylog, polylogs_file);
+        run_case(ctx, "json/load polylogs.json", "MB/s", [&]() {
+            AdaptiveGaussTreeBatch batch(polylog, polylogs_file);
+            return static_cast<double>(batch.getCollection().size());
+        }, [&]() { return file_mb(polylogs_file); }, true);
+        run_case(ctx, "json/save full", "MB/s", [&]() {
+            polylogs.save_to_json("bench_full.json", true, false, false);
+            return 0.0;
+        }, [&]() { return file_mb("bench_full.json"); }, true);
+        run_case(ctx, "json/save compact", "MB/s", [&]() {
+            polylogs.save_to_json("bench_compact.json", true, false, false, true);
+            return 0.0;
+        }, [&]() { return file_mb("bench_compact.json"); }, true);
+        run_case(ctx, "json/load compact", "MB/s", [&]() {
+            AdaptiveGaussTreeBatch batch(polylog, "bench_compact.json");
+            return static_cast<double>(batch.getCollection().size());
+        }, [&]() { return file_mb("bench_compact.json"); }, true);
+        std::filesystem::remove("bench_full.json");
+        std::filesystem::remove("bench_compact.json");
+
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // --- machine readable output ----------------------------------------------------------------------------
+    json report;
+    std::time_t now = std::time(nullptr);
+    char timestamp[20];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+    report["timestamp"] = timestamp;
+#ifdef __VERSION__
+    report["compiler"] = __VERSION__;
+#endif
+    report["reps"] = ctx.reps;
+    report["results"] = json::array();
+    for (const auto& r : ctx.results) {
+        report["results"].push_back({{"name", r.name}, {"reps", r.reps}, {"min_ms", r.min_ms}, {"median_ms", r.median_ms},
+            {"mean_ms", r.mean_ms}, {"stddev_ms", r.stddev_ms}, {"rate", r.rate}, {"rate_unit", r.rate_unit}});
+    }
+    if (!json_file.empty()) {
+        std::ofstream(json_file) << report.dump(4) << std::endl;
+        std::cout << "\nwrote " << json_file << std::endl;
+    }
+
+    if (!compare_file.empty()) {
+        std::ifstream file(compare_file);
+        if (!file) {
+            std::cerr << "Error opening baseline: " << compare_file << std::endl;
+            return 1;
+        }
+        json baseline = json::parse(file);
+        std::cout << "\nchange of median against " << compare_file << " (negative = faster)\n";
+        for (const auto& r : ctx.results) {
+            for (const auto& old : baseline["results"]) {
+                if (old["name"] != r.name) continue;
+                double before = old["median_ms"].get<double>();
+                std::cout << std::left << std::setw(44) << r.name << std::right << std::showpos << std::fixed
+                          << std::setprecision(1) << std::setw(8) << 100.0 * (r.median_ms - before) / before << " %"
+                          << std::noshowpos << std::endl;
+            }
+        }
+    }
+    return 0;
+}
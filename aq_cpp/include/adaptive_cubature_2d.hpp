@@ -0,0 +1,120 @@
+#ifndef ADAPTIVE_CUBATURE_2D_HPP
+#define ADAPTIVE_CUBATURE_2D_HPP
+
+#include <quadrature.hpp>
+#include <weights_loader.hpp>
+#include <tree_stats.hpp>
+#include <nlohmann/json.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::ordered_json;
+
+// Integrand of AdaptiveCubature2D: f(parameters, x, y)
+using Integrand2D = std::function<double(const ParamMap&, double, double)>;
+
+// Edge of the rectangle with an integrable singularity, (distance to the edge)^-alpha.  The rectangles that touch it
+// use LaguerreSingularEndpoint across it, as AdaptiveGaussTree does at a singular endpoint.
+struct SingularEdge {
+    bool singular = false;
+    double alpha = 0.0;
+};
+
+struct SingularEdges {
+    SingularEdge x_lower, x_upper, y_lower, y_upper;
+};
+
+// Adaptive cubature of f(x, y) over the rectangle [ax, bx] x [ay, by].  Every rectangle is integrated by the tensor
+// products of the two 1D rules of each axis (Gauss-Legendre, or Gauss-Laguerre across a singular edge), all
+// evaluated on one grid of (n1 + n2)^2 points:
+//    result  = Q(n1 x n1),  error = |Q(n1 x n1) - Q(n2 x n2)|
+//    error_x = |Q(n1 x n1) - Q(n2 x n1)|,  error_y = |Q(n1 x n1) - Q(n1 x n2)|
+// A rectangle that misses its tolerance is bisected along the axis whose error dominates (by more than a factor 2),
+// otherwise into quarters; the children share the tolerance like the nodes of AdaptiveGaussTree (half or a quarter
+// each).  Unlike nested 1D trees, every point of a rectangle is evaluated once and nothing is rebuilt.
+class AdaptiveCubature2D {
+public:
+    AdaptiveCubature2D(
+        Integrand2D f,
+        double ax, double bx, double ay, double by, double tol, int minD, int maxD,
+        int n1, int n2,
+        SingularEdges edges,
+        WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2,
+        ParamMap args = {},
+        std::string name="Project", std::string author="Author",  std::string description="project description",
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Train",
+        Summation::Method summation = Summation::Method::Naive   // of the rule sums and the leaves (summation.hpp)
+    );
+
+    // Constructor from a file written by save_to_json
+    AdaptiveCubature2D(Integrand2D f, WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2,
+                       const std::string& filename, ParamMap args = {});
+
+    AdaptiveCubature2D(const AdaptiveCubature2D& other);
+
+    std::pair<double, double> get_integral_and_error() const;
+    std::size_t node_count() const;
+    // Leaves that miss their tolerance by round-off (compensated summation only); they are final, as in AdaptiveGaussTree
+    std::size_t roundoff_limited_leaves() const;
+    const TreeStats& get_stats() const { return stats; }
+
+    void add_update_log(const std::string& message);
+    void print_update_log() const;
+
+    // Same header as AdaptiveGaussTree::save_to_json, with "x", "y" and "singular_edges" in place of the interval
+    void save_to_json(const std::string& filename, bool overwrite = false, bool dump_log = false, bool write_stats = false) const;
+    void load_from_json(const std::string& filename);
+
+private:
+    struct Node {
+        double ax, bx, ay, by;
+        int depth;
+        double tolerance, result = 0.0, error = 0.0;
+        double error_x = 0.0, error_y = 0.0;   // build only: error of each axis rule
+        bool laguerre_x = false, laguerre_y = false;
+        bool roundoff_limited = false;         // not refined: error >= tolerance is round-off (Summation::roundoff)
+        std::string split;                     // "x", "y" or "xy" (quarters) when the node has children
+        std::vector<std::unique_ptr<Node>> children;
+
+        Node(double ax, double bx, double ay, double by, int depth, double tol)
+            : ax(ax), bx(bx), ay(ay), by(by), depth(depth), tolerance(tol) {}
+    };
+
+    // The quadrature of one axis of `node`: Gauss-Laguerre when it touches a singular edge of that axis
+    std::unique_ptr<Quadrature> axis_quadrature(double lower, double upper, double root_lower, double root_upper,
+                                                const SingularEdge& lower_edge, const SingularEdge& upper_edge) const;
+    void evaluate_node(Node* node);
+    void build();
+    void split_node(Node* node, const std::string& axes);
+
+    json serialize_tree(const Node* node) const;
+    std::unique_ptr<Node> deserialize_tree(const json& data) const;
+    static std::unique_ptr<Node> clone_tree(const Node* node);
+    static json edge_to_json(const SingularEdges& edges);
+    static SingularEdges edges_from_json(const json& data);
+
+    Integrand2D func;
+    double ax, bx, ay, by;
+    double tolerance;
+    int min_depth, max_depth;
+    int order1, order2;
+    SingularEdges edges;
+    WeightsLoader roots_legendre_n1, roots_legendre_n2, roots_laguerre_n1, roots_laguerre_n2;
+    ParamMap args;
+    Summation::Method summation = Summation::Method::Naive;
+    std::unique_ptr<Node> root;
+
+    // json header info
+    std::string name;
+    std::string reference;
+    std::string description;
+    std::string author;
+    std::string version;
+    std::vector<std::pair<std::string, std::string>> update_log;
+    TreeStats stats;
+};
+
+#endif // ADAPTIVE_CUBATURE_2D_HPP
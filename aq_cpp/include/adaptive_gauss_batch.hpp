@@ -3,6 +3,7 @@
 
 #include <weights_loader.hpp>
 #include <adaptive_gauss_tree.hpp>
+#include <trace.hpp>
 #include <nlohmann/json.hpp>
 #include <unordered_map>
 #include <vector>
@@ -13,13 +14,51 @@
 #include <functional>
 #include <algorithm>
 #include <set>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <chrono>
+#include <optional>
+#include <memory>
 
 
 using json = nlohmann::ordered_json;
 // using ParamMap = std::unordered_map<std::string, ParamType>
 // using ParamCollection = std::map<std::string, std::variant<std::vector<int>, std::vector<double>, std::vector<std::string>>>;
 // using QuadCollection = std::unordered_map<ParamMap, std::unique_ptr<AdaptiveGaussTree>, ParamMapHash, ParamMapEqual> 
+// Checkpointing of long batch builds.  `filename` holds the build settings and the partially built tree (rewritten 
+// at most every `interval` seconds); finished trees are appended to `filename + ".log"` (a batch log, see append_to_log).
+struct BatchCheckpoint {
+    std::string filename;
+    double interval = 60.0;
+};
+
+// State of a batch build, reported to BatchControl::progress.  evaluations counts the integrand calls of the trees
+// (their TreeStats, so 0 when built with -DAQ_STATS=0); worst_error is the largest error estimate of the finished trees.
+struct BatchProgress {
+    std::size_t trees_done = 0, trees_total = 0;
+    std::size_t evaluations = 0;
+    double worst_error = 0.0;
+};
+
+// Observation and bounds of a batch build.  `progress` is called on the building thread after every tree and, within 
+// a tree, at most every `progress_interval` seconds.  Setting *cancel stops the build: the constructor throws 
+// std::runtime_error.  At the deadline the tree under construction evaluates its pending nodes once and the trees not
+// yet started get their root only; these trees are flagged best effort (AdaptiveGaussTree::is_best_effort, 
+// best_effort_trees) and are not appended to a checkpoint log, so resuming the checkpoint rebuilds them.
+struct BatchControl {
+    std::function<void(const BatchProgress&)> progress;
+    double progress_interval = 1.0;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+};
+
+// Interior breakpoints of the tree for a parameter combination (e.g. a pole at 1/z); see Breakpoint
+using BreakpointFunction = std::function<std::vector<Breakpoint>(const ParamMap&)>;
+
 class AdaptiveGaussTreeBatch {
+    friend class JsonSaxLoader;   // single pass loader for batch files (json_sax_loader.hpp)
 private:
     QuadCollection quad_coll;
     std::function<double(ParamMap, double)> func;
@@ -27,6 +66,10 @@ private:
     double lower, upper;
     double alphaA, alphaB;
     int min_depth; int max_depth; int order1;int order2;
+    HpRefinement hp;   // max_order = 0: bisection only
+    SingularityDetection detect;
+    BreakpointFunction breakpoints;   // empty: none
+    Summation::Method summation = Summation::Method::Naive;   // of every tree (summation.hpp)
     bool a_singular; bool b_singular;
     WeightsLoader legendre_n1; WeightsLoader legendre_n2; WeightsLoader laguerre_n1; WeightsLoader laguerre_n2;
     ParamCollection parameters;
@@ -34,33 +77,45 @@ private:
     std::string reference; std::string version;         
     std::vector<ParamMap> results;
     std::vector<std::pair<std::string, std::string>> update_log;
+    std::map<std::string, std::size_t> logged;   // log file -> update_log entries already in it (append_to_log)
     std::vector<std::string> keys;
+    // vector-valued batches only: the integrand, and the parameter whose values are its components (func takes one)
+    VectorIntegrand vector_func;
+    std::string component_key;
+    std::vector<ParamType> component_values;
+    PointsIntegrand points_func;   // integrands evaluated a rule at a time only (func is its single_point form)
 
-    void generate_combinations(
+    static void generate_combinations(
         const std::vector<std::string>& keys,
         const ParamCollection& params,
         std::vector<size_t>& indices,
         std::vector<ParamMap>& results,
         size_t depth = 0
     );
-    void extract_keys(const json& param_json, std::set<std::string>& key_set, int depth = 0) ;
-    void extract_parameters(
-        const json& param_json, 
-        ParamCollection& parameters, 
-        std::optional<std::string> current_key = std::nullopt, 
-        bool expecting_value = false, 
-        std::map<std::string, std::set<int>> int_sets = {}, 
-        std::map<std::string, std::set<double>> double_sets = {}, 
-        std::map<std::string, std::set<std::string>> string_sets = {})  ;
-
-    const json& find_tree_json(const json& param_json, const ParamMap& param_map);     
 
-    void add_update_log(const std::string& message) {
-        std::time_t now = std::time(nullptr);
-        char timestamp[20];
-        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
-        update_log.emplace_back(timestamp, message);
-    }
+    // parameters and keys from the combinations in results, then build_trees (the constructors from combinations)
+    void build_combinations(const std::string& update_log_message);
+    // one AdaptiveGaussTree per entry of results (a vector-valued batch builds one per tree_combinations entry)
+    void build_trees(const std::string& update_log_message, const BatchControl& control = {});
+    // Combinations a tree is built for: results, or for a vector-valued batch the combinations without component_key
+    std::vector<ParamMap> tree_combinations() const;
+    std::unique_ptr<AdaptiveGaussTree> build_tree(const ParamMap& combination, const std::string& update_log_message,
+                                                  const TreeCheckpoint& checkpoint) const;
+    // ParamMaps of the trees built for a combination of tree_combinations (one per component for a vector-valued batch)
+    std::vector<ParamMap> tree_keys(const ParamMap& combination) const;
+    // Stores a tree of build_tree (a vector-valued tree as its component trees) under tree_keys(combination)
+    std::vector<ParamMap> store_tree(const ParamMap& combination, std::unique_ptr<AdaptiveGaussTree> tree);
+    void merge_header(const AdaptiveGaussTreeBatch& other);     // update_log, keys and parameters part of merge()
+    json serialize(bool write_roots, bool write_trees, bool compact, bool write_stats = false);   // document written by save_to_json
+    json serialize_header(bool write_roots, bool write_trees);         // everything but "parameters"
+    json update_log_to_json(std::size_t first = 0) const;              // entries from `first` on
+    json* tree_location(json& result, const ParamMap& param_map) const;   // parameters/<key>/<value>/... of a tree
+
+    json checkpoint_state(const std::string& update_log_message) const;
+    static void write_checkpoint_state(const std::string& filename, const json& state);
+    void append_tree_segment(const std::string& filename, const std::vector<ParamMap>& param_maps);
+    void build_trees_checkpointed(const BatchCheckpoint& checkpoint, const std::string& update_log_message,
+                                  const BatchControl& control = {});
 
     bool compareParamMaps(const ParamMap& a, const ParamMap& b);    // Comparator for sorting based on "keys"
     void sortResults();                                             // Sorting function
@@ -82,11 +137,16 @@ public:
         WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
         ParamCollection parameters,
         std::string name="Project", std::string author="Author",  std::string description="project description", 
-        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Batch Creation"         
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Batch Creation",
+        BatchCheckpoint checkpoint = {},   // empty filename: no checkpointing
+        HpRefinement hp = {}, SingularityDetection detect = {}, BreakpointFunction breakpoints = nullptr,
+        Summation::Method summation = Summation::Method::Naive,   // written to the header, read back by the loaders
+        BatchControl control = {}          // progress, cancellation and deadline (see BatchBuild for a background build)
     ) : func(func), 
          tol(tol), lower(lower),upper(upper),
          alphaA(alphaA), alphaB(alphaB),
-        min_depth(min_depth), max_depth(max_depth), order1(n1), order2(n2),       
+        min_depth(min_depth), max_depth(max_depth), order1(n1), order2(n2), hp(hp), detect(detect), breakpoints(breakpoints),
+        summation(summation),
         a_singular(a_singular),b_singular(b_singular), 
         legendre_n1(legendre_n1),legendre_n2(legendre_n2),laguerre_n1(laguerre_n1),laguerre_n2(laguerre_n2),
         parameters(parameters), 
@@ -99,35 +159,89 @@ public:
         }
         std::vector<size_t> indices(keys.size(), 0);
         // printKeys_internal(); 
-        generate_combinations(keys, parameters, indices, results);
+        {
+            Trace::Span span("batch/combinations", "batch");
+            generate_combinations(keys, parameters, indices, results);
+        }
         sortResults();
         // printKeys_internal(); 
-        for (const auto& combo : results) {
-            quad_coll[combo]= std::make_unique<AdaptiveGaussTree>(
-                func, lower, upper, tol, min_depth, max_depth, n1, n2,  
-                alphaA, alphaB, a_singular, b_singular,
-                legendre_n1,  legendre_n2, laguerre_n1, laguerre_n2,
-                combo,
-                name, author, description, 
-                reference, version, update_log_message            
-            );                 
+        if (checkpoint.filename.empty()) {
+            build_trees(update_log_message, control);
+        } else {
+            build_trees_checkpointed(checkpoint, update_log_message, control);   // resumes if the checkpoint exists
         }
     }
 
+    // Same, but for an explicit list of parameter combinations instead of the full grid of a ParamCollection
+    // (e.g. one shard of a grid, see tools/aq_driver.cpp).  `parameters` holds the values that occur.
+    AdaptiveGaussTreeBatch(
+        std::function<double(ParamMap, double)> func,
+        double lower, double upper,        
+        double tol, int min_depth, int max_depth, int n1, int n2,
+        double alphaA, double alphaB,
+        bool a_singular, bool b_singular,
+        WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+        std::vector<ParamMap> combinations,
+        std::string name="Project", std::string author="Author",  std::string description="project description", 
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Batch Creation",
+        HpRefinement hp = {}, SingularityDetection detect = {}, BreakpointFunction breakpoints = nullptr,
+        Summation::Method summation = Summation::Method::Naive
+    );
+
+    // Same, with an integrand evaluated a rule at a time (PointsIntegrand, quadrature.hpp; used by aq_c_api.h)
+    AdaptiveGaussTreeBatch(
+        PointsIntegrand func,
+        double lower, double upper,
+        double tol, int min_depth, int max_depth, int n1, int n2,
+        double alphaA, double alphaB,
+        bool a_singular, bool b_singular,
+        WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+        std::vector<ParamMap> combinations,
+        std::string name="Project", std::string author="Author",  std::string description="project description", 
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Batch Creation",
+        HpRefinement hp = {}, SingularityDetection detect = {}, BreakpointFunction breakpoints = nullptr,
+        Summation::Method summation = Summation::Method::Naive
+    );
+
+    // Vector-valued integrand whose components are the values `component_values` of the parameter `component_key` (e.g. 
+    // "s" = 2, ..., 10 of the polylogs, see polylog_components).  One tree is built per combination of `parameters` on a 
+    // partition shared by the components, and fanned out into one tree per component (AdaptiveGaussTree::component_tree).  
+    // The result looks like a batch over `parameters` and `component_key` built with a scalar integrand; its func 
+    // evaluates the vector integrand (without `component_key`) and takes the component.  `checkpoint` and `control` 
+    // work as for the scalar batch; the checkpoint frontier is the vector-valued tree, so a resume passes the same 
+    // arguments to this constructor.
+    AdaptiveGaussTreeBatch(
+        VectorIntegrand func, std::string component_key, std::vector<ParamType> component_values,
+        double lower, double upper,
+        double tol, int min_depth, int max_depth, int n1, int n2,
+        double alphaA, double alphaB,
+        bool a_singular, bool b_singular,
+        WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+        ParamCollection parameters,
+        std::string name="Project", std::string author="Author",  std::string description="project description", 
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Batch Creation",
+        BatchCheckpoint checkpoint = {},   // empty filename: no checkpointing
+        HpRefinement hp = {}, SingularityDetection detect = {}, BreakpointFunction breakpoints = nullptr,
+        Summation::Method summation = Summation::Method::Naive,
+        BatchControl control = {}
+    );
+
     AdaptiveGaussTreeBatch(const AdaptiveGaussTreeBatch& other)
         : func(other.func),
           tol(other.tol), lower(other.lower), upper(other.upper),
           alphaA(other.alphaA), alphaB(other.alphaB),
           min_depth(other.min_depth), max_depth(other.max_depth),
-          order1(other.order1), order2(other.order2),
-          a_singular(other.a_singular), b_singular(other.b_singular),
+          order1(other.order1), order2(other.order2), hp(other.hp), detect(other.detect), breakpoints(other.breakpoints),
+          summation(other.summation), a_singular(other.a_singular), b_singular(other.b_singular),
           legendre_n1(other.legendre_n1), legendre_n2(other.legendre_n2),
           laguerre_n1(other.laguerre_n1), laguerre_n2(other.laguerre_n2),
           parameters(other.parameters),
           name(other.name), author(other.author),
           description(other.description), reference(other.reference),
           version(other.version), results(other.results) ,
-          update_log(other.update_log),   keys(other.keys) {
+          update_log(other.update_log), logged(other.logged),  keys(other.keys),
+          vector_func(other.vector_func), component_key(other.component_key), component_values(other.component_values),
+          points_func(other.points_func) {
         
         // Deep copy QuadCollection (map of unique_ptr<AdaptiveGaussTree>)
         for (const auto& pair : other.quad_coll) {
@@ -136,22 +250,76 @@ public:
     }
 
 
+    AdaptiveGaussTreeBatch(AdaptiveGaussTreeBatch&& other) = default;
+    AdaptiveGaussTreeBatch& operator=(AdaptiveGaussTreeBatch&& other) = default;
+
     AdaptiveGaussTreeBatch(
         std::function<double(ParamMap, double)> func,
         std::string filename
     );    
 
-    void printCollection() {
+    // Resume constructor: continues the build recorded in a checkpoint (settings and parameters are read from it; 
+    // the breakpoints, a function, have to be passed again)
+    AdaptiveGaussTreeBatch(
+        std::function<double(ParamMap, double)> func,
+        WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+        const BatchCheckpoint& checkpoint, BreakpointFunction breakpoints = nullptr
+    );
+
+    // All combinations of a ParamCollection, in the order the batch constructor builds them
+    static std::vector<ParamMap> expand_grid(const ParamCollection& parameters);
+    // JSON form of a combination ({"s": 2, "z": 0.5}) and of a ParamCollection ({"s": [2, 3], "z": [0.1, 0.5]}).
+    // Whole numbers read back as int, any other number as double (1.0 is written as a double).
+    static json combination_to_json(const ParamMap& combination);
+    static ParamMap combination_from_json(const json& entry);
+    static json parameters_to_json(const ParamCollection& parameters);
+    static ParamCollection parameters_from_json(const json& data);
+
+    // k-way merge of batch files trained separately: files are loaded on `threads` threads (0 = hardware concurrency)
+    // and folded in the given order with moves.  For a parameter set present in several files the first one wins.
+    static AdaptiveGaussTreeBatch merge_files(
+        std::function<double(ParamMap, double)> func, const std::vector<std::string>& filenames, unsigned int threads = 0);
+
+    void printCollection() const {
            for (const auto& result : results) {
-               std::cout << result << *quad_coll[result] <<std::endl;
+               std::cout << result << *quad_coll.at(result) <<std::endl;
            }
        };   
+    void add_update_log(const std::string& message) {
+        std::time_t now = std::time(nullptr);
+        char timestamp[20];
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+        update_log.emplace_back(timestamp, message);
+    }
+    const std::vector<std::pair<std::string, std::string>>& get_update_log() const { return update_log; }
     void merge(const AdaptiveGaussTreeBatch& other);
+    void merge(AdaptiveGaussTreeBatch&& other);   // moves the trees out of other (left empty)
     const QuadCollection& getCollection() const { return quad_coll; };
-    void save_to_json(const std::string & filename, bool overwrite = false, bool write_roots=false, bool write_trees =true); 
-    json parameter_serializer(bool dump_nodes = false); 
-    AdaptiveGaussTreeBatch operator+(const AdaptiveGaussTreeBatch& other) const;
+    // compact = true stores each tree in the leaf-only layout (AdaptiveGaussTree::serialize_tree_compact), no indentation
+    // write_stats = true adds the build statistics of every tree ("stats", next to its "tree")
+    void save_to_json(const std::string & filename, bool overwrite = false, bool write_roots=false, bool write_trees =true, bool compact = false,
+                      bool write_stats = false); 
+    json parameter_serializer(bool dump_nodes = false, bool compact = false, bool write_stats = false); 
+    // Build statistics per tree, in the order of the parameter grid, and their sum (see tree_stats.hpp)
+    std::vector<std::pair<ParamMap, TreeStats>> get_stats() const;
+    TreeStats total_stats() const;
+    // Trees cut short by a BatchControl deadline (or loaded with that flag), in the order of the parameter grid
+    std::vector<ParamMap> best_effort_trees() const;
+    // Trees with leaves that miss their tolerance by round-off (AdaptiveGaussTree::roundoff_limited_leaves), same order
+    std::vector<ParamMap> roundoff_limited_trees() const;
+    // Log-structured batch files: each call appends one line holding this batch's trees (leaf-compact) and the 
+    // update_log entries it has not written to that file yet (a batch loaded from the log has written all of its own).
+    // AdaptiveGaussTreeBatch(func, filename) reads all segments; a later segment replaces trees with the same ParamMap.
+    void append_to_log(const std::string& filename, const std::string& update_log_message = "Appended segment", bool write_roots = false);
+    // Folds all segments into one (in place unless output_filename is given), with the root tables if the log has them
+    static void compact_log(const std::string& filename, const std::string& output_filename = "");
+    // Temporaries on either side are moved from rather than deep copied
+    AdaptiveGaussTreeBatch operator+(const AdaptiveGaussTreeBatch& other) const &;
+    AdaptiveGaussTreeBatch operator+(AdaptiveGaussTreeBatch&& other) const &;
+    AdaptiveGaussTreeBatch operator+(const AdaptiveGaussTreeBatch& other) &&;
+    AdaptiveGaussTreeBatch operator+(AdaptiveGaussTreeBatch&& other) &&;
     AdaptiveGaussTreeBatch& operator+=(const AdaptiveGaussTreeBatch& other);
+    AdaptiveGaussTreeBatch& operator+=(AdaptiveGaussTreeBatch&& other);
 
 };
 
@@ -4,7 +4,13 @@
 #include <quadrature.hpp>
 #include <legendre_quadrature.hpp>
 #include <laguerre_singular_endpoint.hpp>
+#include <tanh_sinh_quadrature.hpp>
+#include <interval_map.hpp>
 #include <weights_loader.hpp>
+#include <tree_stats.hpp>
+#include <trace.hpp>
+#include <summation.hpp>
+#include <wynn_epsilon.hpp>
 #include <nlohmann/json.hpp>
 #include <iostream>
 #include <fstream>
@@ -13,13 +19,72 @@
 #include <unordered_map>
 #include <variant>
 #include <optional>
+#include <sstream>
 #include <vector>
 #include <utility>
 #include <ctime>
+#include <chrono>
+#include <algorithm>
 
 using json = nlohmann::ordered_json;
 
+class JsonSaxLoader;
+
+// hp-adaptive refinement.  A node whose rule difference misses its tolerance is either re-evaluated at higher orders 
+// (o1, o2) -> (o2, o2^2 / o1), capped at max_order, or bisected.  The order is raised where the integrand looks smooth: 
+// the last refinement of the interval (the split that created the node, or the previous order raise) cut the rule 
+// difference by at least the factor `smoothness`.  Endpoint (Gauss-Laguerre) nodes are always bisected, and a node 
+// at max_depth is raised as long as orders are left.  max_order = 0 keeps plain bisection.
+struct HpRefinement {
+    int max_order = 0;          // highest order, at most getNMax() of the root files
+    double smoothness = 1e-2;
+};
+
+// Endpoint singularity detection for endpoints not declared singular.  Near an endpoint singularity (x - a)^-alpha 
+// (alpha = 0: log) the rule difference of the nodes at that endpoint shrinks by 2^-(1 - alpha) per bisection, while 
+// it collapses for a smooth integrand.  When the last `levels` ratios along the bisections toward the endpoint agree 
+// to within `max_spread` (in log2) and give an alpha in [min_alpha, 0.95], the endpoint is switched to 
+// Gauss-Laguerre (LaguerreSingularEndpoint) with the fitted alpha, starting with the node that showed it.
+// 
+// `extrapolate` works without a switch of rule, as QUADPACK's QAGS: a node at one endpoint that misses its tolerance
+// is bisected toward the endpoint in one go.  The partial sums (far halves + last near node) of the chain are 
+// extrapolated by Wynn's epsilon algorithm (wynn_epsilon.hpp), and once the extrapolation error meets the tolerance 
+// of the last near node, that node holds the extrapolated remainder and the chain stops ("method": "Wynn-epsilon").  
+// The far halves are refined as usual.  Scalar integrands, finite endpoints not declared singular only.
+struct SingularityDetection {
+    bool enabled = false;
+    int levels = 3;
+    double max_spread = 0.15;
+    double min_alpha = -1.0;
+    bool extrapolate = false;
+};
+
+// Interior breakpoint (kink, pole, log singularity, ...).  The root is split at the breakpoints before any bisection, 
+// the one in the middle of the list first, so that no node straddles one.  A singular breakpoint, (x - c)^-alpha on 
+// both sides, is an endpoint singularity for the nodes that end or start there and gets the Gauss-Laguerre treatment.
+struct Breakpoint {
+    double x;
+    bool singular = false;
+    double alpha = 0.0;
+};
+
+class AdaptiveGaussTree;
+
+// Checkpointing and early stop of a tree build.  `save` is called with the tree under construction at most every 
+// `interval` seconds while nodes remain to be evaluated; get_tree_serialized() of that tree marks the unevaluated nodes 
+// "pending".  Passing such a serialization as `partial_tree` continues the build where it stopped (null starts from 
+// scratch); the finished tree is the same as without checkpoints.  `stop` is asked before every node evaluation; once 
+// it returns true the pending nodes are evaluated once, without refinement, and the tree is flagged best effort 
+// (is_best_effort).
+struct TreeCheckpoint {
+    json partial_tree = nullptr;
+    std::function<void(const AdaptiveGaussTree&)> save;
+    double interval = 0.0;
+    std::function<bool()> stop;
+};
+
 class AdaptiveGaussTree {
+    friend class JsonSaxLoader;   // builds nodes directly while parsing (json_sax_loader.hpp)
     private:
     struct Node {
         double lower, upper;
@@ -27,6 +92,14 @@ class AdaptiveGaussTree {
         double tolerance, error, result;
         int order1, order2;
         bool is_singular;
+        bool pending = false;   // interval and tolerance set, not evaluated yet (tree under construction)
+        double previous_error = -1.0;   // hp: rule difference before the last refinement of the interval (< 0: none)
+        double alpha = 0.0;             // exponent of the Gauss-Laguerre weight (is_singular)
+        bool seed = false;              // split at a breakpoint, not evaluated; holds the sums of its children
+        bool roundoff_limited = false;  // misses the tolerance by round-off alone, not refined (roundoff_limited_leaves)
+        bool extrapolated = false;      // Wynn-epsilon limit of an endpoint chain (SingularityDetection::extrapolate)
+        // vector integrands: per component; result and error hold component 0 and the largest component error
+        std::vector<double> component_results, component_errors;
         std::unique_ptr<Node> left, right;
         
         Node(double lower, double upper, int depth, double tol, int o1, int o2, bool singular)
@@ -36,7 +109,8 @@ class AdaptiveGaussTree {
 
 
     public:
-    // Constructor from parameters
+    // Constructor from parameters.  `checkpoint` makes the build resumable and stoppable (see TreeCheckpoint); without 
+    // it the tree is built in one go.
     AdaptiveGaussTree(
         std::function<double(ParamMap, double)> f,
         double lower, double upper, double tol, int minD, int maxD,
@@ -45,19 +119,58 @@ class AdaptiveGaussTree {
         WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2,
         ParamMap args={},  // function argumnets (optional)
         std::string name="Project", std::string author="Author",  std::string description="project description", 
-        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Train" 
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Train",
+        HpRefinement hp = {},   // max_order = 0: bisection only
+        SingularityDetection detect = {},
+        std::vector<Breakpoint> breakpoints = {},   // interior points of (lower, upper); others are ignored
+        Summation::Method summation = Summation::Method::Naive,   // of the rules and the leaves (summation.hpp)
+        const TreeCheckpoint& checkpoint = {}
     )
-        : func(f), tolerance(tol), min_depth(minD), max_depth(maxD),
-          order1(n1), order2(n2),  // Explicitly set orders
-          alpha_a(alphaA), alpha_b(alphaB), a_singular(singularA), b_singular(singularB),
-          roots_legendre_n1(rl1), roots_legendre_n2(rl2),
-          roots_laguerre_n1(ll1), roots_laguerre_n2(ll2),
-          args(args),
-          name(name), reference(reference), description(description), author(author), version(version) {
-        
-        root = build_tree(lower, upper, 0, tol);
-        add_update_log(update_log_message);
-    }
+        : AdaptiveGaussTree(std::move(f), nullptr, 0, nullptr, lower, upper, tol, minD, maxD, n1, n2, alphaA, alphaB, singularA, singularB,
+                            rl1, rl2, ll1, ll2, std::move(args), std::move(name), std::move(author), std::move(description),
+                            std::move(reference), std::move(version), update_log_message, hp, detect, std::move(breakpoints),
+                            summation, checkpoint) {}
+
+    // Vector-valued integrand with `components` components, built on one partition: a node is refined while any 
+    // component misses its tolerance, and every point is evaluated once for all components.  component_tree(k) 
+    // returns the result for component k as an ordinary tree.
+    AdaptiveGaussTree(
+        VectorIntegrand f, std::size_t components,
+        double lower, double upper, double tol, int minD, int maxD,
+        int n1, int n2,
+        double alphaA, double alphaB, bool singularA, bool singularB,
+        WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2,
+        ParamMap args={},
+        std::string name="Project", std::string author="Author",  std::string description="project description", 
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Train",
+        HpRefinement hp = {}, SingularityDetection detect = {}, std::vector<Breakpoint> breakpoints = {},
+        Summation::Method summation = Summation::Method::Naive,
+        const TreeCheckpoint& checkpoint = {}
+    )
+        : AdaptiveGaussTree(nullptr, std::move(f), components, nullptr, lower, upper, tol, minD, maxD, n1, n2, alphaA, alphaB, singularA, singularB,
+                            rl1, rl2, ll1, ll2, std::move(args), std::move(name), std::move(author), std::move(description),
+                            std::move(reference), std::move(version), update_log_message, hp, detect, std::move(breakpoints),
+                            summation, checkpoint) {}
+
+    // Integrand evaluated a rule at a time (PointsIntegrand, quadrature.hpp): every node costs one call per rule 
+    // evaluation instead of one per point.  Otherwise the same as the scalar constructor; func is single_point(f).
+    AdaptiveGaussTree(
+        PointsIntegrand f,
+        double lower, double upper, double tol, int minD, int maxD,
+        int n1, int n2,
+        double alphaA, double alphaB, bool singularA, bool singularB,
+        WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2,
+        ParamMap args={},
+        std::string name="Project", std::string author="Author",  std::string description="project description", 
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Train",
+        HpRefinement hp = {}, SingularityDetection detect = {}, std::vector<Breakpoint> breakpoints = {},
+        Summation::Method summation = Summation::Method::Naive,
+        const TreeCheckpoint& checkpoint = {}
+    )
+        : AdaptiveGaussTree(single_point(f), nullptr, 0, f, lower, upper, tol, minD, maxD, n1, n2, alphaA, alphaB, singularA, singularB,
+                            rl1, rl2, ll1, ll2, std::move(args), std::move(name), std::move(author), std::move(description),
+                            std::move(reference), std::move(version), update_log_message, hp, detect, std::move(breakpoints),
+                            summation, checkpoint) {}
         
     // Constructor from JSON file
     AdaptiveGaussTree(
@@ -69,7 +182,7 @@ class AdaptiveGaussTree {
     }
 
     // Constructor from JSON data
-    AdaptiveGaussTree(json jsn,
+    AdaptiveGaussTree(const json& jsn,
         std::function<double(ParamMap, double)> f,
         WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2, ParamMap args={} )
         : func(f), roots_legendre_n1(rl1), roots_legendre_n2(rl2),
@@ -91,7 +204,9 @@ class AdaptiveGaussTree {
         args(other.args),        
         name(other.name), reference(other.reference), description(other.description),
         author(other.author), version(other.version),
-        update_log(other.update_log) {
+        update_log(other.update_log), stats(other.stats), best_effort(other.best_effort), hp(other.hp), detect(other.detect),
+        detected_alpha_a(other.detected_alpha_a), detected_alpha_b(other.detected_alpha_b), map(other.map), breakpoints(other.breakpoints),
+        vector_func(other.vector_func), width(other.width), points_func(other.points_func), summation(other.summation) {
 
     // Deep copy the tree structure
         root = clone_tree(other.root.get());
@@ -106,6 +221,14 @@ class AdaptiveGaussTree {
                                             node->is_singular);
         new_node->result = node->result;
         new_node->error = node->error;
+        new_node->pending = node->pending;
+        new_node->previous_error = node->previous_error;
+        new_node->alpha = node->alpha;
+        new_node->seed = node->seed;
+        new_node->roundoff_limited = node->roundoff_limited;
+        new_node->extrapolated = node->extrapolated;
+        new_node->component_results = node->component_results;
+        new_node->component_errors = node->component_errors;
 
         new_node->left = clone_tree(node->left.get());
         new_node->right = clone_tree(node->right.get());
@@ -113,9 +236,51 @@ class AdaptiveGaussTree {
         return new_node;
     }
 
-    // Method to get the total integral and error
-    std::pair<double, double> get_integral_and_error() const {
-        return traverse_and_sum(root.get());
+    // Method to get the total integral and error (vector-valued trees: component 0, and an error bound for all components)
+    // Naive and pairwise summation add the leaves along the tree (pairwise), the compensated methods in order.  The
+    // method is the one the tree was built with (get_summation).
+    std::pair<double, double> get_integral_and_error() const;
+
+    // Vector-valued trees: number of components (0 for a scalar tree) and the tree of component k.  The component 
+    // tree is an ordinary tree (its integrand evaluates the vector integrand and takes component k); the build 
+    // statistics go to component 0 only, so that the work is counted once.
+    std::size_t component_count() const { return width; }
+    std::unique_ptr<AdaptiveGaussTree> component_tree(std::size_t k) const;
+
+    // Statistics of the build (evaluations, nodes per depth, time, ...; see tree_stats.hpp).  Empty for trees
+    // loaded from a file; a resumed build only counts the work done after the resume.
+    const TreeStats& get_stats() const { return stats; }
+
+    // true when the build was stopped early (stop predicate of the checkpointed constructor): leaves may miss the
+    // tolerance, and get_integral_and_error() is the best estimate at that point
+    bool is_best_effort() const { return best_effort; }
+    // Number of leaves that miss their tolerance because the rule difference is round-off (compensated summation, see 
+    // summation.hpp): they are final, not refined, so get_integral_and_error() may report an error above the 
+    // tolerance.  Kept in the saved tree ("roundoff_limited" nodes, "leaf_roundoff" in the compact layout).
+    std::size_t roundoff_limited_leaves() const;
+
+    const HpRefinement& get_hp() const { return hp; }
+    Summation::Method get_summation() const { return summation; }
+    const SingularityDetection& get_singularity_detection() const { return detect; }
+    // alpha fitted by singularity detection at the lower / upper endpoint (empty: not detected)
+    std::optional<double> get_detected_alpha(bool lower_endpoint) const { return lower_endpoint ? detected_alpha_a : detected_alpha_b; }
+    const std::vector<Breakpoint>& get_breakpoints() const { return breakpoints; }   // of the build, sorted, x in u
+    // Integration interval and the variable the tree is bisected in (node bounds are values of u)
+    const IntervalMap& get_interval() const { return map; }
+
+    // Number of nodes in the tree (interior and leaves)
+    std::size_t node_count() const {
+        std::size_t count = 0;
+        std::vector<const Node*> stack{root.get()};
+        while (!stack.empty()) {
+            const Node* node = stack.back();
+            stack.pop_back();
+            if (!node) continue;
+            ++count;
+            stack.push_back(node->left.get());
+            stack.push_back(node->right.get());
+        }
+        return count;
     }
 
     void add_update_log(const std::string& message) {
@@ -128,12 +293,18 @@ class AdaptiveGaussTree {
         update_log.emplace_back(timestamp, message);
     }
 
-    void save_to_json(std::string filename, bool overwrite = false, bool dump_log = false) {
+    // compact = true writes the leaf-only layout (see serialize_tree_compact) without indentation
+    // write_stats = true adds the build statistics ("stats", see get_stats)
+    void save_to_json(std::string filename, bool overwrite = false, bool dump_log = false, bool compact = false, bool write_stats = false) {
+        if (width > 0) {
+            throw std::runtime_error("A vector-valued tree is saved through its component trees (component_tree).");
+        }
         // Check if the file exists
         if (std::filesystem::exists(filename) && !overwrite) {
             std::cerr << "File \"" << filename << "\" exists. Set overwrite = true to overwrite." << std::endl;
             return;
         }
+        Trace::Span span("tree/save", "io");
         json data;
         // name(name), author(author), description(description), reference(reference), version(version)        
         data["name"] = name;
@@ -146,6 +317,24 @@ class AdaptiveGaussTree {
         data["max_depth"] = max_depth;
         data["n1"] = order1;
         data["n2"] = order2;
+        if (!map.finite()) {
+            data["lower"] = IntervalMap::bound_to_json(map.get_lower());
+            data["upper"] = IntervalMap::bound_to_json(map.get_upper());
+        }
+        if (hp.max_order > 0) {
+            data["hp_max_order"] = hp.max_order;
+            data["hp_smoothness"] = hp.smoothness;
+        }
+        if (detect.enabled) {
+            data["detect_levels"] = detect.levels;
+            data["detect_max_spread"] = detect.max_spread;
+            data["detect_min_alpha"] = detect.min_alpha;
+            if (detected_alpha_a) data["detected_alphaA"] = *detected_alpha_a;
+            if (detected_alpha_b) data["detected_alphaB"] = *detected_alpha_b;
+        }
+        if (detect.extrapolate) data["extrapolate"] = true;
+        if (summation != Summation::Method::Naive) data["summation"] = Summation::to_string(summation);
+        if (best_effort) data["best_effort"] = true;
         // Serialize update log
         json log_json = json::array();
         for (const auto& entry : update_log) {
@@ -154,19 +343,16 @@ class AdaptiveGaussTree {
         if (!dump_log) {
             data["update_log"] = log_json;
         }        
-        data["tree"] = serialize_tree(root.get());
+        if (write_stats) data["stats"] = stats.to_json();
+        data["tree"] = compact ? serialize_tree_compact(root.get()) : serialize_tree(root.get());
         std::ofstream file(filename);
-        file << data.dump(4);
+        file << (compact ? data.dump() : data.dump(4));
     }
 
-    void load_from_json(std::string filename) {
-        json data;
-        std::ifstream file(filename);
-        file >> data;
-        load_from_json_stream(data);                
-    }
+    // Single pass SAX load, no intermediate DOM (see json_sax_loader.hpp)
+    void load_from_json(const std::string& filename);
 
-    void load_from_json_stream(json data) {
+    void load_from_json_stream(const json& data) {
         name = data["name"];
         reference=data["reference"];
         description=data["description"];
@@ -177,6 +363,11 @@ class AdaptiveGaussTree {
         max_depth = data["max_depth"];
         order1 = data["n1"];
         order2 = data["n2"];
+        hp.max_order = data.value("hp_max_order", 0);
+        hp.smoothness = data.value("hp_smoothness", HpRefinement().smoothness);
+        read_detection_header(data);
+        summation = Summation::from_string(data.value("summation", "naive"));
+        best_effort = data.value("best_effort", false);
         // Deserialize update log
         update_log.clear();
         if (data.contains("update_log")) {
@@ -186,6 +377,7 @@ class AdaptiveGaussTree {
         }
 //        std::cout << "deserialize" << std::endl;
         root = deserialize_tree(data["tree"]);
+        map = IntervalMap::from_header(data, root->lower, root->upper);
     }
 
     void print_update_log() const {
@@ -193,11 +385,30 @@ class AdaptiveGaussTree {
             std::cout << "[" << entry.first << "] " << entry.second << std::endl;
         }
     }
-    json get_tree_serialized(bool dump_nodes = false){
+    json get_tree_serialized(bool dump_nodes = false, bool compact = false) const {
+        if (compact && !dump_nodes) return serialize_tree_compact(root.get());
         return serialize_tree(root.get(), dump_nodes);
     }
 private:
+    // The build behind the public constructors: f for a scalar integrand, vector_f and components for a vector one, 
+    // points_f (and its single_point form as f) for one evaluated a rule at a time
+    AdaptiveGaussTree(
+        std::function<double(ParamMap, double)> f, VectorIntegrand vector_f, std::size_t components, PointsIntegrand points_f,
+        double lower, double upper, double tol, int minD, int maxD, int n1, int n2,
+        double alphaA, double alphaB, bool singularA, bool singularB,
+        WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2, ParamMap args,
+        std::string name, std::string author, std::string description, std::string reference, std::string version,
+        const std::string& update_log_message, HpRefinement hp, SingularityDetection detect, std::vector<Breakpoint> breakpoints,
+        Summation::Method summation, const TreeCheckpoint& checkpoint);
 
+    // Empty tree used by JsonSaxLoader, which fills in the header and the nodes itself
+    AdaptiveGaussTree(
+        std::function<double(ParamMap, double)> f,
+        WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2, ParamMap args)
+        : func(f), tolerance(0.0), min_depth(0), max_depth(0), order1(0), order2(0),
+          alpha_a(0.0), alpha_b(0.0), a_singular(false), b_singular(false),
+          roots_legendre_n1(rl1), roots_legendre_n2(rl2),
+          roots_laguerre_n1(ll1), roots_laguerre_n2(ll2), args(args) {}
 
     std::function<double(ParamMap, double)> func;
     double tolerance;
@@ -220,63 +431,165 @@ private:
     std::string author;
     std::string version;
     std::vector<std::pair<std::string, std::string>> update_log;
+    TreeStats stats;
+    bool best_effort = false;
+    HpRefinement hp;
+    SingularityDetection detect;
+    std::optional<double> detected_alpha_a, detected_alpha_b;
+    IntervalMap map;
+    std::vector<Breakpoint> breakpoints;
+    VectorIntegrand vector_func;   // vector-valued trees only (func is empty)
+    std::size_t width = 0;         // number of components, 0: scalar tree
+    PointsIntegrand points_func;   // rule-at-a-time integrands only (func is its single_point form)
+    Summation::Method summation = Summation::Method::Naive;
+
+    // Detection settings and results of a tree header (also read by JsonSaxLoader)
+    void read_detection_header(const json& data) {
+        detect.enabled = data.contains("detect_levels");
+        detect.levels = data.value("detect_levels", SingularityDetection().levels);
+        detect.max_spread = data.value("detect_max_spread", SingularityDetection().max_spread);
+        detect.min_alpha = data.value("detect_min_alpha", SingularityDetection().min_alpha);
+        detect.extrapolate = data.value("extrapolate", false);
+        detected_alpha_a = data.contains("detected_alphaA") ? std::optional<double>(data["detected_alphaA"].get<double>()) : std::nullopt;
+        detected_alpha_b = data.contains("detected_alphaB") ? std::optional<double>(data["detected_alphaB"].get<double>()) : std::nullopt;
+    }
 
-    std::unique_ptr<Node> build_tree(double lower, double upper, int depth, double tol) {
-        bool use_laguerre = (lower == 0 && a_singular) || (upper == 1 && b_singular);
-        std::unique_ptr<Quadrature> quadrature;
-        if (use_laguerre) {
-            quadrature = std::make_unique<LaguerreSingularEndpoint>(roots_laguerre_n1, order1, order2, lower, upper);
-        } else {
-            quadrature = std::make_unique<LegendreQuadrature>(roots_legendre_n1, order1, order2, lower, upper);
-        }
-                
-        double I2 = quadrature->integrate(func, args);
- //       double I1 = quadrature->integrate(func, {});  
- //       double err = I2-I1  // ChatGPT needs a vacay.
-        double err = quadrature->getError();
-        
-        auto node = std::make_unique<Node>(lower, upper, depth, tol, order1, order2, use_laguerre);
-        node->result = I2;
-        node->error = err;
-        
-        if (depth < min_depth || (err >= tol && depth < max_depth)) {
-            double mid = (lower + upper) / 2;
-            node->left = build_tree(lower, mid, depth + 1, tol / 2);
-            node->right = build_tree(mid, upper, depth + 1, tol / 2);
+    // Rule of the nodes that are not at a singular endpoint or an infinite end: Gauss-Legendre, or tanh-sinh when the 
+    // "Legendre" loaders hold TanhSinhQuadrature::rules() (the orders are then levels)
+    bool tanh_sinh() const { return roots_legendre_n1.getMethod() == TanhSinhQuadrature::method_name; }
+    const char* regular_method() const { return tanh_sinh() ? TanhSinhQuadrature::method_name : "Gauss-Legendre"; }
+
+    // Endpoints of the interval are those of the root
+    bool at_endpoint_a(const Node* node) const { return node->lower == root->lower; }
+    bool at_endpoint_b(const Node* node) const { return node->upper == root->upper; }
+
+    void check_endpoints() const {
+        if ((a_singular && map.infinite_lower()) || (b_singular && map.infinite_upper())) {
+            throw std::runtime_error("An infinite endpoint cannot be singular.");
         }
-        return node;
     }
 
-    json serialize_tree(Node* node, bool dump_nodes = false) {
+    // Breakpoints in u, inside the interval and sorted.  An infinite interval is always split at x = 0 (u = 0), so 
+    // that no node reaches both infinite ends.
+    static std::vector<Breakpoint> interior_breakpoints(std::vector<Breakpoint> points, const IntervalMap& map);
+
+    // Singular end of the node: {true, alpha} for its lower end, {false, alpha} for its upper end (lower end first)
+    std::optional<std::pair<bool, double>> singular_end(const Node* node) const;
+
+    // Infinite end the node reaches: true for the upper end
+    std::optional<bool> tail_end(const Node* node) const;
+
+    // f(x(u)) x'(u), the integrand in the tree variable of an infinite interval
+    std::function<double(ParamMap, double)> mapped_func() const;
+    VectorIntegrand mapped_vector_func() const;
+    PointsIntegrand mapped_points_func() const;
+
+    // Splits a pending node at the breakpoints inside it (the median first) into pending children
+    void seed_breakpoints(Node* node);
+    static void sum_seeds(Node* node);   // seed nodes hold the sums of their children
+
+    // Component k of a vector-valued tree into result and error of every node
+    static void select_component(Node* node, std::size_t k);
+
+    // Evaluates the node with its own orders (node->order1, node->order2); `repeat` tells the statistics why a node
+    // is evaluated a second time.  A node at an infinite end is integrated in x by Gauss-Laguerre from x(u0) outward 
+    // unless `laguerre_tail` is false; every other node in u.
+    void evaluate_node(Node* node, TreeStats::Repeat repeat = TreeStats::Repeat::None, bool laguerre_tail = true);
+
+    // Evaluates the pending nodes depth first, left before right (the order of a recursive build), and adds pending
+    // children wherever a node needs refinement.  The tree is complete at all times apart from the pending nodes, 
+    // so `checkpoint.save` can serialize it between two evaluations, and a `checkpoint.stop` returning true closes the 
+    // tree with one evaluation of every pending node.
+    void grow(const TreeCheckpoint& checkpoint = {});
+
+    // Evaluates a pending node, with the endpoint switch, the tail rule choice and the order raises of hp mode.  
+    // Returns the rule difference at the tree orders, which the children compare with (hp).
+    double evaluate_and_adapt(Node* node);
+    void bisect(Node* node, double base_error);
+
+    // Adds the pending children of an evaluated node that needs refinement (left on top of the stack), or closes it
+    void refine_or_close(Node* node, double base_error, std::vector<Node*>& stack);
+
+    // Does `node` (evaluated) start an extrapolated chain toward the one endpoint it touches?
+    bool extrapolates(const Node* node) const;
+
+    // Bisects toward the endpoint until Wynn's epsilon algorithm, applied to the integrals of `node` along the chain,
+    // meets the tolerance of the near node; the far halves go on the stack as pending work.  A near node that meets 
+    // its tolerance by itself, turns singular (detection) or reaches max_depth ends the chain as an ordinary node.
+    void extrapolate_chain(Node* node, std::vector<Node*>& stack);
+
+    static bool needs_refinement(const Node* node) {
+        return node->error >= node->tolerance && !node->roundoff_limited;
+    }
+
+    // hp: raise the order of `node` (evaluated, error >= tolerance) instead of bisecting it?
+    bool raise_order(const Node* node) const;
+
+    // Singularity detection at the endpoints `node` touches (evaluated, error >= tolerance).  The rule differences
+    // along the bisections root -> node are fitted; on a match the endpoint becomes singular with the fitted alpha.
+    bool detect_endpoint(const Node* node);
+
+    // Resumed build: endpoints switched by singularity detection before the interruption (the root is never switched)
+    void recover_detected_endpoints();
+
+    static void collect_pending(Node* node, std::vector<Node*>& pending);   // pre-order
+
+    // Nodes evaluated at other orders than the tree's (hp mode) carry "n1" and "n2", nodes of a vector-valued tree their
+    // "component_integrals" and "component_errors"
+    json serialize_tree(const Node* node, bool dump_nodes = false) const {
         if (!node) return nullptr;
-        if (dump_nodes) return {
-            {"a", node->lower},
-            {"b", node->upper},
-            {"depth", node->depth},
-            {"tol", node->tolerance},
-            {"error", node->error},
-            {"integral", node->result},
-            {"method", node->is_singular ? "Gauss-Laguerre" : "Gauss-Legendre"}            
-        };
-        return {
+        json data = {
             {"a", node->lower},
             {"b", node->upper},
             {"depth", node->depth},
-            {"tol", node->tolerance},
-            {"error", node->error},
-            {"integral", node->result},
-            {"method", node->is_singular ? "Gauss-Laguerre" : "Gauss-Legendre"},
-            {"left", serialize_tree(node->left.get())},
-            {"right", serialize_tree(node->right.get())}
+            {"tol", node->tolerance}
         };
+        if (node->pending) {
+            data["pending"] = true;
+            if (node->previous_error >= 0) data["previous_error"] = node->previous_error;
+            return data;
+        }
+        data["error"] = node->error;
+        data["integral"] = node->result;
+        if (!node->component_results.empty()) {   // vector-valued trees (checkpoint frontiers)
+            data["component_integrals"] = node->component_results;
+            data["component_errors"] = node->component_errors;
+        }
+        data["method"] = node->extrapolated ? "Wynn-epsilon" : node->is_singular ? "Gauss-Laguerre" : regular_method();
+        if (node->is_singular && node->alpha != 0.0) data["alpha"] = node->alpha;
+        if (node->seed) data["seed"] = true;
+        if (is_roundoff_leaf(node)) data["roundoff_limited"] = true;
+        if (node->order1 != order1 || node->order2 != order2) {
+            data["n1"] = node->order1;
+            data["n2"] = node->order2;
+        }
+        if (dump_nodes) return data;
+        data["left"] = serialize_tree(node->left.get());
+        data["right"] = serialize_tree(node->right.get());
+        return data;
     }
 // Node(double lower, double upper, int depth, double tol, int o1, int o2, bool singular)    
     std::unique_ptr<Node> deserialize_tree(const json& data) {
         if (data.is_null()) return nullptr;
+        if (data.contains("leaf_depths")) return deserialize_tree_compact(data);
+        if (data.value("pending", false)) {
+            auto node = std::make_unique<Node>(data["a"], data["b"], data["depth"], data["tol"], order1, order2, false);
+            node->pending = true;
+            node->previous_error = data.value("previous_error", -1.0);
+            return node;
+        }
         auto node = std::make_unique<Node>(data["a"], data["b"], data["depth"],
-                                           data["tol"],order1, order2, data["method"] == "Gauss-Laguerre");
+                                           data["tol"], data.value("n1", order1), data.value("n2", order2), data["method"] == "Gauss-Laguerre");
+        node->alpha = data.value("alpha", 0.0);
+        node->seed = data.value("seed", false);
+        node->roundoff_limited = data.value("roundoff_limited", false);
+        node->extrapolated = data["method"] == "Wynn-epsilon";
         node->error = data["error"];
         node->result = data["integral"];
+        if (data.contains("component_integrals")) {
+            node->component_results = data["component_integrals"].get<std::vector<double>>();
+            node->component_errors = data["component_errors"].get<std::vector<double>>();
+        }
         if (data.contains("left")){
             node->left = deserialize_tree(data["left"]);
             node->right = deserialize_tree(data["right"]);
@@ -284,6 +597,28 @@ private:
         return node;
     }
 
+    // Leaf-only layout:  {"format": "leaf-compact", "a", "b", "tol", "leaf_depths": [...], "integral": [...], "error": [...],
+    //                     "methods": ["Gauss-Legendre", ...], "method": [index into methods per leaf]}
+    // The in-order leaf depths fix the bisection tree; interior nodes are rebuilt as the sums of their children.
+    // hp trees add "leaf_n1" and "leaf_n2", the orders of every leaf; trees split at breakpoints add "leaf_a", the lower 
+    // bound of every leaf, and take the bounds from it instead of from the bisections.  Gauss-Laguerre leaves with an 
+    // exponent add "leaf_alpha" (every leaf), breakpoint trees "leaf_seeds" (seed nodes above every leaf), and trees 
+    // under construction "leaf_pending" (indices of the leaves not evaluated yet, whose "error" is their previous_error); 
+    // "leaf_roundoff" lists the indices of the round-off limited leaves (roundoff_limited_leaves).
+    // The values of interior nodes are not kept, so singularity detection, which fits them, needs the verbose layout 
+    // to continue a frontier exactly (the batch checkpoints write it).
+    json serialize_tree_compact(const Node* node) const;
+    std::unique_ptr<Node> deserialize_tree_compact(const json& data) const;
+    static std::unique_ptr<Node> expand_compact_tree(double lower, double upper, double tol,
+        const std::vector<int>& leaf_depths, const std::vector<double>& integrals, const std::vector<double>& errors,
+        const std::vector<std::string>& methods, const std::vector<int>& method_index, int o1, int o2,
+        const std::vector<int>& leaf_n1 = {}, const std::vector<int>& leaf_n2 = {}, const std::vector<double>& leaf_a = {},
+        const std::vector<double>& leaf_alpha = {}, const std::vector<int>& leaf_seeds = {}, const std::vector<int>& leaf_pending = {},
+        const std::vector<int>& leaf_roundoff = {});
+    static bool is_roundoff_leaf(const Node* node) {
+        return !node->left && !node->right && node->roundoff_limited && node->error >= node->tolerance;
+    }
+
     std::pair<double, double> traverse_and_sum(const Node* node) const {
         if (!node) return {0.0, 0.0};
         if (!node->left && !node->right) return {node->result, node->error};
@@ -293,6 +628,8 @@ private:
         
         return {left_integral + right_integral, left_error + right_error};
     }    
+
+    static void sum_leaves(const Node* node, Summation::Accumulator& integral, Summation::Accumulator& error);
     
 };
 
@@ -0,0 +1,75 @@
+#ifndef AQ_C_API_H
+#define AQ_C_API_H
+
+/* C interface of the engine, built into bin/libaq.so by `make lib` (aq_python/aq_ctypes.py loads it with ctypes).
+ *
+ * A batch is an opaque handle; functions that create one return NULL on failure and the others return 0 on success
+ * and -1 on failure, with the reason in aq_last_error().  No C++ exception leaves the library.
+ *
+ * Parameters are numbers: a combination is a row of n_keys doubles, in the order of the `keys` passed in, and
+ * is_int[k] != 0 makes key k an int parameter (its values are rounded).  Arrays of combinations are row-major,
+ * n_combinations x n_keys, so a C-contiguous 2-D NumPy array passes through as is.
+ *
+ * The integrand is called once per rule evaluation with all its points: it writes f(x[i]) into out[i] for i < n, with
+ * the parameter values of the tree in params, in the order of the keys (int parameters as doubles).  A node costs one
+ * call per rule evaluation (n1 + n2 points for Gauss rules) instead of one per point, so a NumPy callback can
+ * evaluate vectorized.  It is called from the thread that builds the batch. */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AQ_C_API_VERSION 2
+
+typedef struct aq_batch aq_batch;
+typedef void (*aq_integrand)(const double* x, size_t n, const double* params, size_t n_params, double* out, void* user_data);
+
+/* Build settings of both build functions.  aq_default_settings(): [0, 1], tol 1e-12, depths 2 .. 20, orders 100 and
+ * 150, no singular end, root tables ../model_json/legendre.json and laguerre.json (the defaults of tools/aq_driver) */
+typedef struct aq_settings {
+    double lower, upper;          /* integration interval (may be infinite) */
+    double tol;
+    int min_depth, max_depth;
+    int n1, n2;                   /* rule orders */
+    double alpha_a, alpha_b;      /* Gauss-Laguerre exponents at singular ends */
+    int a_singular, b_singular;
+    const char* legendre_file;    /* root tables (WeightsLoader files) */
+    const char* laguerre_file;
+} aq_settings;
+
+int aq_api_version(void);
+/* Message of the last failed call on the calling thread ("" if none) */
+const char* aq_last_error(void);
+aq_settings aq_default_settings(void);
+
+/* One tree per combination of the grid: values[k] holds n_values[k] values of key k */
+aq_batch* aq_batch_build_grid(aq_integrand f, void* user_data, const aq_settings* settings,
+                              size_t n_keys, const char* const* keys, const int* is_int,
+                              const size_t* n_values, const double* const* values);
+/* One tree per row of `combinations` (n_combinations x n_keys) */
+aq_batch* aq_batch_build(aq_integrand f, void* user_data, const aq_settings* settings,
+                         size_t n_keys, const char* const* keys, const int* is_int,
+                         size_t n_combinations, const double* combinations);
+/* Batch file (plain, compact or log); the trees can be queried, not rebuilt */
+aq_batch* aq_batch_load(const char* filename);
+/* compact != 0: leaf-only trees, no indentation */
+int aq_batch_save(aq_batch* batch, const char* filename, int compact);
+void aq_batch_free(aq_batch* batch);
+
+size_t aq_batch_size(const aq_batch* batch);
+size_t aq_batch_key_count(const aq_batch* batch);
+/* Name of key k (sorted by name), NULL if k is out of range; valid as long as the batch */
+const char* aq_batch_key(const aq_batch* batch, size_t k);
+
+/* Integral and error of the tree of every row of `combinations` into integrals[i], errors[i] (either may be NULL);
+ * NaN for rows the batch has no tree for */
+int aq_batch_lookup(const aq_batch* batch, size_t n_keys, const char* const* keys, const int* is_int,
+                    size_t n_combinations, const double* combinations, double* integrals, double* errors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AQ_C_API_H */
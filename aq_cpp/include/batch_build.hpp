@@ -0,0 +1,66 @@
+#ifndef BATCH_BUILD_HPP
+#define BATCH_BUILD_HPP
+
+#include <adaptive_gauss_batch.hpp>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+// Batch build on a thread of its own, for callers that schedule training (e.g. a service with a time budget).  The 
+// constructor takes the arguments of the AdaptiveGaussTreeBatch grid constructor, with the BatchControl moved up, and
+// returns at once:
+//    BatchBuild build(func, 0.0, 1.0, 1e-10, 0, 30, 15, 20, 0.0, 0.0, false, false, rl1, rl2, ll1, ll2, parameters,
+//                     {nullptr, 1.0, nullptr, std::chrono::steady_clock::now() + std::chrono::minutes(5)});
+//    ... build.progress() ...
+//    AdaptiveGaussTreeBatch batch = build.get();   // trees not finished in 5 minutes are best effort
+// Destroying a handle whose build is still running, or assigning another build to it, cancels the build and waits for
+// it.
+class BatchBuild {
+public:
+    BatchBuild(
+        std::function<double(ParamMap, double)> func,
+        double lower, double upper,
+        double tol, int min_depth, int max_depth, int n1, int n2,
+        double alphaA, double alphaB,
+        bool a_singular, bool b_singular,
+        WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+        ParamCollection parameters,
+        BatchControl control = {},   // control.progress is called on the build thread; a null cancel flag is created
+        std::string name="Project", std::string author="Author",  std::string description="project description", 
+        std::string reference="references", std::string version="1.0", std::string update_log_message="Initial Batch Creation",
+        BatchCheckpoint checkpoint = {},
+        HpRefinement hp = {}, SingularityDetection detect = {}, BreakpointFunction breakpoints = nullptr,
+        Summation::Method summation = Summation::Method::Naive
+    );
+    BatchBuild(BatchBuild&&) = default;
+    BatchBuild& operator=(BatchBuild&& other);
+    ~BatchBuild();
+
+    // A handle moved from has no build: progress(), wait() and get() throw std::logic_error, cancel() does nothing and 
+    // ready() is false.
+
+    // Last progress report of the build (all zero before the first)
+    BatchProgress progress() const;
+    // Asks the build to stop; get() then throws std::runtime_error
+    void cancel();
+    bool ready() const;
+    // Blocks until the build has finished (or stopped)
+    void wait() const;
+    // Waits for the batch and hands it over (once, std::logic_error after that); rethrows what the build threw
+    AdaptiveGaussTreeBatch get();
+
+private:
+    struct State {
+        mutable std::mutex mutex;
+        BatchProgress progress;
+        std::shared_ptr<std::atomic<bool>> cancel;
+    };
+    std::shared_ptr<State> state;
+    std::future<AdaptiveGaussTreeBatch> result;
+
+    void check_state() const;   // std::logic_error for a handle moved from
+};
+
+#endif // BATCH_BUILD_HPP
@@ -0,0 +1,92 @@
+#ifndef BATCH_SNAPSHOT_HPP
+#define BATCH_SNAPSHOT_HPP
+
+#include <adaptive_gauss_batch.hpp>
+#include <quadrature.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Read-only view of a batch for query threads: the integral and error of every tree, summed once when the snapshot
+// is taken.  Nothing in it changes afterwards and every method is const, so any number of threads query one snapshot
+// without locks; a lookup is one hash of the ParamMap.
+class BatchSnapshot {
+public:
+    explicit BatchSnapshot(const AdaptiveGaussTreeBatch& batch);
+
+    // (integral, error) of the tree for `param_map`, nullptr if the batch has none
+    const std::pair<double, double>* find(const ParamMap& param_map) const;
+    // As find(), throws std::out_of_range if there is no tree
+    const std::pair<double, double>& at(const ParamMap& param_map) const;
+    std::size_t size() const { return entries.size(); }
+    // Last update log entry of the batch (timestamp, message): which training the snapshot serves
+    const std::pair<std::string, std::string>& last_update() const { return update; }
+
+private:
+    std::unordered_map<ParamMap, std::pair<double, double>, ParamMapHash, ParamMapEqual> entries;
+    std::pair<std::string, std::string> update;
+};
+
+// Publication point of the current snapshot.  publish() swaps in the snapshot of a retrained batch without waiting 
+// for readers; a replaced snapshot is freed when its last reader lets go of it.
+// Query threads read through a Reader, one per thread: it keeps the snapshot it saw last and only compares the 
+// slot's version with its own, one atomic load of a counter that changes once per publish.  The steady state takes no 
+// lock and touches no shared reference count, so readers on different cores do not contend; a reader takes the slot's 
+// lock once after each publish.  get() always takes the lock and copies the shared_ptr: for occasional readers.
+class SnapshotSlot {
+public:
+    class Reader {
+    public:
+        explicit Reader(const SnapshotSlot& slot) : slot(&slot) {}
+        // The current snapshot.  The reference stays valid until the next get() on this reader, which may replace it;
+        // an idle reader keeps its snapshot alive until then.
+        const std::shared_ptr<const BatchSnapshot>& get() {
+            if (slot->version.load(std::memory_order_acquire) != seen) {
+                std::lock_guard<std::mutex> lock(slot->mutex);
+                held = slot->current;
+                seen = slot->version.load(std::memory_order_relaxed);
+                ++refresh_count;
+            }
+            return held;
+        }
+        // Times get() took the slow path (once per publish it saw)
+        std::size_t refreshes() const { return refresh_count; }
+
+    private:
+        const SnapshotSlot* slot;
+        std::shared_ptr<const BatchSnapshot> held;
+        std::uint64_t seen = ~std::uint64_t(0);   // no version yet: the first get() loads
+        std::size_t refresh_count = 0;
+    };
+
+    SnapshotSlot() = default;
+    explicit SnapshotSlot(std::shared_ptr<const BatchSnapshot> initial) : current(std::move(initial)) {}
+    SnapshotSlot(const SnapshotSlot&) = delete;
+    SnapshotSlot& operator=(const SnapshotSlot&) = delete;
+
+    std::shared_ptr<const BatchSnapshot> get() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return current;
+    }
+    // Returns the snapshot it replaces
+    std::shared_ptr<const BatchSnapshot> publish(std::shared_ptr<const BatchSnapshot> next) {
+        std::lock_guard<std::mutex> lock(mutex);
+        current.swap(next);
+        version.fetch_add(1, std::memory_order_release);
+        return next;
+    }
+    std::shared_ptr<const BatchSnapshot> publish(const AdaptiveGaussTreeBatch& batch) {
+        return publish(std::make_shared<const BatchSnapshot>(batch));
+    }
+
+private:
+    mutable std::mutex mutex;             // current, and version changes
+    std::shared_ptr<const BatchSnapshot> current;
+    std::atomic<std::uint64_t> version{0};
+};
+
+#endif // BATCH_SNAPSHOT_HPP
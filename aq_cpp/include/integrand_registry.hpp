@@ -0,0 +1,21 @@
+#ifndef INTEGRAND_REGISTRY_HPP
+#define INTEGRAND_REGISTRY_HPP
+
+#include <quadrature.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Integrands by name, for programs that are configured from files instead of code (tools/aq_driver.cpp).
+// "polylog" (polylog_wrapper) is always registered; add others before they are looked up.
+class IntegrandRegistry {
+public:
+    using Integrand = std::function<double(ParamMap, double)>;
+
+    static void add(const std::string& name, Integrand func);   // replaces an existing entry
+    static Integrand get(const std::string& name);               // throws std::runtime_error if unknown
+    static bool contains(const std::string& name);
+    static std::vector<std::string> names();
+};
+
+#endif // INTEGRAND_REGISTRY_HPP
@@ -0,0 +1,95 @@
+#ifndef INTERVAL_MAP_HPP
+#define INTERVAL_MAP_HPP
+
+#include <nlohmann/json.hpp>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using json = nlohmann::ordered_json;
+
+// Integration interval [lower, upper] and the variable u that AdaptiveGaussTree bisects.  A finite interval is
+// bisected in x itself (u = x).  An infinite end is brought to a finite u:
+//    [a, inf):      x = a + u / (1 - u),   u in [0, 1]
+//    (-inf, b]:     x = b + u / (1 + u),   u in [-1, 0]
+//    (-inf, inf):   x = u / (1 - u^2),     u in [-1, 1]
+// The tree integrates f(x(u)) x'(u) over u; the nodes that reach an infinite end are integrated in x instead
+// (Gauss-Laguerre from x(u0) outward, see AdaptiveGaussTree::evaluate_node).
+class IntervalMap {
+public:
+    enum class Kind { Finite, UpperInfinite, LowerInfinite, Infinite };
+
+    IntervalMap() = default;
+    IntervalMap(double lower, double upper) : lower(lower), upper(upper) {
+        if (std::isnan(lower) || std::isnan(upper) || lower == std::numeric_limits<double>::infinity()
+            || upper == -std::numeric_limits<double>::infinity()) {
+            throw std::runtime_error("Invalid integration interval [" + std::to_string(lower) + ", " + std::to_string(upper) + "].");
+        }
+        bool lower_inf = std::isinf(lower), upper_inf = std::isinf(upper);
+        kind = lower_inf && upper_inf ? Kind::Infinite : lower_inf ? Kind::LowerInfinite : upper_inf ? Kind::UpperInfinite : Kind::Finite;
+    }
+
+    Kind get_kind() const { return kind; }
+    bool finite() const { return kind == Kind::Finite; }
+    bool infinite_lower() const { return kind == Kind::LowerInfinite || kind == Kind::Infinite; }
+    bool infinite_upper() const { return kind == Kind::UpperInfinite || kind == Kind::Infinite; }
+    double get_lower() const { return lower; }   // x interval
+    double get_upper() const { return upper; }
+
+    // u interval (the root of the tree)
+    double u_lower() const { return finite() ? lower : infinite_lower() ? -1.0 : 0.0; }
+    double u_upper() const { return finite() ? upper : infinite_upper() ? 1.0 : 0.0; }
+
+    double x(double u) const {
+        switch (kind) {
+            case Kind::UpperInfinite: return lower + u / (1 - u);
+            case Kind::LowerInfinite: return upper + u / (1 + u);
+            case Kind::Infinite: return u / (1 - u * u);
+            default: return u;
+        }
+    }
+
+    double jacobian(double u) const {   // dx/du
+        switch (kind) {
+            case Kind::UpperInfinite: return 1 / ((1 - u) * (1 - u));
+            case Kind::LowerInfinite: return 1 / ((1 + u) * (1 + u));
+            case Kind::Infinite: return (1 + u * u) / ((1 - u * u) * (1 - u * u));
+            default: return 1.0;
+        }
+    }
+
+    double u(double x) const {   // inverse of x(u)
+        switch (kind) {
+            case Kind::UpperInfinite: return (x - lower) / (1 + (x - lower));
+            case Kind::LowerInfinite: return (x - upper) / (1 - (x - upper));
+            case Kind::Infinite: return 2 * x / (1 + std::sqrt(1 + 4 * x * x));
+            default: return x;
+        }
+    }
+
+    // Bounds in JSON: infinities as "inf" / "-inf" (JSON has no number for them)
+    static json bound_to_json(double bound) {
+        if (std::isinf(bound)) return bound > 0 ? "inf" : "-inf";
+        return bound;
+    }
+
+    static double bound_from_json(const json& value) {
+        if (value.is_number()) return value.get<double>();
+        if (value == "inf") return std::numeric_limits<double>::infinity();
+        if (value == "-inf") return -std::numeric_limits<double>::infinity();
+        throw std::runtime_error("Invalid interval bound in JSON: " + value.dump());
+    }
+
+    // Header of a tree or batch file: "lower" / "upper" (written for infinite intervals only), else the root bounds
+    static IntervalMap from_header(const json& header, double root_lower, double root_upper) {
+        if (!header.contains("lower") || !header.contains("upper")) return IntervalMap(root_lower, root_upper);
+        return IntervalMap(bound_from_json(header["lower"]), bound_from_json(header["upper"]));
+    }
+
+private:
+    Kind kind = Kind::Finite;
+    double lower = 0.0, upper = 1.0;
+};
+
+#endif // INTERVAL_MAP_HPP
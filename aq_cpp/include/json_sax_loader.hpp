@@ -0,0 +1,45 @@
+#ifndef JSON_SAX_LOADER_HPP
+#define JSON_SAX_LOADER_HPP
+
+#include <quadrature.hpp>
+#include <weights_loader.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+
+using json = nlohmann::ordered_json;
+
+class AdaptiveGaussTree;
+class AdaptiveGaussTreeBatch;
+
+// Single pass loaders for the JSON files written by AdaptiveGaussTree, AdaptiveGaussTreeBatch and the
+// quadrature root tables.  The file is parsed with the nlohmann SAX interface and tree nodes / root vectors
+// are built directly from the parse events, so no DOM is created and no subtree is ever copied.
+class JsonSaxLoader {
+public:
+    // Tree file: {"name", ..., "n1", "n2", "update_log": [...], "tree": {...}}
+    static void load_tree(const std::string& filename, AdaptiveGaussTree& tree);
+
+    // Batch file: {"name", ..., "update_log": [...], "<method>_roots_n1": [[nodes],[weights]], "parameters": {...}}
+    // The root tables are optional (write_roots = false); trees are then loaded with empty WeightsLoaders.
+    // Also reads batch logs (AdaptiveGaussTreeBatch::append_to_log): one such document per line, each starting with
+    // "aq_batch_segment".  Segments are applied in order; an incomplete last line (interrupted append) is ignored.
+    static void load_batch(const std::string& filename, AdaptiveGaussTreeBatch& batch);
+
+    // Root table: {"method", "n_max", "n": {"1": {"0": [nodes], "1": [weights]}, ...}}
+    // Eager: decodes every order.  WeightsLoader(filename) indexes the file and decodes on demand instead.
+    static void load_weights(const std::string& filename, WeightsLoader& loader);
+
+    // Parameter value stored as a JSON key:  "2" -> int,  "-0.1" / "1e-05" -> double,  anything else -> string
+    static ParamType parse_param_value(const std::string& key);
+    // The inverse: doubles are written in the shortest form that reads back to the same value, and always with a
+    // "." or an exponent, so that 2.0 stays a double ("2.0")
+    static std::string format_param_value(const ParamType& value);
+
+private:
+    class Handler;   // the json_sax implementation (json_sax_loader.cpp)
+    static void parse(const std::string& filename, Handler& handler);
+    static bool is_segment_log(const std::string& filename);
+    static void apply_batch_segment(Handler& handler, AdaptiveGaussTreeBatch& batch, bool first);
+};
+
+#endif // JSON_SAX_LOADER_HPP
@@ -2,23 +2,35 @@
 #define LAGUERRE_QUADRATURE_HPP
 
 #include <quadrature.hpp>
+#include <cmath>
 
 class LaguerreQuadrature : public Quadrature {
 private:
     bool use_weight_function;  // Flag to apply weight function (default: true)
+    double origin = 0.0, scale = 1.0;   // x = origin + scale * t
 
-    // Laguerre weight function 
+    // Laguerre weight function (of x; |scale| is the Jacobian)
     virtual double laguerre_weight_function(double t) const {
-        return std::exp(t);
+        return std::abs(scale) * std::exp((t - origin) / scale);
+    }
+
+protected:
+    double point_weight(double x) const override {
+        return use_weight_function ? laguerre_weight_function(x) : std::abs(scale);
     }
 
 public:
     // Constructor with optional use_weight_function argument
     LaguerreQuadrature(const WeightsLoader& loader, int n1, int n2, bool use_weight_function = true);
 
+    // Integral over [origin, inf) (scale > 0) or (-inf, origin] (scale < 0) through x = origin + scale * t; the rule is 
+    // exact for f(x) = exp(-|x - origin| / |scale|) times a polynomial.  Order n1 from loader1, n2 from loader2.
+    LaguerreQuadrature(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2, double origin, double scale,
+                       bool use_weight_function = true);
+
     double integrate( std::function<double(ParamMap, double)> func, ParamMap parameters) override;
 
-    // Laguerre maps [-1,1] to [0,∞) (no transformation needed)
+    // Laguerre nodes lie in [0,∞) (no transformation needed unless shifted or scaled)
     virtual double transformVariable(double t) const override;
 };
 
@@ -15,6 +15,9 @@ protected:
 public:
     // ✅ Constructor requires lower & upper and sets `leftIsSingular` and `alpha`
     LaguerreSingularEndpoint(const WeightsLoader& loader, int n1, int n2, double lower, double upper, bool leftIsSingular = true, double alpha = 0);
+    // Order n1 from loader1, the error rule of order n2 from loader2
+    LaguerreSingularEndpoint(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2, double lower, double upper,
+                             bool leftIsSingular = true, double alpha = 0);
 
     // ✅ Override transformVariable based on singularity position
     double transformVariable(double t) const override;
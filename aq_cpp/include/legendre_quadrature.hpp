@@ -10,6 +10,8 @@
 class LegendreQuadrature : public Quadrature {
 public:
     LegendreQuadrature(const WeightsLoader& loader, int n1, int n2, double lower, double upper);
+    // Order n1 from loader1, the error rule of order n2 from loader2
+    LegendreQuadrature(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2, double lower, double upper);
 
     double integrate( std::function<double(ParamMap, double)> func, ParamMap parameters) override;
 
@@ -0,0 +1,103 @@
+#ifndef LOOKUP_SERVICE_HPP
+#define LOOKUP_SERVICE_HPP
+
+#include <batch_snapshot.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Integral lookups from batch files held by a local server (tools/aq_server.cpp), so that short-lived jobs neither
+// parse the files nor build trees.  Client and server talk over a Unix domain socket; every message is a uint64 byte
+// count followed by that many bytes, numbers in the byte order of the host:
+//    request   u8 op; op Lookup: str table, u32 K, K x str key, u32 N, N x K values
+//                     op Tables: nothing
+//    response  u8 status (0: ok, 1: error, followed by str message); Lookup: N x (f64 integral, f64 error)
+//                                                                     Tables: u32 T, T x (str name, u64 trees)
+// str is a u32 length and the bytes; a value is a u8 type and an i64 (type 0, int), f64 (1, double) or str (2, string).
+// A table is a batch file, named by its stem (polylogs.json -> "polylogs").  A lookup whose N is not backed by the bytes
+// of its values (or that has N > 0 and K = 0), or whose response would exceed max_message, gets an error response.
+namespace LookupProtocol {
+    enum Op : std::uint8_t { Lookup = 1, Tables = 2 };
+    enum Status : std::uint8_t { Ok = 0, Error = 1 };
+    constexpr std::uint64_t max_message = std::uint64_t(1) << 30;
+}
+
+// Serves the batch files `filenames` on `socket_path` until stop() (or destruction).  Every table is a BatchSnapshot
+// in a SnapshotSlot: each connection is served by its own thread, which reads the tables through its own
+// SnapshotSlot::Reader (no lock and no shared reference count per request), and a watcher thread
+// reloads a file every `poll_interval` seconds at most when its modification time or size changes.  A file that
+// fails to load (e.g. caught half written) keeps its previous snapshot and is tried again at every poll, changed or
+// not, until it loads; the failure is reported once per version of the file.
+// The constructor throws std::runtime_error if a file does not load, two files share a stem, or another server
+// answers on the socket (a stale socket file is replaced).
+class LookupServer {
+public:
+    LookupServer(const std::string& socket_path, const std::vector<std::string>& filenames, double poll_interval = 1.0);
+    LookupServer(const LookupServer&) = delete;
+    LookupServer& operator=(const LookupServer&) = delete;
+    ~LookupServer();
+
+    // Closes the socket and the open connections, joins the threads and removes the socket file
+    void stop();
+    // Name and number of trees of every table
+    std::vector<std::pair<std::string, std::size_t>> tables() const;
+    // Reloads done by the watcher since the start
+    std::size_t reloads() const { return reload_count.load(); }
+
+private:
+    struct Table {
+        std::string filename;
+        std::filesystem::file_time_type modified;
+        std::uintmax_t size = 0;
+        bool failed = false;   // the load of the version of modified and size failed
+        SnapshotSlot slot;
+    };
+    std::string socket_path;
+    double poll_interval;
+    std::map<std::string, std::unique_ptr<Table>> table_map;   // fixed after the constructor
+    int listen_fd = -1;
+    std::atomic<bool> stopping{false};
+    std::atomic<std::size_t> reload_count{0};
+    std::thread acceptor, watcher;
+    std::mutex watch_mutex;
+    std::condition_variable watch_wakeup;   // stop() ends the wait between two polls
+    std::mutex connections_mutex;
+    std::vector<std::pair<int, std::thread>> connections;
+
+    void accept_loop();
+    void watch_loop();
+    using Readers = std::map<const Table*, SnapshotSlot::Reader>;   // of one connection thread
+    void serve(int fd);
+    std::string answer(const std::string& request, Readers& readers) const;
+};
+
+// Connection to a LookupServer.  Methods throw std::runtime_error when the server cannot be reached or reports an
+// error (unknown table, ...).  One client is not meant to be shared by threads; open one per thread.
+class LookupClient {
+public:
+    explicit LookupClient(const std::string& socket_path);
+    LookupClient(const LookupClient&) = delete;
+    LookupClient& operator=(const LookupClient&) = delete;
+    ~LookupClient();
+
+    // (integral, error) of the tree of each combination, NaN for both where the table has none.  All combinations
+    // need the keys of the first; the value types have to be those of the batch (ParamType: an int 2 is not 2.0).
+    std::vector<std::pair<double, double>> lookup(const std::string& table, const std::vector<ParamMap>& combinations);
+    std::pair<double, double> lookup(const std::string& table, const ParamMap& combination);
+    // Name and number of trees of every table the server holds
+    std::vector<std::pair<std::string, std::size_t>> tables();
+
+private:
+    int fd = -1;
+    std::string exchange(const std::string& request);
+};
+
+#endif // LOOKUP_SERVICE_HPP
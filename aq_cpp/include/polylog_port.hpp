@@ -5,11 +5,16 @@
 #include <string>
 #include <unordered_map>  // Ensure this is included!
 #include <variant>
+#include <vector>
+#include <functional>
 
 using ParamType = std::variant<int, double, std::string>;
 using ParamMap = std::unordered_map<std::string, ParamType>;
 
 double polylog_integrand(int s, double z, double t);
 double polylog_wrapper( ParamMap parameters,  double t);
+// Vector-valued form (VectorIntegrand, quadrature.hpp): component k is polylog_integrand(s_values[k], z, t) for the 
+// parameter "z"; log(t), 1 - t z and the Gamma functions are computed once per point instead of once per s
+std::function<void(const ParamMap&, double, std::vector<double>&)> polylog_components(std::vector<int> s_values);
 
 #endif // POLYLOG_PORT_H
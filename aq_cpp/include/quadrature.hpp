@@ -2,12 +2,15 @@
 #define QUADRATURE_HPP
 
 #include <weights_loader.hpp>
+#include <summation.hpp>
 #include <functional>
 #include <unordered_map>
 #include <map>
 #include <variant>
 #include <optional>
 #include <string>
+#include <memory>
+#include <vector>
 
 using ParamType = std::variant<int, double, std::string>;  // allows for mutable parameter types
 using ParamMap = std::unordered_map<std::string, ParamType>;  // ParamMap: single set of values, e.g.:  {s: 1, z: 0.1, label: "A"}
@@ -21,6 +24,15 @@ struct ParamTypeHash { std::size_t operator()(const ParamType& param) const;}; /
 struct ParamMapHash { std::size_t operator()(const ParamMap& paramMap) const ;}; // Custom hasher for ParamMap
 struct ParamMapEqual { bool operator()(const ParamMap& lhs, const ParamMap& rhs) const ; }; // Custom equality for ParamMap 
 
+// Vector-valued integrand: writes all components at t into `out` (already sized to the number of components), so that
+// work shared by the components (logs, denominators, ...) is done once per point
+using VectorIntegrand = std::function<void(const ParamMap&, double, std::vector<double>&)>;
+// Integrand over a set of points: writes f at x[i] into out[i] (already sized to x), so that a rule is one call (e.g. a
+// NumPy or C callback through aq_c_api.h, whose per-call overhead would dominate a call per point)
+using PointsIntegrand = std::function<void(const ParamMap&, const std::vector<double>&, std::vector<double>&)>;
+// f at a single point through a PointsIntegrand (where the engine needs the ordinary form, e.g. for a loaded tree)
+std::function<double(ParamMap, double)> single_point(PointsIntegrand f);
+
 class Quadrature {
 protected:
     const WeightsLoader& weightsLoader;
@@ -29,16 +41,45 @@ protected:
     double result, error;
     std::optional<double> lowerLimit, upperLimit;
     const std::string method;  // Now enforced at compile time!    
-    std::vector<double> nodes1, weights1;
-    std::vector<double> nodes2, weights2;
+    std::shared_ptr<const QuadratureRule> rule1, rule2;  // shared with the WeightsLoader, never copied
+    const std::vector<double>& nodes1;
+    const std::vector<double>& weights1;
+    const std::vector<double>& nodes2;
+    const std::vector<double>& weights2;
+    std::vector<double> component_results, component_errors;   // integrate_components
+    // Round-off level of the order n1 sum (Summation::roundoff of the sum of |terms|), per component for vectors
+    double roundoff = 0.0;
+    std::vector<double> component_roundoffs;
+    Summation::Method summation = Summation::Method::Naive;   // of the rule sums
+
+    // Factor of the rule weight at x = transformVariable(t): the Jacobian of the map (and any weight function)
+    virtual double point_weight(double x) const;
+    // x of node i of `rule` (rule1 or rule2): transformVariable, or from the stored distance to the nearer end of 
+    // [lower, upper] for rules with complements, kept inside the interval
+    double abscissa(const QuadratureRule& rule, std::size_t i) const;
 
 public:
     // Constructor requires `method` assignment in derived classes
     Quadrature(const WeightsLoader& loader, int n1, int n2, std::optional<double> lower, std::optional<double> upper, std::string methodName);
+    // Rule of order n1 from loader1, the error rule of order n2 from loader2
+    Quadrature(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2,
+               std::optional<double> lower, std::optional<double> upper, std::string methodName);
 
     virtual ~Quadrature() = default;
     virtual double integrate( std::function<double(ParamMap, double)> func, ParamMap parameters) = 0;
     virtual double transformVariable(double t) const;
+    // All components of `func` from one evaluation per node.  getComponentResults() holds the order n1 integrals,
+    // getComponentErrors() the rule differences; returns the largest rule difference.
+    virtual double integrate_components(const VectorIntegrand& func, const ParamMap& parameters, std::size_t width);
+    // Same as integrate(), with the points of both rules (rule_points) passed to `func` in one call
+    virtual double integrate_points(const PointsIntegrand& func, const ParamMap& parameters);
+    // Integrand evaluations of one integrate() / integrate_components() / integrate_points()
+    virtual std::size_t getEvaluations() const { return nodes1.size() + nodes2.size(); }
+    // Abscissas x and weights w of the rule of order n1 (second = false) or n2, such that integrate() sums 
+    // w_i func(x_i).  Tensor products of these make the rules of AdaptiveCubature2D.
+    void rule_points(bool second, std::vector<double>& x, std::vector<double>& w) const;
+    // Summation of the rule terms in integrate() and integrate_components() (summation.hpp); Naive unless set
+    void set_summation(Summation::Method method) { summation = method; }
 
     // Getters 
     std::string get_method() const { return method; }
@@ -46,6 +87,10 @@ public:
     int getOrder2() const { return order2; }
     double getResult() const { return result; }
     double getError() const { return error; }
+    const std::vector<double>& getComponentResults() const { return component_results; }
+    const std::vector<double>& getComponentErrors() const { return component_errors; }
+    double getRoundoff() const { return roundoff; }
+    const std::vector<double>& getComponentRoundoffs() const { return component_roundoffs; }
     std::optional<double> getLowerLimit() const { return lowerLimit; }
     std::optional<double> getUpperLimit() const { return upperLimit; }
 };
@@ -0,0 +1,109 @@
+#ifndef SUMMATION_HPP
+#define SUMMATION_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+
+// Summation of the rule terms (Quadrature::integrate) and of the leaves of a tree (get_integral_and_error).  At
+// tol 1e-14 the round-off of plain `+=` over a 150-point rule is of the order of the node tolerance; the difference
+// of the two rules then measures the round-off instead of the rule, and the tree refines further than it needs to.
+//
+//   Naive         plain `+=` (the default, bit-identical with files written before)
+//   Neumaier      compensated summation (Kahan-Babuska-Neumaier), one extra add per term
+//   Pairwise      cascade of partial sums, error O(log n) ulp; the tree is summed pairwise along its own structure
+//   DoubleDouble  double-double accumulator; products are split exactly with fma
+//
+// The method is a setting of each build (the `summation` argument of AdaptiveGaussTree, AdaptiveGaussTreeBatch and
+// AdaptiveCubature2D, kept in their file headers), handed to the rules by Quadrature::set_summation.
+class Summation {
+public:
+    enum class Method { Naive, Neumaier, Pairwise, DoubleDouble };
+
+    static std::string to_string(Method method);
+    static Method from_string(const std::string& name);   // std::runtime_error for unknown names
+
+    // Round-off level of a rule sum whose terms have absolute values summing to `magnitude` (50 eps, as QUADPACK).
+    // A rule difference below it is noise of the integrand and the sum, which bisection does not reduce.
+    static double roundoff(double magnitude) { return 50 * std::numeric_limits<double>::epsilon() * magnitude; }
+
+    class Accumulator {
+    public:
+        explicit Accumulator(Method method) : mode(method) {}
+
+        void add(double x) {
+            switch (mode) {
+                case Method::Naive:
+                    sum += x;
+                    break;
+                case Method::Neumaier: {
+                    double t = sum + x;
+                    compensation += std::abs(sum) >= std::abs(x) ? (sum - t) + x : (x - t) + sum;
+                    sum = t;
+                    break;
+                }
+                case Method::Pairwise: {
+                    // partial[i] holds the sum of 2^i terms; adding a term carries like a binary counter
+                    double carry = x;
+                    int level = 0;
+                    for (std::size_t n = count; n & 1; n >>= 1) {
+                        carry = partial[level] + carry;
+                        ++level;
+                    }
+                    partial[level] = carry;
+                    ++count;
+                    break;
+                }
+                case Method::DoubleDouble:
+                    add_double_double(x, 0.0);
+                    break;
+            }
+        }
+
+        // a * b; the double-double accumulator adds the rounding error of the product as well
+        void add_product(double a, double b) {
+            if (mode != Method::DoubleDouble) {
+                add(a * b);
+                return;
+            }
+            double p = a * b;
+            add_double_double(p, std::fma(a, b, -p));
+        }
+
+        double value() const {
+            switch (mode) {
+                case Method::Neumaier:
+                case Method::DoubleDouble:
+                    return sum + compensation;
+                case Method::Pairwise: {
+                    double total = 0.0;
+                    for (int level = 0; (count >> level) != 0; ++level) {
+                        if ((count >> level) & 1) total += partial[level];
+                    }
+                    return total;
+                }
+                default:
+                    return sum;
+            }
+        }
+
+    private:
+        // (sum, compensation) += (x, x_low): TwoSum of the high parts, then renormalize
+        void add_double_double(double x, double x_low) {
+            double s = sum + x;
+            double v = s - sum;
+            double e = (sum - (s - v)) + (x - v);
+            e += compensation + x_low;
+            sum = s + e;
+            compensation = e - (sum - s);
+        }
+
+        Method mode;
+        double sum = 0.0, compensation = 0.0;
+        std::size_t count = 0;
+        double partial[64];
+    };
+};
+
+#endif // SUMMATION_HPP
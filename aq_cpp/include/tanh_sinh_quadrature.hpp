@@ -0,0 +1,33 @@
+#ifndef TANH_SINH_QUADRATURE_HPP
+#define TANH_SINH_QUADRATURE_HPP
+
+#include <quadrature.hpp>
+#include <algorithm>
+
+// Double-exponential (tanh-sinh) quadrature on [lower, upper]:  the trapezoidal rule with step h = 2^-level in t for
+//    x = tanh(pi/2 sinh t),   w = pi/2 cosh t / cosh^2(pi/2 sinh t)
+// The "order" of a rule is its level.  Level k + 1 adds the midpoints of level k and stores them after the points of
+// level k, so integrate() evaluates the finer of its two levels once and sums the coarser one from the leading points.
+// The points crowd double exponentially toward both ends and their distance to the nearer end is kept exactly
+// (QuadratureRule::complements), so algebraic and log endpoint singularities need neither alpha nor a Laguerre table.
+// The rules are computed in-process by rules(); pass that loader where the Legendre roots go:
+//    WeightsLoader tanh_sinh = TanhSinhQuadrature::rules();
+//    TanhSinhQuadrature q(tanh_sinh, 4, 5, 0.0, 1.0);   // levels 4 and 5: 389 points
+class TanhSinhQuadrature : public Quadrature {
+public:
+    static constexpr const char* method_name = "Tanh-Sinh";   // WeightsLoader::getMethod() of rules()
+
+    // Levels 0 .. max_level; t runs to where the distance to the ends drops below 1e-300
+    static WeightsLoader rules(int max_level = 8);
+
+    TanhSinhQuadrature(const WeightsLoader& loader, int n1, int n2, double lower, double upper);
+    // Level n1 from loader1, the error level n2 from loader2 (both from rules())
+    TanhSinhQuadrature(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2, double lower, double upper);
+
+    double integrate(std::function<double(ParamMap, double)> func, ParamMap parameters) override;
+    double integrate_components(const VectorIntegrand& func, const ParamMap& parameters, std::size_t width) override;
+    double integrate_points(const PointsIntegrand& func, const ParamMap& parameters) override;   // the finer level only
+    std::size_t getEvaluations() const override { return std::max(nodes1.size(), nodes2.size()); }
+};
+
+#endif // TANH_SINH_QUADRATURE_HPP
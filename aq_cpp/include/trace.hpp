@@ -0,0 +1,54 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <string>
+
+using json = nlohmann::ordered_json;
+
+// Timeline of batch and tree builds in the Chrome trace-event format (open the file in https://ui.perfetto.dev or
+// chrome://tracing).  Tracing is off until start(); then every Trace::Span records one complete event into a buffer
+// owned by the calling thread, so traced threads never wait for each other.  stop() writes the events of all threads.
+//
+//   Trace::start("build_trace.json");          // depth_levels = true adds one span per evaluated tree node
+//   AdaptiveGaussTreeBatch batch(...);
+//   batch.save_to_json("batch.json");
+//   Trace::stop();
+class Trace {
+public:
+    static void start(const std::string& filename, bool depth_levels = false);   // discards events of earlier sessions
+    // Writes the trace file (std::runtime_error if it cannot be opened).  Call it after the traced threads finished.
+    static void stop();
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    static bool depth_levels() { return levels.load(std::memory_order_relaxed); }
+    static void set_thread_name(const std::string& name);   // label of the calling thread in the viewer
+    // Adds the events of a trace written by another process (e.g. an aq_driver worker) to the current session
+    static void import_file(const std::string& filename);
+
+    // Records [construction, destruction) as one event when tracing is on, and costs one atomic load when it is off
+    class Span {
+    public:
+        explicit Span(std::string name, const char* category = "aq");
+        ~Span();
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        bool active() const { return recording; }
+        void arg(const std::string& key, json value) { if (recording) args[key] = std::move(value); }   // "args" shown in the viewer
+
+    private:
+        bool recording;
+        std::string name;
+        const char* category;
+        double start_us = 0.0;
+        json args;
+    };
+
+private:
+    static std::atomic<bool> active, levels;
+    static double now_us();   // microseconds on the steady clock
+    static void record(std::string name, const char* category, double start_us, double duration_us, json args);
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,95 @@
+#ifndef TREE_STATS_HPP
+#define TREE_STATS_HPP
+
+#include <nlohmann/json.hpp>
+#include <vector>
+#include <cstddef>
+
+using json = nlohmann::ordered_json;
+
+// Build statistics of AdaptiveGaussTree / AdaptiveGaussTreeBatch.  Counting is compiled in by default; build with
+// -DAQ_STATS=0 to remove it (TreeStats then stays empty and `enabled` is false).
+#ifndef AQ_STATS
+#define AQ_STATS 1
+#endif
+
+struct TreeStats {
+    static constexpr bool enabled = AQ_STATS != 0;
+
+    std::size_t evaluations = 0;                 // integrand calls (n1 + n2 per Gauss node evaluation)
+    std::vector<std::size_t> nodes_per_depth;    // evaluated nodes at depth 0, 1, ...
+    std::size_t legendre_nodes = 0, laguerre_nodes = 0;
+    std::size_t failed_leaves = 0;               // leaves stopped by max_depth with error >= tolerance
+    std::size_t roundoff_leaves = 0;             // leaves whose error >= tolerance is round-off (summation.hpp)
+    std::size_t order_raises = 0;                // hp mode: re-evaluations of a node at higher orders
+    std::size_t endpoint_switches = 0;           // singularity detection: nodes re-evaluated with Gauss-Laguerre
+    std::size_t tail_switches = 0;               // infinite intervals: tail nodes re-evaluated with Gauss-Legendre
+    std::size_t extrapolations = 0;              // endpoint chains closed by Wynn's epsilon algorithm
+    double quadrature_seconds = 0.0;             // inside Quadrature::integrate (integrand evaluations)
+    double total_seconds = 0.0;                  // whole build; the difference is tree bookkeeping
+
+    std::size_t nodes() const { return legendre_nodes + laguerre_nodes; }
+    int depth_reached() const { return static_cast<int>(nodes_per_depth.size()) - 1; }
+    double bookkeeping_seconds() const { return total_seconds - quadrature_seconds; }
+
+    // Why a node that was counted before is evaluated again; only the work is added
+    enum class Repeat { None, OrderRaise, EndpointSwitch, TailSwitch };
+
+    void count_node(int depth, bool laguerre, std::size_t node_evaluations, double seconds, Repeat repeat = Repeat::None) {
+        evaluations += node_evaluations;
+        quadrature_seconds += seconds;
+        if (repeat == Repeat::OrderRaise) {
+            ++order_raises;
+            return;
+        }
+        if (repeat == Repeat::TailSwitch) {   // stays counted with the rule of its first evaluation
+            ++tail_switches;
+            return;
+        }
+        if (repeat == Repeat::EndpointSwitch) {   // counted as a Gauss-Legendre node before
+            ++endpoint_switches;
+            --legendre_nodes;
+            ++laguerre_nodes;
+            return;
+        }
+        if (static_cast<std::size_t>(depth) >= nodes_per_depth.size()) nodes_per_depth.resize(depth + 1, 0);
+        ++nodes_per_depth[depth];
+        (laguerre ? laguerre_nodes : legendre_nodes) += 1;
+    }
+
+    TreeStats& operator+=(const TreeStats& other) {
+        evaluations += other.evaluations;
+        if (other.nodes_per_depth.size() > nodes_per_depth.size()) nodes_per_depth.resize(other.nodes_per_depth.size(), 0);
+        for (std::size_t d = 0; d < other.nodes_per_depth.size(); ++d) nodes_per_depth[d] += other.nodes_per_depth[d];
+        legendre_nodes += other.legendre_nodes;
+        laguerre_nodes += other.laguerre_nodes;
+        failed_leaves += other.failed_leaves;
+        roundoff_leaves += other.roundoff_leaves;
+        order_raises += other.order_raises;
+        endpoint_switches += other.endpoint_switches;
+        tail_switches += other.tail_switches;
+        extrapolations += other.extrapolations;
+        quadrature_seconds += other.quadrature_seconds;
+        total_seconds += other.total_seconds;
+        return *this;
+    }
+
+    json to_json() const {
+        return {
+            {"evaluations", evaluations},
+            {"nodes_per_depth", nodes_per_depth},
+            {"legendre_nodes", legendre_nodes},
+            {"laguerre_nodes", laguerre_nodes},
+            {"failed_leaves", failed_leaves},
+            {"roundoff_leaves", roundoff_leaves},
+            {"order_raises", order_raises},
+            {"endpoint_switches", endpoint_switches},
+            {"tail_switches", tail_switches},
+            {"extrapolations", extrapolations},
+            {"quadrature_seconds", quadrature_seconds},
+            {"total_seconds", total_seconds}
+        };
+    }
+};
+
+#endif // TREE_STATS_HPP
@@ -3,28 +3,77 @@
 
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 #include <string>
 #include <unordered_map>
+#include <map>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::ordered_json;
 
+class JsonSaxLoader;
+
+// One decoded quadrature rule.  Immutable once built and shared through std::shared_ptr<const QuadratureRule>.
+struct QuadratureRule {
+    std::vector<double> nodes;
+    std::vector<double> weights;
+    std::vector<double> complements;   // 1 - |node| where rounding 1 - |node| loses it (tanh-sinh); empty otherwise
+};
+
+// Byte offset index of a root table file ({"method", "n_max", "n": {order: {"0": nodes, "1": weights}}}).
+// Built by one scan of the file; an order is only decoded the first time it is requested, and the decoded
+// rule is kept and handed out to every WeightsLoader that opened the same file.  The offsets belong to the version of 
+// the file that was scanned: getRule throws std::runtime_error for an order not decoded yet once the file has been 
+// rewritten (other modification time or size), and RuleIndex::open indexes the new version.
+class RuleIndex {
+private:
+    std::string filename;
+    std::string method;
+    int n_max = 0;
+    std::map<int, std::pair<std::streamoff, std::size_t>> offsets;   // order -> (byte offset, length) of its object
+    std::filesystem::file_time_type modified;                        // of the scanned version
+    std::uintmax_t size = 0;
+    mutable std::mutex mutex;
+    mutable std::unordered_map<int, std::shared_ptr<const QuadratureRule>> decoded;
+
+public:
+    explicit RuleIndex(const std::string& filename);
+
+    // Process-wide registry: one index per file, shared while any WeightsLoader holds it
+    static std::shared_ptr<RuleIndex> open(const std::string& filename);
+    static std::size_t registered();                               // registry entries (expired ones are pruned by open)
+
+    std::shared_ptr<const QuadratureRule> getRule(int n) const;   // thread safe
+    bool hasOrder(int n) const { return offsets.count(n) != 0; }
+    std::string getMethod() const { return method; }
+    int getNMax() const { return n_max; }
+    std::size_t decodedCount() const;                              // orders decoded so far
+};
+
 class WeightsLoader {
+    friend class JsonSaxLoader;   // SAX load of the root tables (json_sax_loader.hpp)
 private:
-    std::unordered_map<int, std::vector<double>> nodes;
-    std::unordered_map<int, std::vector<double>> weights;
+    std::shared_ptr<RuleIndex> index;                                     // file backed, decoded on demand
+    std::unordered_map<int, std::shared_ptr<const QuadratureRule>> rules;  // in memory (embedded or eager loads)
     std::string method;  //  e.g. "Legendre" from header
-    int n_max;  // New field to store maximum order
+    int n_max = 0;  // New field to store maximum order
 
 public:
     WeightsLoader(){};
-    // Constructor that loads a weights JSON file
+    // Constructor that indexes a weights JSON file.  Orders are decoded lazily (see RuleIndex)
     WeightsLoader(const std::string& filename);
     // This Constructor loads a single weight set as generated in the adaptive quadrature jsons. Uses the dictonary keys
     // WeightsLoader(..., "legendre_roots_n1", "Legendre","n1")
-    WeightsLoader(json js, const std::string& key, const std::string& method, const std::string& n_key); 
+    WeightsLoader(json js, const std::string& key, const std::string& method, const std::string& n_key);
+    // Single weight set from already extracted vectors (e.g. the roots stored in a batch file)
+    WeightsLoader(const std::string& method, int n, std::vector<double> nodes, std::vector<double> weights);
+    // Several orders computed in memory (TanhSinhQuadrature::rules); n_max is the highest
+    WeightsLoader(const std::string& method, std::map<int, QuadratureRule> computed);
     // Getter functions
+    std::shared_ptr<const QuadratureRule> getRule(int n) const;   // shared, no copy
     std::vector<double> getNodes(int n) const;
     std::vector<double> getWeights(int n) const;
     std::string getMethod() const;
@@ -0,0 +1,56 @@
+#ifndef WYNN_EPSILON_HPP
+#define WYNN_EPSILON_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Wynn's epsilon algorithm (as QUADPACK's qelg in QAGS): the limit of a slowly converging sequence of partial sums
+//    eps_{-1}(n) = 0,  eps_0(n) = S_n,  eps_{k+1}(n) = eps_{k-1}(n+1) + 1 / (eps_k(n+1) - eps_k(n))
+// The even columns are the extrapolations; limit() is the last entry of the highest one.  The error estimate is the
+// distance of the last limit from the two before it (infinite until there are three), at least 5 eps |limit|.
+//
+//   WynnEpsilon wynn;
+//   for (...) wynn.add(partial_sum);
+//   if (wynn.error() < tol) use(wynn.limit());
+class WynnEpsilon {
+public:
+    void add(double partial_sum) {
+        sums.push_back(partial_sum);
+        limits.push_back(extrapolate());
+    }
+
+    std::size_t size() const { return sums.size(); }
+    double limit() const { return limits.empty() ? 0.0 : limits.back(); }
+
+    double error() const {
+        const std::size_t n = limits.size();
+        if (n < 3) return std::numeric_limits<double>::infinity();
+        double distance = std::abs(limits[n - 1] - limits[n - 2]) + std::abs(limits[n - 1] - limits[n - 3]);
+        return std::max(distance, 5 * std::numeric_limits<double>::epsilon() * std::abs(limits[n - 1]));
+    }
+
+private:
+    // The table is rebuilt for every term: the sequences along a tree are at most max_depth long
+    double extrapolate() const {
+        std::vector<double> previous(sums.size() + 1, 0.0), current = sums;   // columns k - 1 and k
+        double best = sums.back();
+        for (std::size_t k = 1; current.size() > 1; ++k) {
+            std::vector<double> next(current.size() - 1);
+            for (std::size_t i = 0; i + 1 < current.size(); ++i) {
+                double difference = current[i + 1] - current[i];
+                if (difference == 0.0) return current[i + 1];   // converged to the last bit
+                next[i] = previous[i + 1] + 1.0 / difference;
+            }
+            previous = std::move(current);
+            current = std::move(next);
+            if (k % 2 == 0) best = current.back();
+        }
+        return best;
+    }
+
+    std::vector<double> sums, limits;
+};
+
+#endif // WYNN_EPSILON_HPP
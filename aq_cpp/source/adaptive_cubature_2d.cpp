@@ -0,0 +1,371 @@
+#include <adaptive_cubature_2d.hpp>
+#include <legendre_quadrature.hpp>
+#include <laguerre_singular_endpoint.hpp>
+#include <summation.hpp>
+#include <trace.hpp>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+AdaptiveCubature2D::AdaptiveCubature2D(
+    Integrand2D f,
+    double ax, double bx, double ay, double by, double tol, int minD, int maxD,
+    int n1, int n2,
+    SingularEdges edges,
+    WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2,
+    ParamMap args,
+    std::string name, std::string author, std::string description,
+    std::string reference, std::string version, std::string update_log_message, Summation::Method summation)
+    : func(f), ax(ax), bx(bx), ay(ay), by(by), tolerance(tol), min_depth(minD), max_depth(maxD),
+      order1(n1), order2(n2), edges(edges),
+      roots_legendre_n1(rl1), roots_legendre_n2(rl2), roots_laguerre_n1(ll1), roots_laguerre_n2(ll2), args(args), summation(summation),
+      name(name), reference(reference), description(description), author(author), version(version) {
+    if (!std::isfinite(ax) || !std::isfinite(bx) || !std::isfinite(ay) || !std::isfinite(by) || !(ax < bx) || !(ay < by)) {
+        throw std::runtime_error("AdaptiveCubature2D needs a finite rectangle with ax < bx and ay < by.");
+    }
+    add_update_log(update_log_message);
+    root = std::make_unique<Node>(ax, bx, ay, by, 0, tol);
+    build();
+}
+
+AdaptiveCubature2D::AdaptiveCubature2D(Integrand2D f, WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2,
+                                       const std::string& filename, ParamMap args)
+    : func(f), ax(0.0), bx(1.0), ay(0.0), by(1.0), tolerance(0.0), min_depth(0), max_depth(0), order1(0), order2(0),
+      roots_legendre_n1(rl1), roots_legendre_n2(rl2), roots_laguerre_n1(ll1), roots_laguerre_n2(ll2), args(args) {
+    load_from_json(filename);
+}
+
+AdaptiveCubature2D::AdaptiveCubature2D(const AdaptiveCubature2D& other)
+    : func(other.func), ax(other.ax), bx(other.bx), ay(other.ay), by(other.by), tolerance(other.tolerance),
+      min_depth(other.min_depth), max_depth(other.max_depth), order1(other.order1), order2(other.order2), edges(other.edges),
+      roots_legendre_n1(other.roots_legendre_n1), roots_legendre_n2(other.roots_legendre_n2),
+      roots_laguerre_n1(other.roots_laguerre_n1), roots_laguerre_n2(other.roots_laguerre_n2), args(other.args),
+      summation(other.summation), root(clone_tree(other.root.get())),
+      name(other.name), reference(other.reference), description(other.description), author(other.author), version(other.version),
+      update_log(other.update_log), stats(other.stats) {}
+
+std::unique_ptr<AdaptiveCubature2D::Node> AdaptiveCubature2D::clone_tree(const Node* node) {
+    if (!node) return nullptr;
+    auto copy = std::make_unique<Node>(node->ax, node->bx, node->ay, node->by, node->depth, node->tolerance);
+    copy->result = node->result;
+    copy->error = node->error;
+    copy->laguerre_x = node->laguerre_x;
+    copy->laguerre_y = node->laguerre_y;
+    copy->split = node->split;
+    copy->roundoff_limited = node->roundoff_limited;
+    for (const auto& child : node->children) copy->children.push_back(clone_tree(child.get()));
+    return copy;
+}
+
+std::unique_ptr<Quadrature> AdaptiveCubature2D::axis_quadrature(double lower, double upper, double root_lower, double root_upper,
+                                                                const SingularEdge& lower_edge, const SingularEdge& upper_edge) const {
+    if (lower_edge.singular && lower == root_lower) {
+        return std::make_unique<LaguerreSingularEndpoint>(roots_laguerre_n1, roots_laguerre_n2, order1, order2, lower, upper, true, lower_edge.alpha);
+    }
+    if (upper_edge.singular && upper == root_upper) {
+        return std::make_unique<LaguerreSingularEndpoint>(roots_laguerre_n1, roots_laguerre_n2, order1, order2, lower, upper, false, upper_edge.alpha);
+    }
+    return std::make_unique<LegendreQuadrature>(roots_legendre_n1, roots_legendre_n2, order1, order2, lower, upper);
+}
+
+void AdaptiveCubature2D::evaluate_node(Node* node) {
+#if AQ_STATS
+    auto start = std::chrono::steady_clock::now();
+#endif
+    std::unique_ptr<Quadrature> qx = axis_quadrature(node->ax, node->bx, ax, bx, edges.x_lower, edges.x_upper);
+    std::unique_ptr<Quadrature> qy = axis_quadrature(node->ay, node->by, ay, by, edges.y_lower, edges.y_upper);
+    node->laguerre_x = qx->get_method() == "Gauss-Laguerre";
+    node->laguerre_y = qy->get_method() == "Gauss-Laguerre";
+
+    // abscissas of both rules of an axis, order n1 first: the grid holds the four tensor products
+    std::vector<double> x, wx, y, wy, x2, wx2, y2, wy2;
+    qx->rule_points(false, x, wx);
+    qx->rule_points(true, x2, wx2);
+    qy->rule_points(false, y, wy);
+    qy->rule_points(true, y2, wy2);
+    const std::size_t nx1 = x.size(), ny1 = y.size();
+    x.insert(x.end(), x2.begin(), x2.end());
+    wx.insert(wx.end(), wx2.begin(), wx2.end());
+    y.insert(y.end(), y2.begin(), y2.end());
+    wy.insert(wy.end(), wy2.begin(), wy2.end());
+
+    Summation::Accumulator q11(summation), q22(summation), q21(summation), q12(summation);   // Q(x order, y order)
+    double magnitude = 0.0;
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        for (std::size_t j = 0; j < y.size(); ++j) {
+            double f = func(args, x[i], y[j]);
+            double w = wx[i] * wy[j];
+            if (i < nx1 && j < ny1) {
+                q11.add_product(w, f);
+                magnitude += std::abs(w * f);
+            } else if (i >= nx1 && j >= ny1) {
+                q22.add_product(w, f);
+            } else if (i >= nx1) {
+                q21.add_product(w, f);
+            } else {
+                q12.add_product(w, f);
+            }
+        }
+    }
+    node->result = q11.value();
+    node->error = std::abs(node->result - q22.value());
+    node->error_x = std::abs(node->result - q21.value());
+    node->error_y = std::abs(node->result - q12.value());
+    node->roundoff_limited = summation != Summation::Method::Naive && node->error >= node->tolerance
+                             && node->error <= Summation::roundoff(magnitude);
+#if AQ_STATS
+    stats.count_node(node->depth, node->laguerre_x || node->laguerre_y, x.size() * y.size(),
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+#endif
+}
+
+void AdaptiveCubature2D::split_node(Node* node, const std::string& axes) {
+    node->split = axes;
+    const double mx = (node->ax + node->bx) / 2, my = (node->ay + node->by) / 2;
+    const int depth = node->depth + 1;
+    if (axes == "x") {
+        node->children.push_back(std::make_unique<Node>(node->ax, mx, node->ay, node->by, depth, node->tolerance / 2));
+        node->children.push_back(std::make_unique<Node>(mx, node->bx, node->ay, node->by, depth, node->tolerance / 2));
+    } else if (axes == "y") {
+        node->children.push_back(std::make_unique<Node>(node->ax, node->bx, node->ay, my, depth, node->tolerance / 2));
+        node->children.push_back(std::make_unique<Node>(node->ax, node->bx, my, node->by, depth, node->tolerance / 2));
+    } else {
+        node->children.push_back(std::make_unique<Node>(node->ax, mx, node->ay, my, depth, node->tolerance / 4));
+        node->children.push_back(std::make_unique<Node>(mx, node->bx, node->ay, my, depth, node->tolerance / 4));
+        node->children.push_back(std::make_unique<Node>(node->ax, mx, my, node->by, depth, node->tolerance / 4));
+        node->children.push_back(std::make_unique<Node>(mx, node->bx, my, node->by, depth, node->tolerance / 4));
+    }
+}
+
+void AdaptiveCubature2D::build() {
+    Trace::Span span("cubature/build", "tree");
+#if AQ_STATS
+    auto build_start = std::chrono::steady_clock::now();
+#endif
+    std::vector<Node*> stack{root.get()};
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        evaluate_node(node);
+
+        // A rectangle spanning an axis with both edges singular has to be split along it (one Laguerre end per rule)
+        bool split_x = edges.x_lower.singular && edges.x_upper.singular && node->ax == ax && node->bx == bx;
+        bool split_y = edges.y_lower.singular && edges.y_upper.singular && node->ay == ay && node->by == by;
+        bool refine = node->error >= node->tolerance && !node->roundoff_limited;
+        std::string axes;
+        if (node->depth < min_depth) {
+            axes = "xy";
+        } else if (node->depth < max_depth && (split_x || split_y)) {
+            axes = split_x && split_y ? "xy" : split_x ? "x" : "y";
+        } else if (node->depth < max_depth && refine) {
+            axes = node->error_x > 2 * node->error_y ? "x" : node->error_y > 2 * node->error_x ? "y" : "xy";
+        }
+        if (!axes.empty()) {
+            split_node(node, axes);
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) stack.push_back(it->get());
+        }
+#if AQ_STATS
+        else if (node->roundoff_limited) {
+            ++stats.roundoff_leaves;
+        }
+        else if (node->error >= node->tolerance) {
+            ++stats.failed_leaves;   // max_depth reached before the tolerance was met
+        }
+#endif
+    }
+#if AQ_STATS
+    stats.total_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count();
+#endif
+    if (span.active()) span.arg("nodes", node_count());
+}
+
+std::pair<double, double> AdaptiveCubature2D::get_integral_and_error() const {
+    Summation::Accumulator integral(summation), error(summation);
+    std::vector<const Node*> stack{root.get()};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (node->children.empty()) {
+            integral.add(node->result);
+            error.add(node->error);
+            continue;
+        }
+        for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) stack.push_back(it->get());
+    }
+    return {integral.value(), error.value()};
+}
+
+std::size_t AdaptiveCubature2D::node_count() const {
+    std::size_t count = 0;
+    std::vector<const Node*> stack{root.get()};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        ++count;
+        for (const auto& child : node->children) stack.push_back(child.get());
+    }
+    return count;
+}
+
+std::size_t AdaptiveCubature2D::roundoff_limited_leaves() const {
+    std::size_t count = 0;
+    std::vector<const Node*> stack{root.get()};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (node->children.empty() && node->roundoff_limited) ++count;
+        for (const auto& child : node->children) stack.push_back(child.get());
+    }
+    return count;
+}
+
+void AdaptiveCubature2D::add_update_log(const std::string& message) {
+    std::time_t now = std::time(nullptr);
+    char timestamp[20];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+    update_log.emplace_back(timestamp, message);
+}
+
+void AdaptiveCubature2D::print_update_log() const {
+    for (const auto& entry : update_log) {
+        std::cout << "[" << entry.first << "] " << entry.second << std::endl;
+    }
+}
+
+json AdaptiveCubature2D::edge_to_json(const SingularEdges& edges) {
+    json data = json::object();
+    auto add = [&data](const char* key, const SingularEdge& edge) {
+        if (edge.singular) data[key] = {{"alpha", edge.alpha}};
+    };
+    add("x_lower", edges.x_lower);
+    add("x_upper", edges.x_upper);
+    add("y_lower", edges.y_lower);
+    add("y_upper", edges.y_upper);
+    return data;
+}
+
+SingularEdges AdaptiveCubature2D::edges_from_json(const json& data) {
+    SingularEdges edges;
+    auto read = [&data](const char* key, SingularEdge& edge) {
+        if (!data.contains(key)) return;
+        edge.singular = true;
+        edge.alpha = data[key].value("alpha", 0.0);
+    };
+    read("x_lower", edges.x_lower);
+    read("x_upper", edges.x_upper);
+    read("y_lower", edges.y_lower);
+    read("y_upper", edges.y_upper);
+    return edges;
+}
+
+json AdaptiveCubature2D::serialize_tree(const Node* node) const {
+    json data = {
+        {"x", {node->ax, node->bx}},
+        {"y", {node->ay, node->by}},
+        {"depth", node->depth},
+        {"tol", node->tolerance},
+        {"error", node->error},
+        {"integral", node->result},
+        {"method_x", node->laguerre_x ? "Gauss-Laguerre" : "Gauss-Legendre"},
+        {"method_y", node->laguerre_y ? "Gauss-Laguerre" : "Gauss-Legendre"}
+    };
+    if (node->children.empty() && node->roundoff_limited) data["roundoff_limited"] = true;
+    if (!node->children.empty()) {
+        data["split"] = node->split;
+        json children = json::array();
+        for (const auto& child : node->children) children.push_back(serialize_tree(child.get()));
+        data["children"] = children;
+    }
+    return data;
+}
+
+std::unique_ptr<AdaptiveCubature2D::Node> AdaptiveCubature2D::deserialize_tree(const json& data) const {
+    auto node = std::make_unique<Node>(data["x"][0], data["x"][1], data["y"][0], data["y"][1], data["depth"], data["tol"]);
+    node->error = data["error"];
+    node->result = data["integral"];
+    node->laguerre_x = data["method_x"] == "Gauss-Laguerre";
+    node->laguerre_y = data["method_y"] == "Gauss-Laguerre";
+    node->roundoff_limited = data.value("roundoff_limited", false);
+    if (data.contains("children")) {
+        node->split = data["split"];
+        std::size_t expected = node->split == "xy" ? 4 : 2;
+        if (data["children"].size() != expected) {
+            throw std::runtime_error("Invalid cubature tree: split \"" + node->split + "\" with " + std::to_string(data["children"].size()) + " children");
+        }
+        for (const auto& child : data["children"]) node->children.push_back(deserialize_tree(child));
+    }
+    return node;
+}
+
+void AdaptiveCubature2D::save_to_json(const std::string& filename, bool overwrite, bool dump_log, bool write_stats) const {
+    if (std::filesystem::exists(filename) && !overwrite) {
+        std::cerr << "File \"" << filename << "\" exists. Set overwrite = true to overwrite." << std::endl;
+        return;
+    }
+    Trace::Span span("cubature/save", "io");
+    json data;
+    data["name"] = name;
+    data["reference"] = reference;
+    data["description"] = description;
+    data["author"] = author;
+    data["version"] = version;
+    data["tolerance"] = tolerance;
+    data["min_depth"] = min_depth;
+    data["max_depth"] = max_depth;
+    data["n1"] = order1;
+    data["n2"] = order2;
+    data["x"] = {ax, bx};
+    data["y"] = {ay, by};
+    data["singular_edges"] = edge_to_json(edges);
+    if (summation != Summation::Method::Naive) data["summation"] = Summation::to_string(summation);
+    json log_json = json::array();
+    for (const auto& entry : update_log) {
+        log_json.push_back({{"timestamp", entry.first}, {"message", entry.second}});
+    }
+    if (!dump_log) {
+        data["update_log"] = log_json;
+    }
+    if (write_stats) data["stats"] = stats.to_json();
+    data["tree"] = serialize_tree(root.get());
+    std::ofstream file(filename);
+    file << data.dump(4);
+}
+
+void AdaptiveCubature2D::load_from_json(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Error opening file: " + filename);
+    }
+    Trace::Span span("cubature/load", "io");
+    json data = json::parse(file);
+    if (!data.contains("x") || !data.contains("y") || !data.contains("tree")) {
+        throw std::runtime_error("Not a 2D cubature file: " + filename);
+    }
+    name = data["name"];
+    reference = data["reference"];
+    description = data["description"];
+    author = data["author"];
+    version = data["version"];
+    tolerance = data["tolerance"];
+    min_depth = data["min_depth"];
+    max_depth = data["max_depth"];
+    order1 = data["n1"];
+    order2 = data["n2"];
+    ax = data["x"][0];
+    bx = data["x"][1];
+    ay = data["y"][0];
+    by = data["y"][1];
+    edges = edges_from_json(data.value("singular_edges", json::object()));
+    summation = Summation::from_string(data.value("summation", "naive"));
+    update_log.clear();
+    if (data.contains("update_log")) {
+        for (const auto& entry : data["update_log"]) {
+            update_log.emplace_back(entry["timestamp"], entry["message"]);
+        }
+    }
+    stats = TreeStats();
+    root = deserialize_tree(data["tree"]);
+}
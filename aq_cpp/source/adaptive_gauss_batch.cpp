@@ -1,134 +1,278 @@
 #include <adaptive_gauss_batch.hpp>
+#include <json_sax_loader.hpp>
 
-// Constructor for loading from a serialized JSON tree
-AdaptiveGaussTreeBatch::AdaptiveGaussTreeBatch(
-    std::function<double(ParamMap, double)> func,
-    std::string filename
-): func(func), lower(0.0), upper(1.0), alphaA(0.0), alphaB(0.0) {
-    std::ifstream file(filename);
-    if (!file) {
-        throw std::runtime_error("Error opening file: " + filename);
+namespace {
+
+// Bookkeeping of a BatchControl while the trees are built: the stop predicate handed to every tree, and the progress
+// reports (after each tree, and from the tree checkpoint hook within one)
+class BuildMonitor {
+public:
+    BuildMonitor(const BatchControl& control, std::size_t trees) : control(control) { progress.trees_total = trees; }
+
+    // nullptr without a cancel flag and a deadline, so that an unbounded build does not pay for the checks
+    std::function<bool()> stop() const {
+        if (!control.cancel && !control.deadline) return nullptr;
+        return [this] { return cancelled() || (control.deadline && std::chrono::steady_clock::now() >= *control.deadline); };
     }
+    bool reporting() const { return static_cast<bool>(control.progress); }
+    double interval() const { return control.progress_interval; }
 
-    json data;
-    file >> data;
-
-    // Load basic metadata
-    name = data["name"];
-    reference = data["reference"];
-    description = data["description"];
-    author = data["author"];
-    version = data["version"];
-    tol = data["tol"].get<double>();
-    min_depth = data["min_depth"].get<int>();
-    max_depth = data["max_depth"].get<int>();
-    order1 = data["n1"].get<int>();
-    order2 = data["n2"].get<int>();
-    a_singular = data["a_singular"];
-    b_singular = data["b_singular"];
-
-    // Load weights for quadrature
-   
-    legendre_n1 = WeightsLoader(data, "legendre_roots_n1", "Legendre", "n1");
-    legendre_n2 = WeightsLoader(data, "legendre_roots_n2", "Legendre", "n2");
-    laguerre_n1 = WeightsLoader(data, "laguerre_roots_n1", "Laguerre", "n1");
-    laguerre_n2 = WeightsLoader(data, "laguerre_roots_n2", "Laguerre", "n2");
-
-    // Load update log
-
-    if (data.contains("update_log") && data["update_log"].is_array()) {
-        update_log.clear();
-        for (const auto& entry : data["update_log"]) {
-            if (entry.contains("timestamp") && entry.contains("message")) {
-                std::string timestamp = entry["timestamp"].get<std::string>();
-                std::string message = entry["message"].get<std::string>();
-                update_log.emplace_back(timestamp, message);
-            }
-        }
-    } else {
-        throw std::runtime_error("Invalid format for update_log: Expected an array of objects.");
+    void tree_running(const AdaptiveGaussTree& tree) {
+        BatchProgress current = progress;
+        current.evaluations += tree.get_stats().evaluations;
+        control.progress(current);
     }
-    
-    // Parse the parameters section
 
-    if (data.contains("parameters")) {
-        json parameters_json = data["parameters"];
-        
-        // Extract keys
-        std::set<std::string> key_set;
-        extract_keys(parameters_json, key_set);
-        keys.assign(key_set.begin(), key_set.end());
+    // Cancellation is reported once the tree it cut short is closed
+    void tree_done(const AdaptiveGaussTree& tree) {
+        if (cancelled()) throw std::runtime_error("Batch build cancelled.");
+        ++progress.trees_done;
+        progress.evaluations += tree.get_stats().evaluations;
+        progress.worst_error = std::max(progress.worst_error, tree.get_integral_and_error().second);
+        if (reporting()) control.progress(progress);
+    }
 
-        // Recursively extract parameter sets and trees
+private:
+    const BatchControl& control;
+    BatchProgress progress;
 
-        extract_parameters(parameters_json, parameters);
-    }
-   
-    std::vector<int> s_values = std::get<std::vector<int>>(parameters["s"]);
+    bool cancelled() const { return control.cancel && control.cancel->load(std::memory_order_relaxed); }
+};
 
-    std::vector<double> z_values = std::get<std::vector<double>>(parameters["z"]);
-  
+}  // namespace
 
-    // Generate all possible parameter combinations
+// Constructor for loading from a serialized JSON tree (single pass, see json_sax_loader.hpp)
+AdaptiveGaussTreeBatch::AdaptiveGaussTreeBatch(
+    std::function<double(ParamMap, double)> func,
+    std::string filename
+): func(func), lower(0.0), upper(1.0), alphaA(0.0), alphaB(0.0) {
+    JsonSaxLoader::load_batch(filename, *this);
+}
 
-    std::vector<size_t> indices(keys.size(), 0);
+AdaptiveGaussTreeBatch::AdaptiveGaussTreeBatch(
+    std::function<double(ParamMap, double)> func,
+    double lower, double upper,
+    double tol, int min_depth, int max_depth, int n1, int n2,
+    double alphaA, double alphaB,
+    bool a_singular, bool b_singular,
+    WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+    std::vector<ParamMap> combinations,
+    std::string name, std::string author, std::string description,
+    std::string reference, std::string version, std::string update_log_message,
+    HpRefinement hp, SingularityDetection detect, BreakpointFunction breakpoints, Summation::Method summation
+) : func(func),
+    tol(tol), lower(lower), upper(upper),
+    alphaA(alphaA), alphaB(alphaB),
+    min_depth(min_depth), max_depth(max_depth), order1(n1), order2(n2), hp(hp), detect(detect), breakpoints(breakpoints),
+    summation(summation),
+    a_singular(a_singular), b_singular(b_singular),
+    legendre_n1(legendre_n1), legendre_n2(legendre_n2), laguerre_n1(laguerre_n1), laguerre_n2(laguerre_n2),
+    name(name), author(author), description(description), reference(reference), version(version),
+    results(std::move(combinations))
+{
+    build_combinations(update_log_message);
+}
 
-  
-    generate_combinations(keys, parameters, indices, results);
+AdaptiveGaussTreeBatch::AdaptiveGaussTreeBatch(
+    PointsIntegrand func,
+    double lower, double upper,
+    double tol, int min_depth, int max_depth, int n1, int n2,
+    double alphaA, double alphaB,
+    bool a_singular, bool b_singular,
+    WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+    std::vector<ParamMap> combinations,
+    std::string name, std::string author, std::string description,
+    std::string reference, std::string version, std::string update_log_message,
+    HpRefinement hp, SingularityDetection detect, BreakpointFunction breakpoints, Summation::Method summation
+) : func(single_point(func)),
+    tol(tol), lower(lower), upper(upper),
+    alphaA(alphaA), alphaB(alphaB),
+    min_depth(min_depth), max_depth(max_depth), order1(n1), order2(n2), hp(hp), detect(detect), breakpoints(breakpoints),
+    summation(summation),
+    a_singular(a_singular), b_singular(b_singular),
+    legendre_n1(legendre_n1), legendre_n2(legendre_n2), laguerre_n1(laguerre_n1), laguerre_n2(laguerre_n2),
+    name(name), author(author), description(description), reference(reference), version(version),
+    results(std::move(combinations)), points_func(func)
+{
+    build_combinations(update_log_message);
+}
 
+void AdaptiveGaussTreeBatch::build_combinations(const std::string& update_log_message) {
+    add_update_log(update_log_message);
+    std::set<std::string> key_set;
+    std::unordered_map<std::string, std::unordered_set<ParamType, ParamTypeHash>> seen;   // values kept in first-seen order
+    for (const auto& combo : results) {
+        for (const auto& [key, value] : combo) {
+            key_set.insert(key);
+            if (!seen[key].insert(value).second) continue;
+            std::visit([&](const auto& val) {
+                using T = std::decay_t<decltype(val)>;
+                auto entry = parameters.find(key);
+                if (entry == parameters.end()) entry = parameters.emplace(key, std::vector<T>{}).first;
+                auto* values = std::get_if<std::vector<T>>(&entry->second);
+                if (values == nullptr) {
+                    throw std::runtime_error("Parameter \"" + key + "\" has values of different types.");
+                }
+                values->push_back(val);
+            }, value);
+        }
+    }
+    keys.assign(key_set.begin(), key_set.end());
     sortResults();
+    build_trees(update_log_message);
+}
 
+void AdaptiveGaussTreeBatch::build_trees(const std::string& update_log_message, const BatchControl& control) {
+    Trace::Span span("batch/build_trees", "batch");
+    span.arg("trees", results.size());
+    BuildMonitor monitor(control, results.size());
+    std::function<void(const AdaptiveGaussTree&)> report;
+    if (monitor.reporting()) report = [&](const AdaptiveGaussTree& tree) { monitor.tree_running(tree); };
+    for (const auto& combo : tree_combinations()) {
+        auto tree = build_tree(combo, update_log_message, TreeCheckpoint{nullptr, report, monitor.interval(), monitor.stop()});
+        for (const ParamMap& key : store_tree(combo, std::move(tree))) {
+            monitor.tree_done(*quad_coll[key]);
+        }
+    }
+}
 
+std::vector<ParamMap> AdaptiveGaussTreeBatch::tree_combinations() const {
+    if (!vector_func) return results;
+    std::vector<ParamMap> combinations;
+    for (ParamMap combo : results) {
+        if (combo.at(component_key) != component_values.front()) continue;
+        combo.erase(component_key);
+        combinations.push_back(std::move(combo));
+    }
+    return combinations;
+}
 
+std::unique_ptr<AdaptiveGaussTree> AdaptiveGaussTreeBatch::build_tree(const ParamMap& combination, const std::string& update_log_message,
+                                                                      const TreeCheckpoint& checkpoint) const {
+    std::vector<Breakpoint> points = breakpoints ? breakpoints(combination) : std::vector<Breakpoint>{};
+    if (vector_func) {
+        return std::make_unique<AdaptiveGaussTree>(
+            vector_func, component_values.size(), lower, upper, tol, min_depth, max_depth, order1, order2,
+            alphaA, alphaB, a_singular, b_singular,
+            legendre_n1, legendre_n2, laguerre_n1, laguerre_n2,
+            combination, name, author, description,
+            reference, version, update_log_message, hp, detect, points, summation, checkpoint);
+    }
+    if (points_func) {
+        return std::make_unique<AdaptiveGaussTree>(
+            points_func, lower, upper, tol, min_depth, max_depth, order1, order2,
+            alphaA, alphaB, a_singular, b_singular,
+            legendre_n1, legendre_n2, laguerre_n1, laguerre_n2,
+            combination, name, author, description,
+            reference, version, update_log_message, hp, detect, points, summation, checkpoint);
+    }
+    return std::make_unique<AdaptiveGaussTree>(
+        func, lower, upper, tol, min_depth, max_depth, order1, order2,
+        alphaA, alphaB, a_singular, b_singular,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2,
+        combination, name, author, description,
+        reference, version, update_log_message, hp, detect, points, summation, checkpoint);
+}
 
-    // Reconstruct trees from stored JSON
-    for (const auto& param_map : results) {
- //       std::cout << "reconstructing tree" << std::endl;
-//        const json& tree_json = find_tree_json(data["parameters"], param_map);
-        json json_head;
-        json tree_json = find_tree_json(data["parameters"], param_map);
-//        std::cout << "tree dump" << std::endl;
-//        std::cout << tree_json.dump(4) << std::endl; 
-        // add tree fields to tree_json.  need these:
-/*
-        name = data["name"];
-        reference=data["reference"];
-        description=data["description"];
-        author=data["author"];
-        version=data["version"];       
-        tolerance = data["tolerance"];
-        min_depth = data["min_depth"];
-        max_depth = data["max_depth"];
-        order1 = data["n1"];
-        order2 = data["n2"];
-
-                            "a": 0.0,
-                            "b": 1.0,
-                            "depth": 0,
-                            "tol": 1e-12,
-                            "error": 5.773159728050814e-15,
-                            "integral": 1.0009945751278209,
-                            "method": "Gauss-Laguerre"        
-*/        
-        json_head["name"] = name;
-        json_head["reference"]= reference;
-        json_head["description"]= description;
-        json_head["author"]=author;
-        json_head["version"]=version;
-        json_head["tolerance"]= tol;
-        json_head["min_depth"]=min_depth;
-        json_head["max_depth"]=max_depth;
-        json_head["n1"]=order1;
-        json_head["n2"]=order2;
-        json_head["tree"] = tree_json;
-
-        std::unique_ptr<AdaptiveGaussTree> tree_ptr = std::make_unique<AdaptiveGaussTree>(
-            json_head, func, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2 , param_map
-        );
-        quad_coll[param_map] = std::move(tree_ptr);
+std::vector<ParamMap> AdaptiveGaussTreeBatch::tree_keys(const ParamMap& combination) const {
+    if (!vector_func) return {combination};
+    std::vector<ParamMap> keys;
+    for (const ParamType& value : component_values) {
+        keys.push_back(combination);
+        keys.back()[component_key] = value;
+    }
+    return keys;
+}
+
+std::vector<ParamMap> AdaptiveGaussTreeBatch::store_tree(const ParamMap& combination, std::unique_ptr<AdaptiveGaussTree> tree) {
+    std::vector<ParamMap> stored = tree_keys(combination);
+    if (!vector_func) {
+        quad_coll[combination] = std::move(tree);
+        return stored;
+    }
+    for (std::size_t k = 0; k < stored.size(); ++k) {
+        quad_coll[stored[k]] = tree->component_tree(k);
+    }
+    return stored;
+}
+
+AdaptiveGaussTreeBatch::AdaptiveGaussTreeBatch(
+    VectorIntegrand vector_func, std::string component_key, std::vector<ParamType> component_values,
+    double lower, double upper,
+    double tol, int min_depth, int max_depth, int n1, int n2,
+    double alphaA, double alphaB,
+    bool a_singular, bool b_singular,
+    WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+    ParamCollection parameters,
+    std::string name, std::string author, std::string description,
+    std::string reference, std::string version, std::string update_log_message,
+    BatchCheckpoint checkpoint, HpRefinement hp, SingularityDetection detect, BreakpointFunction breakpoints,
+    Summation::Method summation, BatchControl control
+) : tol(tol), lower(lower), upper(upper),
+    alphaA(alphaA), alphaB(alphaB),
+    min_depth(min_depth), max_depth(max_depth), order1(n1), order2(n2), hp(hp), detect(detect), breakpoints(breakpoints),
+    summation(summation),
+    a_singular(a_singular), b_singular(b_singular),
+    legendre_n1(legendre_n1), legendre_n2(legendre_n2), laguerre_n1(laguerre_n1), laguerre_n2(laguerre_n2),
+    parameters(parameters),
+    name(name), author(author), description(description), reference(reference), version(version),
+    vector_func(vector_func), component_key(component_key), component_values(component_values)
+{
+    if (component_values.empty()) {
+        throw std::runtime_error("A vector-valued integrand needs at least one component.");
+    }
+    if (parameters.count(component_key)) {
+        throw std::runtime_error("Component parameter \"" + component_key + "\" is also a grid parameter.");
+    }
+    // The component values become an ordinary parameter of the batch
+    std::visit([&](const auto& first) {
+        using T = std::decay_t<decltype(first)>;
+        std::vector<T> values;
+        for (const auto& value : component_values) {
+            const T* typed = std::get_if<T>(&value);
+            if (typed == nullptr) {
+                throw std::runtime_error("Component parameter \"" + component_key + "\" has values of different types.");
+            }
+            values.push_back(*typed);
+        }
+        this->parameters[component_key] = values;
+    }, component_values.front());
+
+    func = [vector_func, component_key, component_values](ParamMap p, double x) {
+        auto k = std::find(component_values.begin(), component_values.end(), p.at(component_key)) - component_values.begin();
+        if (static_cast<std::size_t>(k) == component_values.size()) {
+            throw std::runtime_error("No component for this value of \"" + component_key + "\".");
+        }
+        p.erase(component_key);
+        std::vector<double> values(component_values.size());
+        vector_func(p, x, values);
+        return values[k];
+    };
+
+    add_update_log(update_log_message);
+    for (const auto& pair : this->parameters) keys.push_back(pair.first);
+    {
+        Trace::Span span("batch/combinations", "batch");
+        std::vector<size_t> indices(keys.size(), 0);
+        generate_combinations(keys, this->parameters, indices, results);
+    }
+    sortResults();
+    if (checkpoint.filename.empty()) {
+        build_trees(update_log_message, control);
+    } else {
+        build_trees_checkpointed(checkpoint, update_log_message, control);   // resumes if the checkpoint exists
     }
 }
 
+std::vector<ParamMap> AdaptiveGaussTreeBatch::expand_grid(const ParamCollection& parameters) {
+    std::vector<std::string> keys;
+    for (const auto& pair : parameters) keys.push_back(pair.first);
+    std::vector<size_t> indices(keys.size(), 0);
+    std::vector<ParamMap> combinations;
+    generate_combinations(keys, parameters, indices, combinations);
+    return combinations;
+}
+
 void AdaptiveGaussTreeBatch::merge(const AdaptiveGaussTreeBatch& other) {
     // Merge quad_coll (deep copy of AdaptiveGaussTree)
     for (const auto& pair : other.quad_coll) {
@@ -141,11 +285,27 @@ void AdaptiveGaussTreeBatch::merge(const AdaptiveGaussTreeBatch& other) {
         }
         // Deep copy and insert new AdaptiveGaussTree
         quad_coll[param_key] = std::make_unique<AdaptiveGaussTree>(*pair.second);
+        results.push_back(param_key);
     }
+    merge_header(other);
+}
 
-    // Merge results
-    results.insert(results.end(), other.results.begin(), other.results.end());
+void AdaptiveGaussTreeBatch::merge(AdaptiveGaussTreeBatch&& other) {
+    // Same as merge(const&), but the trees are moved out of `other` instead of copied
+    for (auto& pair : other.quad_coll) {
+        auto [it, inserted] = quad_coll.try_emplace(pair.first, std::move(pair.second));
+        if (!inserted) {
+            std::cout << "Warning: Duplicate key found in merge(). Keeping existing tree for key: " << pair.first << std::endl;
+            continue;
+        }
+        results.push_back(it->first);
+    }
+    merge_header(other);
+    other.quad_coll.clear();
+    other.results.clear();
+}
 
+void AdaptiveGaussTreeBatch::merge_header(const AdaptiveGaussTreeBatch& other) {
     // Merge update log (keeping chronological order)
     update_log.insert(update_log.end(), other.update_log.begin(), other.update_log.end());
 
@@ -154,140 +314,77 @@ void AdaptiveGaussTreeBatch::merge(const AdaptiveGaussTreeBatch& other) {
     key_set.insert(other.keys.begin(), other.keys.end());
     keys.assign(key_set.begin(), key_set.end());
 
-    // Merge parameters (combine values for matching keys)
+    // Merge parameters (combine values for matching keys, hashed lookup of the existing values)
     for (const auto& [key, value] : other.parameters) {
-        if (parameters.find(key) != parameters.end()) {
-            // Append new values if they don't already exist
-            std::visit([&](auto& vec) {
-                using T = std::decay_t<decltype(vec)>;
-                auto& existing_vec = std::get<T>(parameters[key]);
-                for (const auto& val : vec) {
-                    if (std::find(existing_vec.begin(), existing_vec.end(), val) == existing_vec.end()) {
-                        existing_vec.push_back(val);
-                    }
-                }
-            }, value);
-        } else {
+        auto existing = parameters.find(key);
+        if (existing == parameters.end()) {
             parameters[key] = value; // Add new parameter entry
+            continue;
         }
+        std::visit([&](const auto& vec) {
+            using T = std::decay_t<decltype(vec)>;
+            auto* existing_vec = std::get_if<T>(&existing->second);
+            if (existing_vec == nullptr) {
+                throw std::runtime_error("merge(): parameter \"" + key + "\" has different types in the two batches.");
+            }
+            std::unordered_set<typename T::value_type> seen(existing_vec->begin(), existing_vec->end());
+            for (const auto& val : vec) {
+                if (seen.insert(val).second) existing_vec->push_back(val);
+            }
+        }, value);
     }
 
     // Log the merge operation
     add_update_log("Merged with another AdaptiveGaussTreeBatch instance.");
 }
 
-
-
-
-void AdaptiveGaussTreeBatch::extract_keys(const json& param_json, std::set<std::string>& key_set, int depth) {
-    for (auto it = param_json.begin(); it != param_json.end(); ++it) {
-        if (it.key() == "tree") continue;  // Ignore "tree"
-
-        // **Only store non-numeric keys at the first depth**
-        if (depth % 2 == 0 ) {
-            key_set.insert(it.key());
-        }
-
-        // Recursively process deeper levels
-        if (it->is_object()) {
-            extract_keys(*it, key_set, depth + 1);
-        }
+AdaptiveGaussTreeBatch AdaptiveGaussTreeBatch::merge_files(
+    std::function<double(ParamMap, double)> func, const std::vector<std::string>& filenames, unsigned int threads
+) {
+    if (filenames.empty()) {
+        throw std::runtime_error("merge_files(): no input files.");
     }
-}
-
-// using ParamCollection = std::map<std::string, std::variant<std::vector<int>, std::vector<double>, std::vector<std::string>>>
-
-void AdaptiveGaussTreeBatch::extract_parameters(
-    const json& param_json, 
-    ParamCollection& parameters, 
-    std::optional<std::string> current_key, 
-    bool expecting_value, 
-    std::map<std::string, std::set<int>> int_sets, 
-    std::map<std::string, std::set<double>> double_sets , 
-    std::map<std::string, std::set<std::string>> string_sets ) 
-{
-    for (auto it = param_json.begin(); it != param_json.end(); ++it) {
-        std::string key = it.key();
-
-        //  Skip "tree" since it contains no parameters
-        if (key == "tree") continue;
-
-        // If expecting a key (even depth), recurse deeper with key as parameter name
-        if (!expecting_value) {
-            extract_parameters(*it, parameters, key, true, int_sets, double_sets, string_sets);
-        }
-        else { // Expecting a VALUE
-            if (!current_key) continue;  // Skip if no parameter name is set
-
-            // Determine if the key is a number
-            bool is_number = key.find_first_not_of("0123456789.") == std::string::npos;
-            bool is_float = key.find('.') != std::string::npos;
-
-            // Ensure the key exists in the correct set for uniqueness tracking
-            if (is_number) {
-                if (is_float) {
-                    double_sets[*current_key].insert(std::stod(key));
-                } else {
-                    int_sets[*current_key].insert(std::stoi(key));
-                }
-            } else {
-                string_sets[*current_key].insert(key);
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned int>(threads, filenames.size());
+
+    // Load: each worker takes the next unread file
+    std::vector<std::unique_ptr<AdaptiveGaussTreeBatch>> batches(filenames.size());
+    std::vector<std::exception_ptr> errors(filenames.size());
+    std::atomic<size_t> next{0};
+    Trace::Span span("batch/merge_files", "batch");
+    span.arg("files", filenames.size());
+    auto worker = [&]() {
+        for (size_t i = next++; i < filenames.size(); i = next++) {
+            try {
+                batches[i] = std::make_unique<AdaptiveGaussTreeBatch>(func, filenames[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
             }
-
-
-            // Now switch to expecting a key on next recursion
-            extract_parameters(*it, parameters, current_key, false, int_sets, double_sets, string_sets);
         }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < threads; ++t) {
+        pool.emplace_back([&]() {
+            Trace::set_thread_name("merge_files worker");
+            worker();
+        });
     }
-
-    // Convert sets to vectors and store in `parameters`
-    for (const auto& [key, values] : int_sets) {
-        parameters[key] = std::vector<int>(values.begin(), values.end());
-    }
-    for (const auto& [key, values] : double_sets) {
-        parameters[key] = std::vector<double>(values.begin(), values.end());
-    }
-    for (const auto& [key, values] : string_sets) {
-        parameters[key] = std::vector<std::string>(values.begin(), values.end());
+    worker();
+    for (auto& thread : pool) thread.join();
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
     }
-}
-
 
-
-const json& AdaptiveGaussTreeBatch::find_tree_json(const json& param_json, const ParamMap& param_map) {
-    const json* current = &param_json;
-    for (const auto& key : keys) {
-        auto it = param_map.find(key);
-        if (it == param_map.end()) continue; // Key not found in param_map, move on
-
-        std::string key_value;
-        if (std::holds_alternative<int>(it->second)) {
-            key_value = std::to_string(std::get<int>(it->second));
-        } else if (std::holds_alternative<double>(it->second)) {
-            key_value = std::to_string(std::get<double>(it->second));
-        } else if (std::holds_alternative<std::string>(it->second)) {
-            key_value = std::get<std::string>(it->second);
-        }
-
-        if (!current->contains(key)) {
-            throw std::runtime_error("Key missing in JSON: " + key);
-        }
-        if (!(*current)[key].contains(key_value)) {
-            throw std::runtime_error("Key value missing in JSON: " + key_value);
-        }
-
-        current = &((*current)[key][key_value]);
-    }
-
-    //  Check if "tree" exists and is valid
-    if (!current->contains("tree")) {
-        throw std::runtime_error("'tree' key missing in JSON");
-    }
-    if ((*current)["tree"].is_null()) {
-        throw std::runtime_error("'tree' key is null in JSON");
+    // Fold in file order (the first file holding a parameter set wins); trees are moved, never copied
+    Trace::Span fold_span("batch/fold", "batch");
+    AdaptiveGaussTreeBatch merged(std::move(*batches[0]));
+    for (size_t i = 1; i < batches.size(); ++i) {
+        merged.merge(std::move(*batches[i]));
+        batches[i].reset();
     }
-
-    return (*current)["tree"];
+    merged.sortResults();
+    merged.add_update_log("Merged " + std::to_string(filenames.size()) + " batch files.");
+    return merged;
 }
 
 
@@ -344,6 +441,7 @@ bool AdaptiveGaussTreeBatch::compareParamMaps(const ParamMap& a, const ParamMap&
 }
 
 void AdaptiveGaussTreeBatch::sortResults() {
+    Trace::Span span("batch/sort", "batch");
     std::sort(results.begin(), results.end(), 
         [this](const ParamMap& a, const ParamMap& b) {
             return compareParamMaps(a, b);
@@ -373,13 +471,32 @@ int AdaptiveGaussTreeBatch::getTypeRank() {
     return 4; // Default case
 }
 
-void AdaptiveGaussTreeBatch::save_to_json(const std::string & filename, bool overwrite, bool write_roots, bool write_trees ) {
+void AdaptiveGaussTreeBatch::save_to_json(const std::string & filename, bool overwrite, bool write_roots, bool write_trees, bool compact,
+                                          bool write_stats) {
     // Check if the file exists
     if (std::filesystem::exists(filename) && !overwrite) {
         std::cerr << "File \"" << filename << "\" exists. Set overwrite = true to overwrite." << std::endl;
         return;
     }
+    Trace::Span span("batch/save", "io");
+    span.arg("file", filename);
+    json data;
+    {
+        Trace::Span serialize_span("batch/serialize", "batch");
+        data = serialize(write_roots, write_trees, compact, write_stats);
+    }
+    Trace::Span write_span("batch/write", "io");
+    std::ofstream file(filename);
+    file << (compact ? data.dump() : data.dump(4));        
+} 
+
+json AdaptiveGaussTreeBatch::serialize(bool write_roots, bool write_trees, bool compact, bool write_stats) {
+    json data = serialize_header(write_roots, write_trees);
+    data["parameters"] = parameter_serializer(write_trees, compact, write_stats);
+    return data;
+}
 
+json AdaptiveGaussTreeBatch::serialize_header(bool write_roots, bool write_trees) {
     json data;
 
     data["name"] = name;
@@ -392,15 +509,26 @@ void AdaptiveGaussTreeBatch::save_to_json(const std::string & filename, bool ove
     data["max_depth"] = max_depth;
     data["n1"] = order1;
     data["n2"] = order2;
+    IntervalMap map(lower, upper);
+    if (!map.finite()) {
+        data["lower"] = IntervalMap::bound_to_json(lower);
+        data["upper"] = IntervalMap::bound_to_json(upper);
+    }
+    if (hp.max_order > 0) {
+        data["hp_max_order"] = hp.max_order;
+        data["hp_smoothness"] = hp.smoothness;
+    }
+    if (detect.enabled) {
+        data["detect_levels"] = detect.levels;
+        data["detect_max_spread"] = detect.max_spread;
+        data["detect_min_alpha"] = detect.min_alpha;
+    }
+    if (detect.extrapolate) data["extrapolate"] = true;
+    if (summation != Summation::Method::Naive) data["summation"] = Summation::to_string(summation);
     data["a_singular"] = a_singular ;
     data["b_singular"] = b_singular;
     data["write_trees"] = write_trees;
-    // Serialize update log
-    json log_json = json::array();
-    for (const auto& entry : update_log) {
-        log_json.push_back({{"timestamp", entry.first}, {"message", entry.second}});
-    }
-    data["update_log"] = log_json;
+    data["update_log"] = update_log_to_json();
     // Serialize weights if requested.
     if (write_roots) {
         data["legendre_roots_n1"] = {legendre_n1.getNodes(order1), legendre_n1.getWeights(order1)};
@@ -408,51 +536,390 @@ void AdaptiveGaussTreeBatch::save_to_json(const std::string & filename, bool ove
         data["legendre_roots_n2"] = {legendre_n2.getNodes(order2), legendre_n2.getWeights(order2)};
         data["laguerre_roots_n2"] = {laguerre_n2.getNodes(order2), laguerre_n2.getWeights(order2)};
     }         
-    data["parameters"] = parameter_serializer(write_trees);
-    std::ofstream file(filename);
-    file << data.dump(4);        
-} 
+    return data;
+}
 
-json AdaptiveGaussTreeBatch::parameter_serializer(bool dump_nodes) {
-    json result;
+json AdaptiveGaussTreeBatch::update_log_to_json(std::size_t first) const {
+    json log_json = json::array();
+    for (std::size_t i = first; i < update_log.size(); ++i) {
+        log_json.push_back({{"timestamp", update_log[i].first}, {"message", update_log[i].second}});
+    }
+    return log_json;
+}
 
-    for (const auto& [param_map, tree_ptr] : quad_coll) {
-        json* current = &result;  // Pointer to navigate the JSON structure
-
-        for (const auto& key : keys) {
-            auto it = param_map.find(key);
-            if (it == param_map.end()) continue; // Skip if key not found
-
-            // Convert variant value to a string key (for hierarchy)
-            std::string key_value;
-            if (std::holds_alternative<int>(it->second)) {
-                key_value = std::to_string(std::get<int>(it->second));
-            } else if (std::holds_alternative<double>(it->second)) {
-                key_value = std::to_string(std::get<double>(it->second));
-            } else if (std::holds_alternative<std::string>(it->second)) {
-                key_value = std::get<std::string>(it->second);
-            }
+void AdaptiveGaussTreeBatch::append_to_log(const std::string& filename, const std::string& update_log_message, bool write_roots) {
+    add_update_log(update_log_message);
+    json segment;
+    segment["aq_batch_segment"] = 1;   // format marker, must stay the first key (see JsonSaxLoader::is_segment_log)
+    segment.update(serialize(write_roots, false, true));
+    segment["update_log"] = update_log_to_json(logged[filename]);   // replay appends the entries of every segment
+    std::ofstream file(filename, std::ios::app | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Error opening file: " + filename);
+    }
+    file << segment.dump() << '\n';
+    logged[filename] = update_log.size();
+}
 
-            // Ensure parameter label exists in JSON
-            current = &((*current)[key]);  // Create or navigate label (e.g., "s", "z")
-            current = &((*current)[key_value]);  // Create/navigate value under label
-        }
+void AdaptiveGaussTreeBatch::compact_log(const std::string& filename, const std::string& output_filename) {
+    AdaptiveGaussTreeBatch combined({}, filename);
+    const std::string target = output_filename.empty() ? filename : output_filename;
+    const std::string scratch = target + ".compacting";
+    std::filesystem::remove(scratch);
+    // the root tables of the first segment are kept if it had them (they are all written, or none)
+    bool roots = combined.legendre_n1.hasOrder(combined.order1) && combined.legendre_n2.hasOrder(combined.order2)
+              && combined.laguerre_n1.hasOrder(combined.order1) && combined.laguerre_n2.hasOrder(combined.order2);
+    combined.append_to_log(scratch, "Compacted log segments", roots);
+    std::filesystem::rename(scratch, target);   // readers see either the old log or the new one
+}
+
+json AdaptiveGaussTreeBatch::parameter_serializer(bool dump_nodes, bool compact, bool write_stats) {
+    json result;
 
+    for (const auto& [param_map, tree_ptr] : quad_coll) {
         // Assign the serialized tree to the final position
-        (*current)["tree"] = tree_ptr->get_tree_serialized(dump_nodes);
+        json* location = tree_location(result, param_map);
+        (*location)["tree"] = tree_ptr->get_tree_serialized(dump_nodes, compact);
+        if (write_stats) (*location)["stats"] = tree_ptr->get_stats().to_json();
+        if (tree_ptr->is_best_effort()) (*location)["best_effort"] = true;
     }
 
     return result;
 }
 
-AdaptiveGaussTreeBatch AdaptiveGaussTreeBatch::operator+(const AdaptiveGaussTreeBatch& other) const {
+std::vector<std::pair<ParamMap, TreeStats>> AdaptiveGaussTreeBatch::get_stats() const {
+    std::vector<std::pair<ParamMap, TreeStats>> stats;
+    for (const auto& param_map : results) {
+        auto it = quad_coll.find(param_map);
+        if (it != quad_coll.end()) stats.emplace_back(param_map, it->second->get_stats());
+    }
+    return stats;
+}
+
+TreeStats AdaptiveGaussTreeBatch::total_stats() const {
+    TreeStats total;
+    for (const auto& [param_map, tree_ptr] : quad_coll) total += tree_ptr->get_stats();
+    return total;
+}
+
+std::vector<ParamMap> AdaptiveGaussTreeBatch::best_effort_trees() const {
+    std::vector<ParamMap> cut;
+    for (const auto& param_map : results) {
+        auto it = quad_coll.find(param_map);
+        if (it != quad_coll.end() && it->second->is_best_effort()) cut.push_back(param_map);
+    }
+    return cut;
+}
+
+std::vector<ParamMap> AdaptiveGaussTreeBatch::roundoff_limited_trees() const {
+    std::vector<ParamMap> limited;
+    for (const auto& param_map : results) {
+        auto it = quad_coll.find(param_map);
+        if (it != quad_coll.end() && it->second->roundoff_limited_leaves() > 0) limited.push_back(param_map);
+    }
+    return limited;
+}
+
+json* AdaptiveGaussTreeBatch::tree_location(json& result, const ParamMap& param_map) const {
+    json* current = &result;  // Pointer to navigate the JSON structure
+
+    for (const auto& key : keys) {
+        auto it = param_map.find(key);
+        if (it == param_map.end()) continue; // Skip if key not found
+
+        // Convert variant value to a string key (for hierarchy); doubles at full precision, so distinct values stay distinct
+        std::string key_value = JsonSaxLoader::format_param_value(it->second);
+
+        // Ensure parameter label exists in JSON
+        current = &((*current)[key]);  // Create or navigate label (e.g., "s", "z")
+        current = &((*current)[key_value]);  // Create/navigate value under label
+    }
+    return current;
+}
+
+AdaptiveGaussTreeBatch AdaptiveGaussTreeBatch::operator+(const AdaptiveGaussTreeBatch& other) const & {
     AdaptiveGaussTreeBatch result(*this);  // Step 1: Deep copy lhs (`this`)
     result.merge(other);                   // Step 2: Merge rhs (`other`)
     return result;                          // Step 3: Return new merged batch
 }
 
+AdaptiveGaussTreeBatch AdaptiveGaussTreeBatch::operator+(AdaptiveGaussTreeBatch&& other) const & {
+    AdaptiveGaussTreeBatch result(*this);
+    result.merge(std::move(other));
+    return result;
+}
+
+AdaptiveGaussTreeBatch AdaptiveGaussTreeBatch::operator+(const AdaptiveGaussTreeBatch& other) && {
+    AdaptiveGaussTreeBatch result(std::move(*this));   // lhs is a temporary: take its trees
+    result.merge(other);
+    return result;
+}
+
+AdaptiveGaussTreeBatch AdaptiveGaussTreeBatch::operator+(AdaptiveGaussTreeBatch&& other) && {
+    AdaptiveGaussTreeBatch result(std::move(*this));
+    result.merge(std::move(other));
+    return result;
+}
+
 AdaptiveGaussTreeBatch& AdaptiveGaussTreeBatch::operator+=(const AdaptiveGaussTreeBatch& other) {
     this->merge(other);  // Merge `other` into `this`
     return *this;        // Return the updated lhs (`this`)
 }
 
+AdaptiveGaussTreeBatch& AdaptiveGaussTreeBatch::operator+=(AdaptiveGaussTreeBatch&& other) {
+    this->merge(std::move(other));
+    return *this;
+}
+
+
+// --- JSON form of parameters -------------------------------------------------------------------------------
+
+json AdaptiveGaussTreeBatch::combination_to_json(const ParamMap& combination) {
+    json entry = json::object();
+    for (const auto& [key, value] : combination) {
+        std::visit([&](const auto& val) { entry[key] = val; }, value);
+    }
+    return entry;
+}
+
+ParamMap AdaptiveGaussTreeBatch::combination_from_json(const json& entry) {
+    ParamMap combination;
+    for (const auto& [key, value] : entry.items()) {
+        if (value.is_number_integer()) combination[key] = value.get<int>();
+        else if (value.is_number()) combination[key] = value.get<double>();
+        else combination[key] = value.get<std::string>();
+    }
+    return combination;
+}
+
+json AdaptiveGaussTreeBatch::parameters_to_json(const ParamCollection& parameters) {
+    json result = json::object();
+    for (const auto& [key, values] : parameters) {
+        std::visit([&](const auto& vec) { result[key] = vec; }, values);
+    }
+    return result;
+}
+
+ParamCollection AdaptiveGaussTreeBatch::parameters_from_json(const json& data) {
+    ParamCollection parameters;
+    for (const auto& [key, values] : data.items()) {
+        if (!values.is_array() || values.empty()) {
+            throw std::runtime_error("Parameter \"" + key + "\" must be a non-empty array.");
+        }
+        if (values[0].is_string()) {
+            parameters[key] = values.get<std::vector<std::string>>();
+        } else if (std::all_of(values.begin(), values.end(), [](const json& v) { return v.is_number_integer(); })) {
+            parameters[key] = values.get<std::vector<int>>();
+        } else {
+            parameters[key] = values.get<std::vector<double>>();
+        }
+    }
+    return parameters;
+}
+
+// --- Checkpoint and resume ---------------------------------------------------------------------------------
+
+AdaptiveGaussTreeBatch::AdaptiveGaussTreeBatch(
+    std::function<double(ParamMap, double)> func,
+    WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+    const BatchCheckpoint& checkpoint, BreakpointFunction breakpoints
+) : func(func), breakpoints(breakpoints),
+    legendre_n1(legendre_n1), legendre_n2(legendre_n2), laguerre_n1(laguerre_n1), laguerre_n2(laguerre_n2)
+{
+    std::ifstream file(checkpoint.filename);
+    if (!file) {
+        throw std::runtime_error("Error opening checkpoint file: " + checkpoint.filename);
+    }
+    json state = json::parse(file);
+    if (!state.contains("aq_checkpoint")) {
+        throw std::runtime_error("Not a batch checkpoint file: " + checkpoint.filename);
+    }
+    if (state.contains("component_key")) {
+        throw std::runtime_error("Checkpoint " + checkpoint.filename + " is of a vector-valued build; resume it with the "
+                                 "vector-valued constructor and the same arguments.");
+    }
+    name = state["name"];
+    author = state["author"];
+    description = state["description"];
+    reference = state["reference"];
+    version = state["version"];
+    lower = IntervalMap::bound_from_json(state["lower"]);
+    upper = IntervalMap::bound_from_json(state["upper"]);
+    tol = state["tol"];
+    min_depth = state["min_depth"];
+    max_depth = state["max_depth"];
+    order1 = state["n1"];
+    order2 = state["n2"];
+    hp.max_order = state.value("hp_max_order", 0);
+    hp.smoothness = state.value("hp_smoothness", HpRefinement().smoothness);
+    detect.enabled = state.contains("detect_levels");
+    detect.levels = state.value("detect_levels", SingularityDetection().levels);
+    detect.max_spread = state.value("detect_max_spread", SingularityDetection().max_spread);
+    detect.min_alpha = state.value("detect_min_alpha", SingularityDetection().min_alpha);
+    detect.extrapolate = state.value("extrapolate", false);
+    summation = Summation::from_string(state.value("summation", "naive"));
+    alphaA = state["alphaA"];
+    alphaB = state["alphaB"];
+    a_singular = state["a_singular"];
+    b_singular = state["b_singular"];
+    parameters = parameters_from_json(state["parameters"]);
+
+    std::string update_log_message = state["update_log_message"];
+    add_update_log(update_log_message);
+    add_update_log("Resumed from checkpoint " + checkpoint.filename);
+    for (const auto& pair : parameters) {
+        keys.push_back(pair.first);
+    }
+    std::vector<size_t> indices(keys.size(), 0);
+    {
+        Trace::Span span("batch/combinations", "batch");
+        generate_combinations(keys, parameters, indices, results);
+    }
+    sortResults();
+    build_trees_checkpointed(checkpoint, update_log_message);
+}
+
+json AdaptiveGaussTreeBatch::checkpoint_state(const std::string& update_log_message) const {
+    json state;
+    state["aq_checkpoint"] = 1;
+    state["name"] = name;
+    state["author"] = author;
+    state["description"] = description;
+    state["reference"] = reference;
+    state["version"] = version;
+    state["lower"] = IntervalMap::bound_to_json(lower);
+    state["upper"] = IntervalMap::bound_to_json(upper);
+    state["tol"] = tol;
+    state["min_depth"] = min_depth;
+    state["max_depth"] = max_depth;
+    state["n1"] = order1;
+    state["n2"] = order2;
+    if (hp.max_order > 0) {
+        state["hp_max_order"] = hp.max_order;
+        state["hp_smoothness"] = hp.smoothness;
+    }
+    if (detect.enabled) {
+        state["detect_levels"] = detect.levels;
+        state["detect_max_spread"] = detect.max_spread;
+        state["detect_min_alpha"] = detect.min_alpha;
+    }
+    if (detect.extrapolate) state["extrapolate"] = true;
+    if (summation != Summation::Method::Naive) state["summation"] = Summation::to_string(summation);
+    state["alphaA"] = alphaA;
+    state["alphaB"] = alphaB;
+    state["a_singular"] = a_singular;
+    state["b_singular"] = b_singular;
+    state["parameters"] = parameters_to_json(parameters);
+    if (vector_func) state["component_key"] = component_key;   // its values are in "parameters"
+    state["update_log_message"] = update_log_message;
+    state["frontier"] = nullptr;
+    return state;
+}
+
+void AdaptiveGaussTreeBatch::write_checkpoint_state(const std::string& filename, const json& state) {
+    const std::string scratch = filename + ".tmp";
+    {
+        std::ofstream file(scratch, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Error opening file: " + scratch);
+        }
+        file << state.dump();
+    }
+    std::filesystem::rename(scratch, filename);   // a crash leaves either the old or the new state
+}
+
+void AdaptiveGaussTreeBatch::append_tree_segment(const std::string& filename, const std::vector<ParamMap>& param_maps) {
+    json segment;
+    segment["aq_batch_segment"] = 1;
+    segment.update(serialize_header(false, false));
+    segment["update_log"] = update_log_to_json(logged[filename]);   // the whole log with the first tree only
+    json params;
+    for (const ParamMap& param_map : param_maps) {
+        (*tree_location(params, param_map))["tree"] = quad_coll.at(param_map)->get_tree_serialized(false, true);
+    }
+    segment["parameters"] = params;
+    std::ofstream file(filename, std::ios::app | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Error opening file: " + filename);
+    }
+    file << segment.dump() << '\n' << std::flush;
+    logged[filename] = update_log.size();
+}
+
+void AdaptiveGaussTreeBatch::build_trees_checkpointed(const BatchCheckpoint& checkpoint, const std::string& update_log_message,
+                                                      const BatchControl& control) {
+    Trace::Span span("batch/build_trees", "batch");
+    span.arg("trees", results.size());
+    span.arg("checkpoint", checkpoint.filename);
+    const std::string log_file = checkpoint.filename + ".log";
+    json state = checkpoint_state(update_log_message);
+    json frontier = nullptr;
+
+    if (std::filesystem::exists(checkpoint.filename)) {
+        std::ifstream file(checkpoint.filename);
+        json saved = json::parse(file);
+        for (const char* key : {"lower", "upper", "tol", "min_depth", "max_depth", "n1", "n2", "hp_max_order", "hp_smoothness",
+                                "detect_levels", "detect_max_spread", "detect_min_alpha", "extrapolate", "summation", "alphaA", "alphaB", "a_singular", "b_singular", "parameters",
+                                "component_key"}) {
+            if (saved.value(key, json()) != state.value(key, json())) {
+                throw std::runtime_error("Checkpoint " + checkpoint.filename + " was written for a different build (\"" + key + "\" differs).");
+            }
+        }
+        frontier = saved["frontier"];
+    }
+
+    // Trees finished before the interruption
+    if (std::filesystem::exists(log_file)) {
+        AdaptiveGaussTreeBatch done(func, log_file);
+        std::unordered_set<ParamMap, ParamMapHash, ParamMapEqual> wanted(results.begin(), results.end());
+        for (auto& [param_map, tree] : done.quad_coll) {
+            if (wanted.count(param_map)) {
+                quad_coll[param_map] = std::move(tree);
+            }
+        }
+    }
+
+    BuildMonitor monitor(control, results.size());
+    for (const auto& combo : tree_combinations()) {
+        std::vector<ParamMap> stored = tree_keys(combo);
+        if (std::all_of(stored.begin(), stored.end(), [&](const ParamMap& key) { return quad_coll.count(key) != 0; })) {
+            for (const ParamMap& key : stored) monitor.tree_done(*quad_coll[key]);
+            continue;
+        }
+
+        // The tree that was being built when the checkpoint was written continues from its frontier
+        json partial = nullptr;
+        if (!frontier.is_null() && ParamMapEqual()(combination_from_json(frontier["parameters"]), combo)) {
+            partial = frontier["tree"];
+        }
+        std::function<void(const AdaptiveGaussTree&)> save_frontier = [&](const AdaptiveGaussTree& tree) {
+            state["frontier"] = {{"parameters", combination_to_json(combo)}, {"tree", tree.get_tree_serialized()}};
+            write_checkpoint_state(checkpoint.filename, state);
+        };
+        double hook_interval = checkpoint.interval;
+        if (monitor.reporting()) {
+            // one hook for both: called at the shorter interval, the frontier is still written at its own
+            auto last_save = std::chrono::steady_clock::now();
+            save_frontier = [&, write = save_frontier, last_save](const AdaptiveGaussTree& tree) mutable {
+                auto now = std::chrono::steady_clock::now();
+                if (std::chrono::duration<double>(now - last_save).count() >= checkpoint.interval) {
+                    write(tree);
+                    last_save = now;
+                }
+                monitor.tree_running(tree);
+            };
+            hook_interval = std::min(hook_interval, monitor.interval());
+        }
+        auto tree = build_tree(combo, update_log_message, TreeCheckpoint{partial, save_frontier, hook_interval, monitor.stop()});
+        bool best_effort = tree->is_best_effort();
+        store_tree(combo, std::move(tree));
+        for (const ParamMap& key : stored) monitor.tree_done(*quad_coll[key]);
+        if (best_effort) {
+            write_checkpoint_state(checkpoint.filename, state);   // with the last frontier: a resume finishes the tree
+            continue;
+        }
+        append_tree_segment(log_file, stored);
+        state["frontier"] = nullptr;
+        write_checkpoint_state(checkpoint.filename, state);
+    }
+}
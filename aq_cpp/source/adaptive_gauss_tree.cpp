@@ -1,4 +1,592 @@
 #include <adaptive_gauss_tree.hpp>
+#include <json_sax_loader.hpp>
+#include <algorithm>
+#include <functional>
+
+AdaptiveGaussTree::AdaptiveGaussTree(
+    std::function<double(ParamMap, double)> f, VectorIntegrand vector_f, std::size_t components, PointsIntegrand points_f,
+    double lower, double upper, double tol, int minD, int maxD, int n1, int n2,
+    double alphaA, double alphaB, bool singularA, bool singularB,
+    WeightsLoader rl1, WeightsLoader rl2, WeightsLoader ll1, WeightsLoader ll2, ParamMap args,
+    std::string name, std::string author, std::string description, std::string reference, std::string version,
+    const std::string& update_log_message, HpRefinement hp, SingularityDetection detect, std::vector<Breakpoint> breakpoints,
+    Summation::Method summation, const TreeCheckpoint& checkpoint)
+    : func(std::move(f)), tolerance(tol), min_depth(minD), max_depth(maxD),
+      order1(n1), order2(n2),
+      alpha_a(alphaA), alpha_b(alphaB), a_singular(singularA), b_singular(singularB),
+      roots_legendre_n1(rl1), roots_legendre_n2(rl2),
+      roots_laguerre_n1(ll1), roots_laguerre_n2(ll2),
+      args(std::move(args)),
+      name(std::move(name)), reference(std::move(reference)), description(std::move(description)), author(std::move(author)),
+      version(std::move(version)), hp(hp), detect(detect),
+      map(lower, upper), breakpoints(interior_breakpoints(std::move(breakpoints), map)),
+      vector_func(std::move(vector_f)), width(components), points_func(std::move(points_f)), summation(summation) {
+
+    if (vector_func && width == 0) {
+        throw std::runtime_error("A vector-valued integrand needs at least one component.");
+    }
+    check_endpoints();
+    if (checkpoint.partial_tree.is_null()) {
+        root = std::make_unique<Node>(map.u_lower(), map.u_upper(), 0, tol, order1, order2, false);
+        root->pending = true;
+        seed_breakpoints(root.get());
+    } else {
+        root = deserialize_tree(checkpoint.partial_tree);
+        if (root->lower != map.u_lower() || root->upper != map.u_upper() || root->tolerance != tol) {
+            throw std::runtime_error("Partial tree does not match the interval and tolerance of the build.");
+        }
+        if (detect.enabled) recover_detected_endpoints();
+    }
+    grow(checkpoint);
+    add_update_log(update_log_message);
+}
+
+void AdaptiveGaussTree::load_from_json(const std::string& filename) {
+    JsonSaxLoader::load_tree(filename, *this);
+}
+
+json AdaptiveGaussTree::serialize_tree_compact(const Node* node) const {
+    if (!node) return nullptr;
+    std::vector<int> leaf_depths, method_index, leaf_n1, leaf_n2, leaf_seeds, leaf_pending, leaf_roundoff;
+    std::vector<double> integrals, errors, leaf_a, leaf_alpha;
+    bool own_orders = false, split_off_middle = false, singular_alpha = false, seeds = false;
+    std::vector<std::string> methods;
+
+    // in-order walk: left subtree before right, so the depths can be replayed as bisections.  Each node is paired with
+    // the number of seed nodes above it (seeds form the top of the tree, see seed_breakpoints)
+    std::vector<std::pair<const Node*, int>> pending{{node, 0}};
+    while (!pending.empty()) {
+        auto [current, seeds_above] = pending.back();
+        pending.pop_back();
+        if (current->left || current->right) {
+            // split elsewhere than in the middle (at a breakpoint): the bounds have to be stored
+            if (current->left && current->left->upper != (current->lower + current->upper) / 2) split_off_middle = true;
+            seeds = seeds || current->seed;
+            int seeds_below = seeds_above + (current->seed ? 1 : 0);
+            if (current->right) pending.emplace_back(current->right.get(), seeds_below);
+            if (current->left) pending.emplace_back(current->left.get(), seeds_below);
+            continue;
+        }
+        if (current->pending) leaf_pending.push_back(static_cast<int>(leaf_depths.size()));
+        if (is_roundoff_leaf(current)) leaf_roundoff.push_back(static_cast<int>(leaf_depths.size()));
+        leaf_seeds.push_back(seeds_above);
+        leaf_alpha.push_back(current->alpha);
+        singular_alpha = singular_alpha || current->alpha != 0.0;
+        std::string method = current->extrapolated ? "Wynn-epsilon" : current->is_singular ? "Gauss-Laguerre" : regular_method();
+        auto it = std::find(methods.begin(), methods.end(), method);
+        if (it == methods.end()) it = methods.insert(methods.end(), method);
+        leaf_depths.push_back(current->depth);
+        integrals.push_back(current->result);
+        errors.push_back(current->pending ? current->previous_error : current->error);
+        method_index.push_back(static_cast<int>(it - methods.begin()));
+        leaf_n1.push_back(current->order1);
+        leaf_n2.push_back(current->order2);
+        leaf_a.push_back(current->lower);
+        own_orders = own_orders || current->order1 != order1 || current->order2 != order2;
+    }
+    json data = {
+        {"format", "leaf-compact"},
+        {"a", node->lower},
+        {"b", node->upper},
+        {"tol", node->tolerance},
+        {"leaf_depths", leaf_depths},
+        {"integral", integrals},
+        {"error", errors},
+        {"methods", methods},
+        {"method", method_index}
+    };
+    if (own_orders) {
+        data["leaf_n1"] = leaf_n1;
+        data["leaf_n2"] = leaf_n2;
+    }
+    if (split_off_middle) data["leaf_a"] = leaf_a;
+    if (singular_alpha) data["leaf_alpha"] = leaf_alpha;
+    if (seeds) data["leaf_seeds"] = leaf_seeds;
+    if (!leaf_pending.empty()) data["leaf_pending"] = leaf_pending;
+    if (!leaf_roundoff.empty()) data["leaf_roundoff"] = leaf_roundoff;
+    return data;
+}
+
+std::unique_ptr<AdaptiveGaussTree::Node> AdaptiveGaussTree::deserialize_tree_compact(const json& data) const {
+    return expand_compact_tree(data["a"], data["b"], data["tol"],
+        data["leaf_depths"].get<std::vector<int>>(), data["integral"].get<std::vector<double>>(),
+        data["error"].get<std::vector<double>>(), data["methods"].get<std::vector<std::string>>(),
+        data["method"].get<std::vector<int>>(), order1, order2,
+        data.value("leaf_n1", std::vector<int>{}), data.value("leaf_n2", std::vector<int>{}),
+        data.value("leaf_a", std::vector<double>{}), data.value("leaf_alpha", std::vector<double>{}),
+        data.value("leaf_seeds", std::vector<int>{}), data.value("leaf_pending", std::vector<int>{}),
+        data.value("leaf_roundoff", std::vector<int>{}));
+}
+
+std::unique_ptr<AdaptiveGaussTree::Node> AdaptiveGaussTree::expand_compact_tree(double lower, double upper, double tol,
+    const std::vector<int>& leaf_depths, const std::vector<double>& integrals, const std::vector<double>& errors,
+    const std::vector<std::string>& methods, const std::vector<int>& method_index, int o1, int o2,
+    const std::vector<int>& leaf_n1, const std::vector<int>& leaf_n2, const std::vector<double>& leaf_a,
+    const std::vector<double>& leaf_alpha, const std::vector<int>& leaf_seeds, const std::vector<int>& leaf_pending,
+    const std::vector<int>& leaf_roundoff) {
+
+    const std::size_t n = leaf_depths.size();
+    if (n == 0 || integrals.size() != n || errors.size() != n || method_index.size() != n
+        || (!leaf_n1.empty() && leaf_n1.size() != n) || (!leaf_n2.empty() && leaf_n2.size() != n)
+        || (!leaf_a.empty() && leaf_a.size() != n) || (!leaf_alpha.empty() && leaf_alpha.size() != n)
+        || (!leaf_seeds.empty() && leaf_seeds.size() != n)) {
+        throw std::runtime_error("Invalid leaf-compact tree: leaf arrays are empty or of different lengths");
+    }
+    std::size_t next = 0;
+    auto next_pending = leaf_pending.begin();   // ascending leaf indices
+    auto next_roundoff = leaf_roundoff.begin();
+    std::function<std::unique_ptr<Node>(int, double, double, double)> expand =
+        [&](int depth, double a, double b, double node_tol) -> std::unique_ptr<Node> {
+        if (next >= n || leaf_depths[next] < depth) {
+            throw std::runtime_error("Invalid leaf-compact tree: leaf_depths is not a bisection sequence");
+        }
+        auto node = std::make_unique<Node>(a, b, depth, node_tol, o1, o2, false);
+        if (leaf_depths[next] == depth) {
+            if (!leaf_a.empty()) {   // bounds of the leaf itself, interior bounds follow from the children
+                node->lower = leaf_a[next];
+                node->upper = next + 1 < n ? leaf_a[next + 1] : upper;
+            }
+            if (next_pending != leaf_pending.end() && *next_pending == static_cast<int>(next)) {
+                node->pending = true;                  // not evaluated yet: "error" holds its previous_error
+                node->previous_error = errors[next];
+                ++next_pending;
+                ++next;
+                return node;
+            }
+            node->result = integrals[next];
+            node->error = errors[next];
+            node->is_singular = methods.at(method_index[next]) == "Gauss-Laguerre";
+            node->extrapolated = methods.at(method_index[next]) == "Wynn-epsilon";
+            if (!leaf_n1.empty()) node->order1 = leaf_n1[next];
+            if (!leaf_n2.empty()) node->order2 = leaf_n2[next];
+            if (!leaf_alpha.empty()) node->alpha = leaf_alpha[next];
+            if (next_roundoff != leaf_roundoff.end() && *next_roundoff == static_cast<int>(next)) {
+                node->roundoff_limited = true;
+                ++next_roundoff;
+            }
+            ++next;
+            return node;
+        }
+        node->seed = !leaf_seeds.empty() && leaf_seeds[next] > depth;   // `next` is the first leaf below this node
+        double mid = (a + b) / 2;
+        node->left = expand(depth + 1, a, mid, node_tol / 2);
+        node->right = expand(depth + 1, mid, b, node_tol / 2);
+        node->lower = node->left->lower;
+        node->upper = node->right->upper;
+        node->result = node->left->result + node->right->result;
+        node->error = node->left->error + node->right->error;
+        node->is_singular = node->left->is_singular || node->right->is_singular;
+        return node;
+    };
+    auto root = expand(0, lower, upper, tol);
+    if (next != n || next_pending != leaf_pending.end() || next_roundoff != leaf_roundoff.end()) {
+        throw std::runtime_error("Invalid leaf-compact tree: leaves left over after the bisection tree closed");
+    }
+    return root;
+}
+
+std::size_t AdaptiveGaussTree::roundoff_limited_leaves() const {
+    std::size_t count = 0;
+    std::vector<const Node*> stack{root.get()};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (!node) continue;
+        if (is_roundoff_leaf(node)) ++count;
+        stack.push_back(node->left.get());
+        stack.push_back(node->right.get());
+    }
+    return count;
+}
+
+std::pair<double, double> AdaptiveGaussTree::get_integral_and_error() const {
+    if (summation == Summation::Method::Naive || summation == Summation::Method::Pairwise) return traverse_and_sum(root.get());
+    Summation::Accumulator integral(summation), error(summation);
+    sum_leaves(root.get(), integral, error);
+    return {integral.value(), error.value()};
+}
+
+std::unique_ptr<AdaptiveGaussTree> AdaptiveGaussTree::component_tree(std::size_t k) const {
+    if (k >= width) {
+        throw std::runtime_error("Component " + std::to_string(k) + " out of range (" + std::to_string(width) + " components).");
+    }
+    auto tree = std::make_unique<AdaptiveGaussTree>(*this);
+    VectorIntegrand f = vector_func;
+    std::size_t components = width;
+    tree->func = [f, components, k](ParamMap p, double x) {
+        std::vector<double> values(components);
+        f(p, x, values);
+        return values[k];
+    };
+    tree->vector_func = nullptr;
+    tree->width = 0;
+    if (k != 0) tree->stats = TreeStats();
+    select_component(tree->root.get(), k);
+    return tree;
+}
+
+std::vector<Breakpoint> AdaptiveGaussTree::interior_breakpoints(std::vector<Breakpoint> points, const IntervalMap& map) {
+    for (Breakpoint& p : points) p.x = map.u(p.x);
+    if (map.get_kind() == IntervalMap::Kind::Infinite) points.push_back({0.0});
+    double lower = map.u_lower(), upper = map.u_upper();
+    points.erase(std::remove_if(points.begin(), points.end(),
+                                [&](const Breakpoint& p) { return !(p.x > lower && p.x < upper); }), points.end());
+    std::sort(points.begin(), points.end(), [](const Breakpoint& p, const Breakpoint& q) { return p.x < q.x; });
+    points.erase(std::unique(points.begin(), points.end(), [](const Breakpoint& p, const Breakpoint& q) { return p.x == q.x; }),
+                 points.end());
+    return points;
+}
+
+std::optional<std::pair<bool, double>> AdaptiveGaussTree::singular_end(const Node* node) const {
+    if (at_endpoint_a(node) && a_singular) return std::make_pair(true, alpha_a);
+    for (const Breakpoint& p : breakpoints) {
+        if (p.singular && p.x == node->lower) return std::make_pair(true, p.alpha);
+    }
+    if (at_endpoint_b(node) && b_singular) return std::make_pair(false, alpha_b);
+    for (const Breakpoint& p : breakpoints) {
+        if (p.singular && p.x == node->upper) return std::make_pair(false, p.alpha);
+    }
+    return std::nullopt;
+}
+
+std::optional<bool> AdaptiveGaussTree::tail_end(const Node* node) const {
+    if (map.infinite_upper() && at_endpoint_b(node)) return true;
+    if (map.infinite_lower() && at_endpoint_a(node)) return false;
+    return std::nullopt;
+}
+
+std::function<double(ParamMap, double)> AdaptiveGaussTree::mapped_func() const {
+    return [this](ParamMap p, double u) { return func(std::move(p), map.x(u)) * map.jacobian(u); };
+}
+
+PointsIntegrand AdaptiveGaussTree::mapped_points_func() const {
+    return [this](const ParamMap& p, const std::vector<double>& u, std::vector<double>& out) {
+        std::vector<double> x(u.size());
+        for (std::size_t i = 0; i < u.size(); ++i) x[i] = map.x(u[i]);
+        points_func(p, x, out);
+        for (std::size_t i = 0; i < u.size(); ++i) out[i] *= map.jacobian(u[i]);
+    };
+}
+
+VectorIntegrand AdaptiveGaussTree::mapped_vector_func() const {
+    return [this](const ParamMap& p, double u, std::vector<double>& out) {
+        vector_func(p, map.x(u), out);
+        double jacobian = map.jacobian(u);
+        for (double& value : out) value *= jacobian;
+    };
+}
+
+void AdaptiveGaussTree::seed_breakpoints(Node* node) {
+    std::vector<double> inside;
+    for (const Breakpoint& p : breakpoints) {
+        if (p.x > node->lower && p.x < node->upper) inside.push_back(p.x);
+    }
+    if (inside.empty()) return;
+    double x = inside[inside.size() / 2];
+    node->seed = true;
+    node->pending = false;
+    node->left = std::make_unique<Node>(node->lower, x, node->depth + 1, node->tolerance / 2, order1, order2, false);
+    node->right = std::make_unique<Node>(x, node->upper, node->depth + 1, node->tolerance / 2, order1, order2, false);
+    node->left->pending = node->right->pending = true;
+    seed_breakpoints(node->left.get());
+    seed_breakpoints(node->right.get());
+}
+
+void AdaptiveGaussTree::sum_seeds(Node* node) {
+    if (!node || !node->seed) return;
+    sum_seeds(node->left.get());
+    sum_seeds(node->right.get());
+    node->result = node->left->result + node->right->result;
+    node->error = node->left->error + node->right->error;
+    node->component_results = node->left->component_results;
+    node->component_errors = node->left->component_errors;
+    for (std::size_t k = 0; k < node->component_results.size(); ++k) {
+        node->component_results[k] += node->right->component_results[k];
+        node->component_errors[k] += node->right->component_errors[k];
+    }
+}
+
+void AdaptiveGaussTree::select_component(Node* node, std::size_t k) {
+    if (!node) return;
+    if (!node->component_results.empty()) {
+        node->result = node->component_results[k];
+        node->error = node->component_errors[k];
+    }
+    node->component_results.clear();
+    node->component_errors.clear();
+    select_component(node->left.get(), k);
+    select_component(node->right.get(), k);
+}
+
+void AdaptiveGaussTree::evaluate_node(Node* node, TreeStats::Repeat repeat, bool laguerre_tail) {
+    std::optional<Trace::Span> level;   // one span per node when tracing with depth levels
+    if (Trace::depth_levels()) {
+        level.emplace("depth " + std::to_string(node->depth), "node");
+        level->arg("interval", {node->lower, node->upper});
+    }
+    double lower = node->lower, upper = node->upper;
+    auto singular = singular_end(node);
+    auto tail = singular || !laguerre_tail ? std::nullopt : tail_end(node);
+    bool use_laguerre = singular.has_value() || tail.has_value();
+    double alpha = singular ? singular->second : 0.0;
+    std::unique_ptr<Quadrature> quadrature;
+    if (singular) {
+        quadrature = std::make_unique<LaguerreSingularEndpoint>(roots_laguerre_n1, roots_laguerre_n2, node->order1, node->order2,
+                                                                lower, upper, singular->first, alpha);
+    } else if (tail) {
+        quadrature = std::make_unique<LaguerreQuadrature>(roots_laguerre_n1, roots_laguerre_n2, node->order1, node->order2,
+                                                          map.x(*tail ? lower : upper), *tail ? 1.0 : -1.0);
+    } else if (tanh_sinh()) {
+        quadrature = std::make_unique<TanhSinhQuadrature>(roots_legendre_n1, roots_legendre_n2, node->order1, node->order2, lower, upper);
+    } else {
+        quadrature = std::make_unique<LegendreQuadrature>(roots_legendre_n1, roots_legendre_n2, node->order1, node->order2, lower, upper);
+    }
+    quadrature->set_summation(summation);
+            
+#if AQ_STATS
+    auto start = std::chrono::steady_clock::now();
+#endif
+    double I2, err;
+    if (width > 0) {
+        err = quadrature->integrate_components(map.finite() || tail ? vector_func : mapped_vector_func(), args, width);
+        I2 = quadrature->getResult();
+        node->component_results = quadrature->getComponentResults();
+        node->component_errors = quadrature->getComponentErrors();
+    } else if (points_func) {
+        I2 = quadrature->integrate_points(map.finite() || tail ? points_func : mapped_points_func(), args);
+        err = quadrature->getError();
+    } else {
+        I2 = quadrature->integrate(map.finite() || tail ? func : mapped_func(), args);
+ //       double I1 = quadrature->integrate(func, {});  
+ //       double err = I2-I1  // ChatGPT needs a vacay.
+        err = quadrature->getError();
+    }
+    // With compensated sums a rule difference below Summation::roundoff is integrand noise: bisecting does not 
+    // reduce it, so the node stays a leaf.  (Plain sums add their own round-off, of unknown size, to the difference.)
+    node->roundoff_limited = false;
+    if (summation != Summation::Method::Naive && err >= node->tolerance) {
+        node->roundoff_limited = true;
+        for (std::size_t k = 0; k < width; ++k) {
+            double component_error = quadrature->getComponentErrors()[k];
+            if (component_error >= node->tolerance && component_error > quadrature->getComponentRoundoffs()[k]) {
+                node->roundoff_limited = false;
+            }
+        }
+        if (width == 0) node->roundoff_limited = err <= quadrature->getRoundoff();
+    }
+#if AQ_STATS
+    stats.count_node(node->depth, use_laguerre, quadrature->getEvaluations(),
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), repeat);
+#else
+    (void) repeat;
+#endif
+    
+    node->is_singular = use_laguerre;
+    node->alpha = alpha;
+    node->result = I2;
+    node->error = err;
+    node->pending = false;
+}
+
+void AdaptiveGaussTree::grow(const TreeCheckpoint& checkpoint) {
+    Trace::Span span("tree/build", "tree");
+    if (span.active()) {
+        std::ostringstream parameters;
+        parameters << args;
+        span.arg("parameters", parameters.str());
+    }
+    std::vector<Node*> stack;
+    collect_pending(root.get(), stack);
+    std::reverse(stack.begin(), stack.end());
+    auto last_checkpoint = std::chrono::steady_clock::now();
+#if AQ_STATS
+    auto build_start = last_checkpoint;
+#endif
+
+    while (!stack.empty()) {
+        if (checkpoint.stop && checkpoint.stop()) {
+            for (Node* pending : stack) evaluate_node(pending);
+            stack.clear();
+            best_effort = true;
+            break;
+        }
+        Node* node = stack.back();
+        stack.pop_back();
+        double base_error = evaluate_and_adapt(node);
+        if (extrapolates(node)) extrapolate_chain(node, stack);
+        else refine_or_close(node, base_error, stack);
+
+        if (checkpoint.save && !stack.empty()) {
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint.interval) {
+                checkpoint.save(*this);
+                last_checkpoint = now;
+            }
+        }
+    }
+    sum_seeds(root.get());
+#if AQ_STATS
+    stats.total_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count();
+#endif
+    if (span.active()) span.arg("nodes", node_count());
+}
+
+double AdaptiveGaussTree::evaluate_and_adapt(Node* node) {
+    evaluate_node(node);
+    if (detect.enabled && needs_refinement(node) && detect_endpoint(node)) {
+        evaluate_node(node, TreeStats::Repeat::EndpointSwitch);
+    }
+    if (needs_refinement(node) && !singular_end(node) && tail_end(node)) {
+        // Gauss-Laguerre assumes exponential decay; Gauss-Legendre in u suits algebraic decay.  The smaller 
+        // rule difference is kept.
+        const double laguerre_result = node->result, laguerre_error = node->error;
+        std::vector<double> laguerre_results = node->component_results, laguerre_errors = node->component_errors;
+        evaluate_node(node, TreeStats::Repeat::TailSwitch, false);
+        if (node->error > laguerre_error) {
+            node->result = laguerre_result;
+            node->error = laguerre_error;
+            node->component_results = std::move(laguerre_results);
+            node->component_errors = std::move(laguerre_errors);
+            node->is_singular = true;
+        }
+    }
+    const double base_error = node->error;
+    while (needs_refinement(node) && raise_order(node)) {
+        node->previous_error = node->error;
+        int next_order = std::min(hp.max_order, static_cast<int>(std::lround(static_cast<double>(node->order2) * node->order2 / node->order1)));
+        node->order1 = node->order2;
+        node->order2 = std::max(next_order, node->order1 + 1);
+        evaluate_node(node, TreeStats::Repeat::OrderRaise);
+    }
+    return base_error;
+}
+
+void AdaptiveGaussTree::bisect(Node* node, double base_error) {
+    double mid = (node->lower + node->upper) / 2;
+    node->left = std::make_unique<Node>(node->lower, mid, node->depth + 1, node->tolerance / 2, order1, order2, false);
+    node->right = std::make_unique<Node>(mid, node->upper, node->depth + 1, node->tolerance / 2, order1, order2, false);
+    node->left->pending = node->right->pending = true;
+    node->left->previous_error = node->right->previous_error = base_error / 2;
+}
+
+void AdaptiveGaussTree::refine_or_close(Node* node, double base_error, std::vector<Node*>& stack) {
+    if (node->depth < min_depth || (needs_refinement(node) && node->depth < max_depth)) {
+        bisect(node, base_error);
+        stack.push_back(node->right.get());
+        stack.push_back(node->left.get());
+    }
+#if AQ_STATS
+    else if (node->roundoff_limited) {
+        ++stats.roundoff_leaves;
+    }
+    else if (node->error >= node->tolerance) {
+        ++stats.failed_leaves;   // max_depth reached before the tolerance was met
+    }
+#endif
+}
+
+bool AdaptiveGaussTree::extrapolates(const Node* node) const {
+    return detect.extrapolate && width == 0 && needs_refinement(node) && !node->is_singular
+        && node->depth >= min_depth && node->depth < max_depth
+        && at_endpoint_a(node) != at_endpoint_b(node) && !singular_end(node) && !tail_end(node);
+}
+
+void AdaptiveGaussTree::extrapolate_chain(Node* node, std::vector<Node*>& stack) {
+    const bool toward_a = at_endpoint_a(node);
+    WynnEpsilon wynn;
+    wynn.add(node->result);
+    double far_sum = 0.0, base_error = node->error;
+    Node* end = node;
+    while (true) {
+        bisect(end, base_error);
+        Node* far = toward_a ? end->right.get() : end->left.get();
+        Node* near = toward_a ? end->left.get() : end->right.get();
+        refine_or_close(far, evaluate_and_adapt(far), stack);
+        far_sum += far->result;
+        base_error = evaluate_and_adapt(near);
+        end = near;
+        if (near->is_singular || !needs_refinement(near) || near->depth >= max_depth) break;
+        wynn.add(far_sum + near->result);
+        if (wynn.error() < near->tolerance) {
+            near->result = wynn.limit() - far_sum;
+            near->error = wynn.error();
+            near->extrapolated = true;
+#if AQ_STATS
+            ++stats.extrapolations;
+#endif
+            return;
+        }
+    }
+    refine_or_close(end, base_error, stack);
+}
+
+bool AdaptiveGaussTree::raise_order(const Node* node) const {
+    if (hp.max_order <= 0 || node->is_singular || tail_end(node) || node->order2 >= hp.max_order || node->depth < min_depth) return false;
+    if (node->depth >= max_depth) return true;
+    return node->previous_error < 0 || node->error <= hp.smoothness * node->previous_error;
+}
+
+bool AdaptiveGaussTree::detect_endpoint(const Node* node) {
+    if (node->is_singular || node->depth < detect.levels) return false;
+    for (bool lower_endpoint : {true, false}) {
+        if (lower_endpoint ? (a_singular || map.infinite_lower() || !at_endpoint_a(node))
+                           : (b_singular || map.infinite_upper() || !at_endpoint_b(node))) continue;
+        std::vector<double> errors;
+        for (const Node* n = root.get(); n; n = lower_endpoint ? n->left.get() : n->right.get()) {
+            if (!n->seed) errors.push_back(n->error);   // bisections only
+            if (n == node) break;
+        }
+        if (errors.size() <= static_cast<std::size_t>(detect.levels)) continue;
+        std::vector<double> slopes;   // log2 of the last `levels` error ratios
+        for (std::size_t i = errors.size() - detect.levels; i < errors.size(); ++i) {
+            if (!(errors[i] > 0.0 && errors[i] < errors[i - 1])) break;
+            slopes.push_back(std::log2(errors[i] / errors[i - 1]));
+        }
+        if (slopes.size() != static_cast<std::size_t>(detect.levels)) continue;
+        double mean = 0.0;
+        for (double slope : slopes) mean += slope / slopes.size();
+        double alpha = 1.0 + mean;
+        if (alpha < detect.min_alpha || alpha > 0.95
+            || std::any_of(slopes.begin(), slopes.end(), [&](double slope) { return std::abs(slope - mean) > detect.max_spread; })) continue;
+        (lower_endpoint ? a_singular : b_singular) = true;
+        (lower_endpoint ? alpha_a : alpha_b) = alpha;
+        (lower_endpoint ? detected_alpha_a : detected_alpha_b) = alpha;
+        return true;
+    }
+    return false;
+}
+
+void AdaptiveGaussTree::recover_detected_endpoints() {
+    for (bool lower_endpoint : {true, false}) {
+        if (lower_endpoint ? a_singular || map.infinite_lower() : b_singular || map.infinite_upper()) continue;
+        for (const Node* n = lower_endpoint ? root->left.get() : root->right.get(); n && !n->pending;
+             n = lower_endpoint ? n->left.get() : n->right.get()) {
+            if (!n->is_singular) continue;
+            (lower_endpoint ? a_singular : b_singular) = true;
+            (lower_endpoint ? alpha_a : alpha_b) = n->alpha;
+            (lower_endpoint ? detected_alpha_a : detected_alpha_b) = n->alpha;
+            break;
+        }
+    }
+}
+
+void AdaptiveGaussTree::collect_pending(Node* node, std::vector<Node*>& pending) {
+    if (!node) return;
+    if (node->pending) pending.push_back(node);
+    collect_pending(node->left.get(), pending);
+    collect_pending(node->right.get(), pending);
+}
+
+void AdaptiveGaussTree::sum_leaves(const Node* node, Summation::Accumulator& integral, Summation::Accumulator& error) {
+    if (!node) return;
+    if (!node->left && !node->right) {
+        integral.add(node->result);
+        error.add(node->error);
+        return;
+    }
+    sum_leaves(node->left.get(), integral, error);
+    sum_leaves(node->right.get(), integral, error);
+}
 
 std::ostream& operator<<(std::ostream& os, const AdaptiveGaussTree& tree) {
     auto [integral, error] = tree.get_integral_and_error();
@@ -0,0 +1,221 @@
+#include <aq_c_api.h>
+#include <adaptive_gauss_batch.hpp>
+#include <batch_snapshot.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The handle: the batch, and a snapshot of its integrals for the bulk lookups
+struct aq_batch {
+    explicit aq_batch(AdaptiveGaussTreeBatch trees) : batch(std::move(trees)), snapshot(batch) {
+        if (!batch.getCollection().empty()) {
+            for (const auto& entry : batch.getCollection().begin()->first) keys.push_back(entry.first);
+            std::sort(keys.begin(), keys.end());
+        }
+    }
+    AdaptiveGaussTreeBatch batch;
+    BatchSnapshot snapshot;
+    std::vector<std::string> keys;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// Runs `body`, turning an exception into `failed` and the message of aq_last_error()
+template <typename Result, typename Body>
+Result guarded(Result failed, Body body) {
+    try {
+        last_error.clear();
+        return body();
+    } catch (const std::exception& e) {
+        last_error = e.what();
+    } catch (...) {
+        last_error = "Unknown C++ exception.";
+    }
+    return failed;
+}
+
+void require(const void* pointer, const char* name) {
+    if (!pointer) throw std::invalid_argument(std::string(name) + " is NULL.");
+}
+
+ParamType param_value(double value, bool is_int) {
+    if (is_int) return static_cast<int>(std::lround(value));
+    return value;
+}
+
+// Row of a combinations array into `param_map` (reused across rows, so that the keys are allocated once)
+const ParamMap& combination(const std::vector<std::string>& keys, const int* is_int, const double* row, ParamMap& param_map) {
+    for (std::size_t k = 0; k < keys.size(); ++k) param_map[keys[k]] = param_value(row[k], is_int[k] != 0);
+    return param_map;
+}
+
+std::vector<std::string> key_names(std::size_t n_keys, const char* const* keys) {
+    std::vector<std::string> names;
+    for (std::size_t k = 0; k < n_keys; ++k) {
+        require(keys[k], "A key");
+        names.emplace_back(keys[k]);
+    }
+    return names;
+}
+
+// The C integrand as the engine sees it: all points of a rule at once, parameter values in the order of `keys`
+PointsIntegrand wrap(aq_integrand f, void* user_data, std::vector<std::string> keys) {
+    return [f, user_data, keys](const ParamMap& p, const std::vector<double>& x, std::vector<double>& out) {
+        thread_local std::vector<double> params;
+        params.resize(keys.size());
+        for (std::size_t k = 0; k < keys.size(); ++k) {
+            const ParamType& value = p.at(keys[k]);
+            params[k] = std::holds_alternative<int>(value) ? std::get<int>(value) : std::get<double>(value);
+        }
+        f(x.data(), x.size(), params.data(), params.size(), out.data(), user_data);
+    };
+}
+
+aq_batch* build(aq_integrand f, void* user_data, const aq_settings* settings, const std::vector<std::string>& keys,
+                std::vector<ParamMap> combinations) {
+    if (!f) throw std::invalid_argument("The integrand is NULL.");
+    aq_settings s = settings ? *settings : aq_default_settings();
+    require(s.legendre_file, "settings->legendre_file");
+    require(s.laguerre_file, "settings->laguerre_file");
+    WeightsLoader legendre(s.legendre_file), laguerre(s.laguerre_file);
+    return new aq_batch(AdaptiveGaussTreeBatch(
+        wrap(f, user_data, keys), s.lower, s.upper, s.tol, s.min_depth, s.max_depth, s.n1, s.n2,
+        s.alpha_a, s.alpha_b, s.a_singular != 0, s.b_singular != 0, legendre, legendre, laguerre, laguerre,
+        std::move(combinations), "Project", "Author", "project description", "references", "1.0", "Built through the C API"));
+}
+
+}  // namespace
+
+extern "C" {
+
+int aq_api_version(void) {
+    return AQ_C_API_VERSION;
+}
+
+const char* aq_last_error(void) {
+    return last_error.c_str();
+}
+
+aq_settings aq_default_settings(void) {
+    aq_settings settings;
+    settings.lower = 0.0;
+    settings.upper = 1.0;
+    settings.tol = 1e-12;
+    settings.min_depth = 2;
+    settings.max_depth = 20;
+    settings.n1 = 100;
+    settings.n2 = 150;
+    settings.alpha_a = 0.0;
+    settings.alpha_b = 0.0;
+    settings.a_singular = 0;
+    settings.b_singular = 0;
+    settings.legendre_file = "../model_json/legendre.json";
+    settings.laguerre_file = "../model_json/laguerre.json";
+    return settings;
+}
+
+aq_batch* aq_batch_build_grid(aq_integrand f, void* user_data, const aq_settings* settings,
+                              size_t n_keys, const char* const* keys, const int* is_int,
+                              const size_t* n_values, const double* const* values) {
+    return guarded<aq_batch*>(nullptr, [&] {
+        if (n_keys > 0) {
+            require(keys, "keys");
+            require(is_int, "is_int");
+            require(n_values, "n_values");
+            require(values, "values");
+        }
+        ParamCollection parameters;
+        std::vector<std::string> names = key_names(n_keys, keys);
+        for (std::size_t k = 0; k < n_keys; ++k) {
+            if (n_values[k] > 0) require(values[k], "A values array");
+            if (is_int[k]) {
+                std::vector<int> ints;
+                for (std::size_t i = 0; i < n_values[k]; ++i) ints.push_back(static_cast<int>(std::lround(values[k][i])));
+                parameters[names[k]] = ints;
+            } else {
+                parameters[names[k]] = std::vector<double>(values[k], values[k] + n_values[k]);
+            }
+        }
+        return build(f, user_data, settings, names, AdaptiveGaussTreeBatch::expand_grid(parameters));
+    });
+}
+
+aq_batch* aq_batch_build(aq_integrand f, void* user_data, const aq_settings* settings,
+                         size_t n_keys, const char* const* keys, const int* is_int,
+                         size_t n_combinations, const double* combinations) {
+    return guarded<aq_batch*>(nullptr, [&] {
+        if (n_keys > 0) {
+            require(keys, "keys");
+            require(is_int, "is_int");
+        }
+        if (n_keys > 0 && n_combinations > 0) require(combinations, "combinations");
+        std::vector<std::string> names = key_names(n_keys, keys);
+        std::vector<ParamMap> rows;
+        rows.reserve(n_combinations);
+        ParamMap row;
+        for (std::size_t i = 0; i < n_combinations; ++i) rows.push_back(combination(names, is_int, combinations + i * n_keys, row));
+        return build(f, user_data, settings, names, std::move(rows));
+    });
+}
+
+aq_batch* aq_batch_load(const char* filename) {
+    return guarded<aq_batch*>(nullptr, [&] {
+        require(filename, "filename");
+        return new aq_batch(AdaptiveGaussTreeBatch(nullptr, filename));
+    });
+}
+
+int aq_batch_save(aq_batch* batch, const char* filename, int compact) {
+    return guarded(-1, [&] {
+        require(batch, "batch");
+        require(filename, "filename");
+        batch->batch.save_to_json(filename, true, false, false, compact != 0);
+        return 0;
+    });
+}
+
+void aq_batch_free(aq_batch* batch) {
+    delete batch;
+}
+
+size_t aq_batch_size(const aq_batch* batch) {
+    return batch ? batch->snapshot.size() : 0;
+}
+
+size_t aq_batch_key_count(const aq_batch* batch) {
+    return batch ? batch->keys.size() : 0;
+}
+
+const char* aq_batch_key(const aq_batch* batch, size_t k) {
+    return batch && k < batch->keys.size() ? batch->keys[k].c_str() : nullptr;
+}
+
+int aq_batch_lookup(const aq_batch* batch, size_t n_keys, const char* const* keys, const int* is_int,
+                    size_t n_combinations, const double* combinations, double* integrals, double* errors) {
+    return guarded(-1, [&] {
+        require(batch, "batch");
+        if (n_keys > 0) {
+            require(keys, "keys");
+            require(is_int, "is_int");
+            if (n_combinations > 0) require(combinations, "combinations");
+        }
+        std::vector<std::string> names = key_names(n_keys, keys);
+        const double missing = std::numeric_limits<double>::quiet_NaN();
+        ParamMap row;
+        for (std::size_t i = 0; i < n_combinations; ++i) {
+            const std::pair<double, double>* entry = batch->snapshot.find(combination(names, is_int, combinations + i * n_keys, row));
+            if (integrals) integrals[i] = entry ? entry->first : missing;
+            if (errors) errors[i] = entry ? entry->second : missing;
+        }
+        return 0;
+    });
+}
+
+}  // extern "C"
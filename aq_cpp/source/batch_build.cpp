@@ -0,0 +1,83 @@
+#include <batch_build.hpp>
+#include <chrono>
+
+BatchBuild::BatchBuild(
+    std::function<double(ParamMap, double)> func,
+    double lower, double upper,
+    double tol, int min_depth, int max_depth, int n1, int n2,
+    double alphaA, double alphaB,
+    bool a_singular, bool b_singular,
+    WeightsLoader legendre_n1, WeightsLoader legendre_n2, WeightsLoader laguerre_n1, WeightsLoader laguerre_n2,
+    ParamCollection parameters,
+    BatchControl control,
+    std::string name, std::string author, std::string description,
+    std::string reference, std::string version, std::string update_log_message,
+    BatchCheckpoint checkpoint,
+    HpRefinement hp, SingularityDetection detect, BreakpointFunction breakpoints, Summation::Method summation
+) : state(std::make_shared<State>()) {
+    if (!control.cancel) control.cancel = std::make_shared<std::atomic<bool>>(false);
+    state->cancel = control.cancel;
+    // The handle keeps the last report; the caller's callback still runs after it
+    control.progress = [shared = state, forward = std::move(control.progress)](const BatchProgress& progress) {
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->progress = progress;
+        }
+        if (forward) forward(progress);
+    };
+    result = std::async(std::launch::async, [=] {
+        return AdaptiveGaussTreeBatch(func, lower, upper, tol, min_depth, max_depth, n1, n2, alphaA, alphaB,
+                                      a_singular, b_singular, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2,
+                                      parameters, name, author, description, reference, version, update_log_message,
+                                      checkpoint, hp, detect, breakpoints, summation, control);
+    });
+}
+
+BatchBuild::~BatchBuild() {
+    if (result.valid()) {
+        cancel();
+        result.wait();
+    }
+}
+
+BatchBuild& BatchBuild::operator=(BatchBuild&& other) {
+    if (this != &other) {
+        // the future of std::async would wait for the replaced build in its destructor, without cancelling it
+        if (result.valid()) {
+            cancel();
+            result.wait();
+        }
+        state = std::move(other.state);
+        result = std::move(other.result);
+    }
+    return *this;
+}
+
+void BatchBuild::check_state() const {
+    if (!state) throw std::logic_error("BatchBuild handle has no build (it was moved from).");
+}
+
+BatchProgress BatchBuild::progress() const {
+    check_state();
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->progress;
+}
+
+void BatchBuild::cancel() {
+    if (state) state->cancel->store(true, std::memory_order_relaxed);
+}
+
+bool BatchBuild::ready() const {
+    return result.valid() && result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void BatchBuild::wait() const {
+    check_state();
+    if (result.valid()) result.wait();
+}
+
+AdaptiveGaussTreeBatch BatchBuild::get() {
+    check_state();
+    if (!result.valid()) throw std::logic_error("BatchBuild::get() called twice.");
+    return result.get();
+}
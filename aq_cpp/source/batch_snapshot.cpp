@@ -0,0 +1,25 @@
+#include <batch_snapshot.hpp>
+#include <sstream>
+#include <stdexcept>
+
+BatchSnapshot::BatchSnapshot(const AdaptiveGaussTreeBatch& batch) {
+    const QuadCollection& trees = batch.getCollection();
+    entries.reserve(trees.size());
+    for (const auto& [param_map, tree] : trees) entries.emplace(param_map, tree->get_integral_and_error());
+    if (!batch.get_update_log().empty()) update = batch.get_update_log().back();
+}
+
+const std::pair<double, double>* BatchSnapshot::find(const ParamMap& param_map) const {
+    auto it = entries.find(param_map);
+    return it == entries.end() ? nullptr : &it->second;
+}
+
+const std::pair<double, double>& BatchSnapshot::at(const ParamMap& param_map) const {
+    const std::pair<double, double>* entry = find(param_map);
+    if (!entry) {
+        std::ostringstream message;
+        message << "No tree for " << param_map << " in the snapshot.";
+        throw std::out_of_range(message.str());
+    }
+    return *entry;
+}
@@ -0,0 +1,42 @@
+#include <integrand_registry.hpp>
+#include <polylog_port.hpp>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+    std::mutex registry_mutex;
+
+    std::map<std::string, IntegrandRegistry::Integrand>& registry() {
+        static std::map<std::string, IntegrandRegistry::Integrand> integrands{
+            {"polylog", polylog_wrapper},
+        };
+        return integrands;
+    }
+}
+
+void IntegrandRegistry::add(const std::string& name, Integrand func) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry()[name] = std::move(func);
+}
+
+IntegrandRegistry::Integrand IntegrandRegistry::get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto it = registry().find(name);
+    if (it == registry().end()) {
+        throw std::runtime_error("Unknown integrand: " + name);
+    }
+    return it->second;
+}
+
+bool IntegrandRegistry::contains(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry().count(name) != 0;
+}
+
+std::vector<std::string> IntegrandRegistry::names() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::vector<std::string> result;
+    for (const auto& pair : registry()) result.push_back(pair.first);
+    return result;
+}
@@ -0,0 +1,528 @@
+#include <json_sax_loader.hpp>
+#include <adaptive_gauss_tree.hpp>
+#include <adaptive_gauss_batch.hpp>
+#include <trace.hpp>
+#include <fstream>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <memory>
+#include <stdexcept>
+#include <cstdlib>
+#include <cctype>
+#include <limits>
+#include <cerrno>
+#include <charconv>
+
+// SAX handler shared by all three file layouts.  A stack of frames records where we are in the document;
+// scalars at the top level go into `header` (a tiny object, never a tree), everything else is written
+// straight into its final container.
+class JsonSaxLoader::Handler : public nlohmann::json_sax<json> {
+public:
+    using Node = AdaptiveGaussTree::Node;
+
+    json header = json::object();
+    std::vector<std::pair<std::string, std::string>> update_log;
+    bool has_update_log = false;
+    std::map<std::string, std::vector<std::vector<double>>> roots;        // "legendre_roots_n1" -> {nodes, weights}
+    std::vector<std::pair<ParamMap, std::unique_ptr<Node>>> trees;        // one entry per "tree" key
+    std::unordered_set<ParamMap, ParamMapHash, ParamMapEqual> best_effort;   // batch trees with "best_effort": true
+    std::map<int, std::vector<double>> rule_nodes, rule_weights;          // root table: order -> nodes / weights
+
+    // Arrays of a leaf-compact tree, collected until its object closes (AdaptiveGaussTree::serialize_tree_compact)
+    struct CompactLeaves {
+        std::vector<double> leaf_depths, integrals, errors, method_index, leaf_n1, leaf_n2, leaf_a, leaf_alpha, leaf_seeds, leaf_pending, leaf_roundoff;
+        std::vector<std::string> methods;
+    };
+    std::map<Node*, CompactLeaves> compact;
+
+    // Nodes carry rule orders only where they differ from the header ("n1", "n2"), i.e. after an hp order raise;
+    // the others are still 0 here
+    static void assign_orders(Node* root, int order1, int order2) {
+        std::vector<Node*> pending{root};
+        while (!pending.empty()) {
+            Node* node = pending.back();
+            pending.pop_back();
+            if (!node) continue;
+            if (node->order1 == 0) {
+                node->order1 = order1;
+                node->order2 = order2;
+            }
+            pending.push_back(node->left.get());
+            pending.push_back(node->right.get());
+        }
+    }
+
+    bool null() override { return scalar(nullptr); }
+    bool boolean(bool val) override { return scalar(val); }
+    bool number_integer(number_integer_t val) override { return number(val); }
+    bool number_unsigned(number_unsigned_t val) override { return number(val); }
+    bool number_float(number_float_t val, const string_t&) override { return number(val); }
+    bool string(string_t& val) override { return scalar(val); }
+    bool binary(binary_t&) override { return true; }
+
+    bool key(string_t& val) override {
+        key_ = val;
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        if (stack.empty()) {
+            stack.push_back({Context::Top});
+            return true;
+        }
+        const Frame top = stack.back();
+        switch (top.context) {
+            case Context::Top:
+                if (key_ == "parameters") stack.push_back({Context::Parameters});
+                else if (key_ == "tree") push_root();
+                else if (key_ == "n") stack.push_back({Context::Orders});
+                else stack.push_back({Context::Skip});
+                break;
+            case Context::UpdateLog:
+                log_entry = {};
+                stack.push_back({Context::LogEntry});
+                break;
+            case Context::Parameters:
+                if (top.value_level) {
+                    // key_ is a parameter value, e.g. "0.5" under "z"
+                    param_path.emplace_back(top.name, parse_param_value(key_));
+                    Frame frame{Context::Parameters};
+                    frame.assigned = true;
+                    stack.push_back(frame);
+                } else if (key_ == "tree") {
+                    push_root();
+                } else if (key_ == "stats") {
+                    stack.push_back({Context::Skip});   // build statistics of the tree, not a parameter
+                } else {
+                    // key_ is a parameter name, e.g. "z"
+                    Frame frame{Context::Parameters};
+                    frame.value_level = true;
+                    frame.name = key_;
+                    stack.push_back(frame);
+                }
+                break;
+            case Context::Node:
+                if (key_ == "left" || key_ == "right") {
+                    auto child = new_node();
+                    Frame frame{Context::Node};
+                    frame.node = child.get();
+                    (key_ == "left" ? top.node->left : top.node->right) = std::move(child);
+                    stack.push_back(frame);
+                } else {
+                    stack.push_back({Context::Skip});
+                }
+                break;
+            case Context::Orders: {
+                Frame frame{Context::Order};
+                frame.order = std::stoi(key_);
+                stack.push_back(frame);
+                break;
+            }
+            default:
+                stack.push_back({Context::Skip});
+        }
+        return true;
+    }
+
+    bool end_object() override {
+        const Frame frame = stack.back();
+        stack.pop_back();
+        if (frame.context == Context::Node) expand_compact(frame.node);
+        if (frame.context == Context::LogEntry) update_log.push_back(log_entry);
+        if (frame.context == Context::Parameters && frame.assigned) param_path.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        const Frame top = stack.empty() ? Frame{Context::Skip} : stack.back();
+        Frame frame{Context::Skip};
+        if (top.context == Context::Top && key_ == "update_log") {
+            has_update_log = true;
+            frame.context = Context::UpdateLog;
+        } else if (top.context == Context::Top && key_.find("_roots_") != std::string::npos) {
+            frame.context = Context::Roots;
+            frame.name = key_;
+            roots[key_].reserve(2);
+        } else if (top.context == Context::Roots) {
+            auto& rows = roots[top.name];
+            rows.emplace_back();
+            frame.context = Context::Vector;
+            frame.vec = &rows.back();
+        } else if (top.context == Context::Node && key_ == "methods") {
+            frame.context = Context::Strings;
+            frame.strings = &compact[top.node].methods;
+        } else if (top.context == Context::Node && (key_ == "leaf_depths" || key_ == "integral" || key_ == "error" || key_ == "method"
+                                                    || key_ == "leaf_n1" || key_ == "leaf_n2" || key_ == "leaf_a"
+                                                    || key_ == "leaf_alpha" || key_ == "leaf_seeds" || key_ == "leaf_pending"
+                                                    || key_ == "leaf_roundoff")) {
+            CompactLeaves& leaves = compact[top.node];
+            frame.context = Context::Vector;
+            frame.vec = key_ == "leaf_depths" ? &leaves.leaf_depths : key_ == "integral" ? &leaves.integrals
+                      : key_ == "error" ? &leaves.errors : key_ == "leaf_n1" ? &leaves.leaf_n1
+                      : key_ == "leaf_n2" ? &leaves.leaf_n2 : key_ == "leaf_a" ? &leaves.leaf_a
+                      : key_ == "leaf_alpha" ? &leaves.leaf_alpha : key_ == "leaf_seeds" ? &leaves.leaf_seeds
+                      : key_ == "leaf_pending" ? &leaves.leaf_pending : key_ == "leaf_roundoff" ? &leaves.leaf_roundoff
+                      : &leaves.method_index;
+        } else if (top.context == Context::Order && (key_ == "0" || key_ == "1")) {
+            frame.context = Context::Vector;
+            frame.vec = key_ == "0" ? &rule_nodes[top.order] : &rule_weights[top.order];
+        }
+        stack.push_back(frame);
+        return true;
+    }
+
+    bool end_array() override {
+        stack.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex) override {
+        throw std::runtime_error("JSON parse error at byte " + std::to_string(position) + ": " + ex.what());
+    }
+
+private:
+    enum class Context { Top, Skip, UpdateLog, LogEntry, Roots, Vector, Strings, Parameters, Node, Orders, Order };
+    struct Frame {
+        Frame(Context context) : context(context) {}
+        Context context;
+        Node* node = nullptr;                 // Context::Node
+        std::vector<double>* vec = nullptr;   // Context::Vector
+        std::vector<std::string>* strings = nullptr;   // Context::Strings
+        bool value_level = false;             // Context::Parameters: keys are values of `name` rather than names
+        bool assigned = false;                // Context::Parameters: entered through a value, pop param_path on exit
+        std::string name;
+        int order = 0;                        // Context::Order
+    };
+
+    std::vector<Frame> stack;
+    std::string key_;
+    std::vector<std::pair<std::string, ParamType>> param_path;
+    std::pair<std::string, std::string> log_entry;
+
+    // A node object that carried leaf arrays is replaced by the full tree they describe
+    void expand_compact(Node* node) {
+        auto it = compact.find(node);
+        if (it == compact.end()) return;
+        const CompactLeaves& leaves = it->second;
+        std::vector<int> leaf_depths(leaves.leaf_depths.begin(), leaves.leaf_depths.end());
+        std::vector<int> method_index(leaves.method_index.begin(), leaves.method_index.end());
+        std::vector<int> leaf_n1(leaves.leaf_n1.begin(), leaves.leaf_n1.end());
+        std::vector<int> leaf_n2(leaves.leaf_n2.begin(), leaves.leaf_n2.end());
+        std::vector<int> leaf_seeds(leaves.leaf_seeds.begin(), leaves.leaf_seeds.end());
+        std::vector<int> leaf_pending(leaves.leaf_pending.begin(), leaves.leaf_pending.end());
+        std::vector<int> leaf_roundoff(leaves.leaf_roundoff.begin(), leaves.leaf_roundoff.end());
+        auto expanded = AdaptiveGaussTree::expand_compact_tree(node->lower, node->upper, node->tolerance,
+            leaf_depths, leaves.integrals, leaves.errors, leaves.methods, method_index, node->order1, node->order2,
+            leaf_n1, leaf_n2, leaves.leaf_a, leaves.leaf_alpha, leaf_seeds, leaf_pending, leaf_roundoff);
+        *node = std::move(*expanded);
+        compact.erase(it);
+    }
+
+    static std::unique_ptr<Node> new_node() {
+        return std::make_unique<Node>(0.0, 0.0, 0, 0.0, 0, 0, false);
+    }
+
+    ParamMap current_params() const {
+        ParamMap param_map;
+        for (const auto& [name, value] : param_path) param_map[name] = value;
+        return param_map;
+    }
+
+    void push_root() {
+        auto root = new_node();
+        Frame frame{Context::Node};
+        frame.node = root.get();
+        trees.emplace_back(current_params(), std::move(root));
+        stack.push_back(frame);
+    }
+
+    template <typename T>
+    bool number(T val) {
+        const Frame& top = stack.back();
+        if (top.context == Context::Vector) {
+            top.vec->push_back(static_cast<double>(val));
+            return true;
+        }
+        if (top.context == Context::Node) {
+            Node* node = top.node;
+            if (key_ == "a") node->lower = static_cast<double>(val);
+            else if (key_ == "b") node->upper = static_cast<double>(val);
+            else if (key_ == "depth") node->depth = static_cast<int>(val);
+            else if (key_ == "tol") node->tolerance = static_cast<double>(val);
+            else if (key_ == "error") node->error = static_cast<double>(val);
+            else if (key_ == "integral") node->result = static_cast<double>(val);
+            else if (key_ == "n1") node->order1 = static_cast<int>(val);
+            else if (key_ == "n2") node->order2 = static_cast<int>(val);
+            else if (key_ == "alpha") node->alpha = static_cast<double>(val);
+            return true;
+        }
+        return scalar(json(val));
+    }
+
+    bool scalar(const json& value) {
+        const Frame& top = stack.back();
+        switch (top.context) {
+            case Context::Top:
+                header[key_] = value;
+                break;
+            case Context::LogEntry:
+                if (key_ == "timestamp") log_entry.first = value.is_string() ? value.get<std::string>() : value.dump();
+                if (key_ == "message") log_entry.second = value.is_string() ? value.get<std::string>() : value.dump();
+                break;
+            case Context::Node:
+                if (key_ == "method") {
+                    top.node->is_singular = (value == "Gauss-Laguerre");
+                    top.node->extrapolated = (value == "Wynn-epsilon");
+                }
+                if (key_ == "seed") top.node->seed = (value == true);
+                if (key_ == "roundoff_limited") top.node->roundoff_limited = (value == true);
+                break;
+            case Context::Strings:
+                top.strings->push_back(value.is_string() ? value.get<std::string>() : value.dump());
+                break;
+            case Context::Parameters:
+                if (!top.value_level && key_ == "tree" && value.is_null()) {
+                    throw std::runtime_error("'tree' key is null in JSON");
+                }
+                if (!top.value_level && key_ == "best_effort" && value == true) best_effort.insert(current_params());
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+};
+
+namespace {
+
+// Header strings may be null in files written from Python (e.g. "reference": null)
+std::string header_string(const json& header, const std::string& key) {
+    auto it = header.find(key);
+    if (it == header.end() || it->is_null()) return "";
+    return it->is_string() ? it->get<std::string>() : it->dump();
+}
+
+}  // namespace
+
+void JsonSaxLoader::parse(const std::string& filename, Handler& handler) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Error opening file: " + filename);
+    }
+    json::sax_parse(file, &handler);
+}
+
+ParamType JsonSaxLoader::parse_param_value(const std::string& key) {
+    if (!key.empty() && (std::isdigit(static_cast<unsigned char>(key[0])) || key[0] == '-' || key[0] == '+' || key[0] == '.')) {
+        const char* begin = key.c_str();
+        char* end = nullptr;
+        errno = 0;
+        long as_long = std::strtol(begin, &end, 10);
+        if (*end == '\0' && errno == 0 && as_long >= std::numeric_limits<int>::min() && as_long <= std::numeric_limits<int>::max()) {
+            return static_cast<int>(as_long);
+        }
+        double as_double = std::strtod(begin, &end);
+        if (*end == '\0') return as_double;
+    }
+    return key;
+}
+
+std::string JsonSaxLoader::format_param_value(const ParamType& value) {
+    if (std::holds_alternative<int>(value)) return std::to_string(std::get<int>(value));
+    if (std::holds_alternative<std::string>(value)) return std::get<std::string>(value);
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), std::get<double>(value));
+    std::string key(buffer, ec == std::errc() ? end : buffer);
+    if (key.find_first_of(".eni") == std::string::npos) key += ".0";   // no point, exponent, inf or nan
+    return key;
+}
+
+void JsonSaxLoader::load_weights(const std::string& filename, WeightsLoader& loader) {
+    Handler handler;
+    parse(filename, handler);
+
+    loader.method = handler.header.at("method").get<std::string>();
+    loader.n_max = handler.header.at("n_max").get<int>();
+    loader.index.reset();
+    loader.rules.clear();
+    for (auto& [order, values] : handler.rule_nodes) {
+        loader.rules[order] = std::make_shared<const QuadratureRule>(
+            QuadratureRule{std::move(values), std::move(handler.rule_weights[order]), {}});
+    }
+}
+
+void JsonSaxLoader::load_tree(const std::string& filename, AdaptiveGaussTree& tree) {
+    Trace::Span span("tree/load", "io");
+    span.arg("file", filename);
+    Handler handler;
+    parse(filename, handler);
+    const json& header = handler.header;
+
+    if (handler.trees.empty()) {
+        throw std::runtime_error("'tree' key missing in JSON: " + filename);
+    }
+    tree.name = header_string(header, "name");
+    tree.reference = header_string(header, "reference");
+    tree.description = header_string(header, "description");
+    tree.author = header_string(header, "author");
+    tree.version = header_string(header, "version");
+    tree.tolerance = header.at("tolerance").get<double>();
+    tree.min_depth = header.at("min_depth").get<int>();
+    tree.max_depth = header.at("max_depth").get<int>();
+    tree.order1 = header.at("n1").get<int>();
+    tree.order2 = header.at("n2").get<int>();
+    tree.hp.max_order = header.value("hp_max_order", 0);
+    tree.hp.smoothness = header.value("hp_smoothness", HpRefinement().smoothness);
+    tree.read_detection_header(header);
+    tree.summation = Summation::from_string(header.value("summation", "naive"));
+    tree.best_effort = header.value("best_effort", false);
+    tree.update_log = std::move(handler.update_log);
+    tree.root = std::move(handler.trees.front().second);
+    tree.map = IntervalMap::from_header(header, tree.root->lower, tree.root->upper);
+    Handler::assign_orders(tree.root.get(), tree.order1, tree.order2);
+}
+
+void JsonSaxLoader::load_batch(const std::string& filename, AdaptiveGaussTreeBatch& batch) {
+    Trace::Span span("batch/load", "io");
+    span.arg("file", filename);
+    batch.quad_coll.clear();
+    batch.update_log.clear();
+    if (!is_segment_log(filename)) {
+        Handler handler;
+        parse(filename, handler);
+        apply_batch_segment(handler, batch, true);
+    } else {
+        // One complete document per line; trees of a later segment replace earlier ones with the same parameters
+        std::ifstream file(filename, std::ios::binary);
+        std::string line;
+        bool first = true;
+        while (std::getline(file, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            Handler handler;
+            try {
+                json::sax_parse(line, &handler);
+            } catch (const std::runtime_error&) {
+                if (file.peek() == std::char_traits<char>::eof()) break;   // torn final append, ignore it
+                throw;
+            }
+            apply_batch_segment(handler, batch, first);
+            first = false;
+        }
+        if (first) {
+            throw std::runtime_error("No complete segment in batch log: " + filename);
+        }
+        batch.logged[filename] = batch.update_log.size();   // appending to this log again adds only new entries
+    }
+
+    // Parameter names and values come from the paths that lead to each "tree"
+    std::set<std::string> key_set;
+    std::map<std::string, std::set<int>> int_sets;
+    std::map<std::string, std::set<double>> double_sets;
+    std::map<std::string, std::set<std::string>> string_sets;
+    batch.results.clear();
+    for (const auto& [param_map, tree] : batch.quad_coll) {
+        batch.results.push_back(param_map);
+        for (const auto& [key, value] : param_map) {
+            key_set.insert(key);
+            if (std::holds_alternative<int>(value)) int_sets[key].insert(std::get<int>(value));
+            else if (std::holds_alternative<double>(value)) double_sets[key].insert(std::get<double>(value));
+            else string_sets[key].insert(std::get<std::string>(value));
+        }
+    }
+    batch.keys.assign(key_set.begin(), key_set.end());
+    batch.parameters.clear();
+    for (const auto& [key, values] : int_sets) batch.parameters[key] = std::vector<int>(values.begin(), values.end());
+    for (const auto& [key, values] : double_sets) batch.parameters[key] = std::vector<double>(values.begin(), values.end());
+    for (const auto& [key, values] : string_sets) batch.parameters[key] = std::vector<std::string>(values.begin(), values.end());
+    batch.sortResults();
+}
+
+bool JsonSaxLoader::is_segment_log(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Error opening file: " + filename);
+    }
+    static const std::string marker = "{\"aq_batch_segment\"";
+    std::string prefix(marker.size(), '\0');
+    file.read(&prefix[0], prefix.size());
+    return file.gcount() == static_cast<std::streamsize>(marker.size()) && prefix == marker;
+}
+
+void JsonSaxLoader::apply_batch_segment(Handler& handler, AdaptiveGaussTreeBatch& batch, bool first) {
+    const json& header = handler.header;
+
+    // Metadata and root tables come from the first segment of a log
+    if (first) {
+        batch.name = header_string(header, "name");
+        batch.reference = header_string(header, "reference");
+        batch.description = header_string(header, "description");
+        batch.author = header_string(header, "author");
+        batch.version = header_string(header, "version");
+        batch.tol = header.at("tol").get<double>();
+        batch.min_depth = header.at("min_depth").get<int>();
+        batch.max_depth = header.at("max_depth").get<int>();
+        batch.order1 = header.at("n1").get<int>();
+        batch.order2 = header.at("n2").get<int>();
+        batch.hp.max_order = header.value("hp_max_order", 0);
+        batch.hp.smoothness = header.value("hp_smoothness", HpRefinement().smoothness);
+        batch.detect.enabled = header.contains("detect_levels");
+        batch.detect.levels = header.value("detect_levels", SingularityDetection().levels);
+        batch.detect.max_spread = header.value("detect_max_spread", SingularityDetection().max_spread);
+        batch.detect.min_alpha = header.value("detect_min_alpha", SingularityDetection().min_alpha);
+        batch.detect.extrapolate = header.value("extrapolate", false);
+        batch.summation = Summation::from_string(header.value("summation", "naive"));
+        batch.a_singular = header.at("a_singular").get<bool>();
+        batch.b_singular = header.at("b_singular").get<bool>();
+        if (header.contains("lower") && header.contains("upper")) {   // infinite intervals only
+            batch.lower = IntervalMap::bound_from_json(header["lower"]);
+            batch.upper = IntervalMap::bound_from_json(header["upper"]);
+        }
+
+        // Load weights for quadrature (only present when saved with write_roots = true)
+        auto load_roots = [&](const std::string& key, const std::string& method, int order) {
+            auto it = handler.roots.find(key);
+            if (it == handler.roots.end() || it->second.size() != 2) return WeightsLoader();
+            return WeightsLoader(method, order, std::move(it->second[0]), std::move(it->second[1]));
+        };
+        batch.legendre_n1 = load_roots("legendre_roots_n1", "Legendre", batch.order1);
+        batch.legendre_n2 = load_roots("legendre_roots_n2", "Legendre", batch.order2);
+        batch.laguerre_n1 = load_roots("laguerre_roots_n1", "Laguerre", batch.order1);
+        batch.laguerre_n2 = load_roots("laguerre_roots_n2", "Laguerre", batch.order2);
+    }
+
+    // Load update log.  A segment only carries the entries its batch had not written to the log before, so they are
+    // all new.
+    if (!handler.has_update_log) {
+        throw std::runtime_error("Invalid format for update_log: Expected an array of objects.");
+    }
+    batch.update_log.insert(batch.update_log.end(), std::make_move_iterator(handler.update_log.begin()),
+                            std::make_move_iterator(handler.update_log.end()));
+
+    // Wrap the parsed roots in trees sharing the batch header
+    for (auto& [param_map, node] : handler.trees) {
+        std::unique_ptr<AdaptiveGaussTree> tree(new AdaptiveGaussTree(
+            batch.func, batch.legendre_n1, batch.legendre_n2, batch.laguerre_n1, batch.laguerre_n2, param_map));
+        tree->name = batch.name;
+        tree->reference = batch.reference;
+        tree->description = batch.description;
+        tree->author = batch.author;
+        tree->version = batch.version;
+        tree->tolerance = batch.tol;
+        tree->min_depth = batch.min_depth;
+        tree->max_depth = batch.max_depth;
+        tree->order1 = batch.order1;
+        tree->order2 = batch.order2;
+        tree->hp = batch.hp;
+        tree->detect = batch.detect;
+        tree->summation = batch.summation;
+        tree->a_singular = batch.a_singular;
+        tree->b_singular = batch.b_singular;
+        tree->root = std::move(node);
+        tree->best_effort = handler.best_effort.count(param_map) != 0;
+        tree->map = IntervalMap::from_header(header, tree->root->lower, tree->root->upper);
+        Handler::assign_orders(tree->root.get(), batch.order1, batch.order2);
+
+        batch.quad_coll[param_map] = std::move(tree);   // last writer wins
+    }
+}
@@ -1,37 +1,60 @@
 #include <laguerre_quadrature.hpp>
 #include <cmath>
+#include <summation.hpp>
 
 // Constructor: Lower limit = 0, upper limit = infinity, with weight function flag
 LaguerreQuadrature::LaguerreQuadrature(const WeightsLoader& loader, int n1, int n2, bool use_weight_function)
     : Quadrature(loader, n1, n2, 0.0, std::nullopt, "Gauss-Laguerre"), use_weight_function(use_weight_function) {}
 
-// Transform variable for Laguerre quadrature (maps nodes directly to [0,∞))
+// Shifted and scaled: [origin, ∞) or (-∞, origin]
+LaguerreQuadrature::LaguerreQuadrature(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2,
+                                       double origin, double scale, bool use_weight_function)
+    : Quadrature(loader1, loader2, n1, n2, scale > 0 ? std::optional<double>(origin) : std::nullopt,
+                 scale > 0 ? std::nullopt : std::optional<double>(origin), "Gauss-Laguerre"),
+      use_weight_function(use_weight_function), origin(origin), scale(scale) {
+    if (!(scale != 0.0 && std::isfinite(scale) && std::isfinite(origin))) {
+        throw std::invalid_argument("Gauss-Laguerre needs a finite origin and a finite, nonzero scale.");
+    }
+}
+
+// Transform variable for Laguerre quadrature (maps nodes directly to [0,∞) by default)
 double LaguerreQuadrature::transformVariable(double t) const {
-    return t;  // No transformation needed for Laguerre quadrature
+    return origin + scale * t;
 }
 
 // Perform integration using two orders for error estimation
 double LaguerreQuadrature::integrate( std::function<double(ParamMap, double)> func, ParamMap parameters) {
 
-    double integral1 = 0.0, integral2 = 0.0;
+    Summation::Accumulator sum1(summation), sum2(summation);
+    double magnitude = 0.0;
 
     // Compute integral using order1
     for (size_t i = 0; i < nodes1.size(); ++i) {
         double t = transformVariable(nodes1[i]);
         double weight = use_weight_function ? laguerre_weight_function(t) : 1.0;
-        integral1 += weights1[i] * func(parameters, t) * weight;
+        double term = weights1[i] * func(parameters, t);
+        sum1.add_product(term, weight);
+        magnitude += std::abs(term * weight);
     }
 
     // Compute integral using order2
     for (size_t i = 0; i < nodes2.size(); ++i) {
         double t = transformVariable(nodes2[i]);
         double weight = use_weight_function ? laguerre_weight_function(t) : 1.0;
-        integral2 += weights2[i] * func(parameters, t) * weight;
+        sum2.add_product(weights2[i] * func(parameters, t), weight);
+    }
+
+    double integral1 = sum1.value(), integral2 = sum2.value();
+    if (!use_weight_function) {   // the Jacobian is part of the weight function otherwise
+        integral1 *= std::abs(scale);
+        integral2 *= std::abs(scale);
+        magnitude *= std::abs(scale);
     }
 
     // Store results
     result = integral1;
     error = std::abs(integral1 - integral2);  // Compute error estimation
+    roundoff = Summation::roundoff(magnitude);
 
     return result;
 }
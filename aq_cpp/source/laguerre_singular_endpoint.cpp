@@ -3,7 +3,11 @@
 
 //  Constructor: Passes lower & upper to `Quadrature`, sets singularity and alpha
 LaguerreSingularEndpoint::LaguerreSingularEndpoint(const WeightsLoader& loader, int n1, int n2, double lower, double upper, bool leftIsSingular, double alpha)
-    : LaguerreQuadrature(loader, n1, n2, true), leftIsSingular(leftIsSingular), alpha(alpha) {
+    : LaguerreSingularEndpoint(loader, loader, n1, n2, lower, upper, leftIsSingular, alpha) {}
+
+LaguerreSingularEndpoint::LaguerreSingularEndpoint(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2,
+                                                   double lower, double upper, bool leftIsSingular, double alpha)
+    : LaguerreQuadrature(loader1, loader2, n1, n2, 0.0, 1.0, true), leftIsSingular(leftIsSingular), alpha(alpha) {
 
     // Pass lower & upper to base Quadrature class
     this->lowerLimit = lower;
@@ -14,14 +18,19 @@ double LaguerreSingularEndpoint::transformVariable(double t) const {
     double a = leftIsSingular ? lowerLimit.value() : upperLimit.value();
     double b = leftIsSingular ? upperLimit.value() : lowerLimit.value();
     double z = std::exp(-t/(1-alpha));
-    return a*(1-z) + b * z; 
+    double x = a + (b - a) * z;
+    // Closer to a than its floating point resolution the node would land on the singularity (or beyond it): keep it 
+    // one step inside.  The weight is computed from the same x, so f(x) * w(x) stays consistent.
+    if ((x - a) * (b - a) <= 0) x = std::nextafter(a, b);
+    return x;
 }
 
 // weight function:
-//  w(x) = (t-a)
+//  w(x) = |b-a| ((x-a)/(b-a))^alpha / (1-alpha),  a the singular endpoint.  The ratio is positive on both sides,
+//  so a singular right endpoint with alpha != 0 does not take the power of a negative number.
 double LaguerreSingularEndpoint::laguerre_weight_function(double t) const {
     double a = leftIsSingular ? lowerLimit.value() : upperLimit.value();
     double b = leftIsSingular ? upperLimit.value() : lowerLimit.value(); 
     double sign = leftIsSingular ? 1.0 : -1.0;   
-    return sign*std::pow(t-a, alpha)*std::pow(b-a,1-alpha)/(1-alpha);  
+    return sign*(b-a)*std::pow((t-a)/(b-a), alpha)/(1-alpha);  
 }
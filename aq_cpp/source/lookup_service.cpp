@@ -0,0 +1,414 @@
+#include <lookup_service.hpp>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Message body under construction (see the protocol in lookup_service.hpp)
+class MessageWriter {
+public:
+    template <typename T>
+    void put(T value) { bytes.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    void put_string(const std::string& value) {
+        put(static_cast<std::uint32_t>(value.size()));
+        bytes += value;
+    }
+    std::string bytes;
+};
+
+// Reads a message body; running past its end is a malformed message
+class MessageReader {
+public:
+    explicit MessageReader(const std::string& bytes) : bytes(bytes) {}
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    std::string get_string() {
+        std::uint32_t length = get<std::uint32_t>();
+        return std::string(take(length), length);
+    }
+    bool done() const { return position == bytes.size(); }
+    std::size_t remaining() const { return bytes.size() - position; }
+
+private:
+    const std::string& bytes;
+    std::size_t position = 0;
+
+    const char* take(std::size_t count) {
+        if (count > bytes.size() - position) throw std::runtime_error("Malformed lookup message.");
+        const char* start = bytes.data() + position;
+        position += count;
+        return start;
+    }
+};
+
+enum ValueType : std::uint8_t { IntValue = 0, DoubleValue = 1, StringValue = 2 };
+
+#ifndef _WIN32
+
+bool read_exact(int fd, char* data, std::size_t count) {
+    while (count > 0) {
+        ssize_t got = ::recv(fd, data, count, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        count -= static_cast<std::size_t>(got);
+    }
+    return true;
+}
+
+bool write_all(int fd, const char* data, std::size_t count) {
+    while (count > 0) {
+        ssize_t sent = ::send(fd, data, count, MSG_NOSIGNAL);   // a client that went away must not raise SIGPIPE
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        data += sent;
+        count -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+// false at the end of the connection (or for a message over LookupProtocol::max_message)
+bool read_message(int fd, std::string& message) {
+    std::uint64_t length;
+    if (!read_exact(fd, reinterpret_cast<char*>(&length), sizeof(length)) || length > LookupProtocol::max_message) return false;
+    message.resize(length);
+    return read_exact(fd, &message[0], length);
+}
+
+bool write_message(int fd, const std::string& message) {
+    std::uint64_t length = message.size();
+    return write_all(fd, reinterpret_cast<const char*>(&length), sizeof(length)) && write_all(fd, message.data(), message.size());
+}
+
+sockaddr_un socket_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path \"" + path + "\" is empty or longer than " + std::to_string(sizeof(address.sun_path) - 1) + " bytes.");
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Connected stream socket, -1 if nobody listens on `path`
+int connect_socket(const std::string& path) {
+    sockaddr_un address = socket_address(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error(std::string("Cannot create a socket: ") + std::strerror(errno));
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        int reason = errno;
+        ::close(fd);
+        errno = reason;
+        return -1;
+    }
+    return fd;
+}
+
+#endif
+
+}  // namespace
+
+#ifndef _WIN32
+
+LookupServer::LookupServer(const std::string& socket_path, const std::vector<std::string>& filenames, double poll_interval)
+    : socket_path(socket_path), poll_interval(poll_interval) {
+    for (const std::string& filename : filenames) {
+        std::string name = std::filesystem::path(filename).stem().string();
+        if (table_map.count(name)) {
+            throw std::runtime_error("Two batch files are named \"" + name + "\": " + table_map[name]->filename + ", " + filename);
+        }
+        auto table = std::make_unique<Table>();
+        table->filename = filename;
+        table->modified = std::filesystem::last_write_time(filename);   // before the load: a write during it is seen
+        table->size = std::filesystem::file_size(filename);
+        table->slot.publish(AdaptiveGaussTreeBatch(nullptr, filename));
+        table_map[name] = std::move(table);
+    }
+
+    int running = connect_socket(socket_path);
+    if (running >= 0) {
+        ::close(running);
+        throw std::runtime_error("A server already answers on " + socket_path + ".");
+    }
+    if (std::filesystem::exists(socket_path)) {
+        if (!std::filesystem::is_socket(socket_path)) throw std::runtime_error(socket_path + " exists and is not a socket.");
+        std::filesystem::remove(socket_path);   // left behind by a server that did not stop cleanly
+    }
+    sockaddr_un address = socket_address(socket_path);
+    listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(listen_fd, SOMAXCONN) != 0) {
+        std::string reason = std::strerror(errno);
+        if (listen_fd >= 0) ::close(listen_fd);
+        throw std::runtime_error("Cannot listen on " + socket_path + ": " + reason);
+    }
+    acceptor = std::thread(&LookupServer::accept_loop, this);
+    watcher = std::thread(&LookupServer::watch_loop, this);
+}
+
+LookupServer::~LookupServer() {
+    stop();
+}
+
+void LookupServer::stop() {
+    if (stopping.exchange(true)) return;
+    ::shutdown(listen_fd, SHUT_RDWR);   // wakes accept()
+    acceptor.join();
+    ::close(listen_fd);
+    std::filesystem::remove(socket_path);
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+    }
+    watch_wakeup.notify_all();
+    watcher.join();
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        for (auto& [fd, thread] : connections) {
+            if (fd >= 0) ::shutdown(fd, SHUT_RDWR);   // wakes the recv() of the connection thread
+        }
+    }
+    // the acceptor is gone, so the list only changes by threads closing their fd (under the lock)
+    for (auto& entry : connections) entry.second.join();
+    connections.clear();
+}
+
+std::vector<std::pair<std::string, std::size_t>> LookupServer::tables() const {
+    std::vector<std::pair<std::string, std::size_t>> list;
+    for (const auto& [name, table] : table_map) list.emplace_back(name, table->slot.get()->size());
+    return list;
+}
+
+void LookupServer::accept_loop() {
+    while (!stopping) {
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (!stopping) std::cerr << "aq lookup server: accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        // threads of closed connections (fd = -1) are done or about to return
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (it->first < 0) {
+                it->second.join();
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        connections.emplace_back(fd, std::thread(&LookupServer::serve, this, fd));
+    }
+}
+
+void LookupServer::serve(int fd) {
+    std::string request;
+    Readers readers;
+    while (read_message(fd, request)) {
+        if (!write_message(fd, answer(request, readers))) break;
+    }
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    for (auto& entry : connections) {
+        if (entry.first == fd) {
+            ::close(fd);
+            entry.first = -1;
+        }
+    }
+}
+
+std::string LookupServer::answer(const std::string& request, Readers& readers) const {
+    MessageWriter response;
+    try {
+        MessageReader reader(request);
+        auto op = reader.get<std::uint8_t>();
+        if (op == LookupProtocol::Tables) {
+            auto list = tables();
+            response.put(static_cast<std::uint8_t>(LookupProtocol::Ok));
+            response.put(static_cast<std::uint32_t>(list.size()));
+            for (const auto& [name, trees] : list) {
+                response.put_string(name);
+                response.put(static_cast<std::uint64_t>(trees));
+            }
+            return response.bytes;
+        }
+        if (op != LookupProtocol::Lookup) throw std::runtime_error("Unknown lookup request " + std::to_string(op) + ".");
+
+        std::string name = reader.get_string();
+        auto table = table_map.find(name);
+        if (table == table_map.end()) throw std::runtime_error("No table \"" + name + "\" on this server.");
+        const Table* source = table->second.get();
+        const BatchSnapshot* snapshot = readers.try_emplace(source, source->slot).first->second.get().get();   // one table for the whole request
+
+        std::vector<std::string> keys(reader.get<std::uint32_t>());
+        for (auto& key : keys) key = reader.get_string();
+        auto count = reader.get<std::uint32_t>();
+        // count comes from the client: it must be backed by the values in the message (at least a type byte and a
+        // u32 or 8 bytes each), and the answer must fit in a message, before anything is allocated or looped over
+        constexpr std::uint64_t min_value_bytes = 1 + sizeof(std::uint32_t);
+        if (count > 0 && (keys.empty() || std::uint64_t(count) * keys.size() * min_value_bytes > reader.remaining())) {
+            throw std::runtime_error("Malformed lookup message: " + std::to_string(count) + " combinations of "
+                                     + std::to_string(keys.size()) + " keys announced, " + std::to_string(reader.remaining()) + " bytes left.");
+        }
+        if (1 + 2 * sizeof(double) * std::uint64_t(count) > LookupProtocol::max_message) {
+            throw std::runtime_error("Lookup of " + std::to_string(count) + " combinations exceeds the message size limit.");
+        }
+        MessageWriter values;
+        values.put(static_cast<std::uint8_t>(LookupProtocol::Ok));
+        values.bytes.reserve(1 + 2 * sizeof(double) * count);
+        ParamMap param_map;   // reused, so that the keys are allocated once
+        for (std::uint32_t i = 0; i < count; ++i) {
+            for (const auto& key : keys) {
+                auto type = reader.get<std::uint8_t>();
+                if (type == IntValue) param_map[key] = static_cast<int>(reader.get<std::int64_t>());
+                else if (type == DoubleValue) param_map[key] = reader.get<double>();
+                else if (type == StringValue) param_map[key] = reader.get_string();
+                else throw std::runtime_error("Unknown value type of \"" + key + "\".");
+            }
+            const std::pair<double, double>* entry = snapshot->find(param_map);
+            const double missing = std::numeric_limits<double>::quiet_NaN();
+            values.put(entry ? entry->first : missing);
+            values.put(entry ? entry->second : missing);
+        }
+        if (!reader.done()) throw std::runtime_error("Malformed lookup message.");
+        return values.bytes;
+    } catch (const std::exception& e) {
+        MessageWriter error;
+        error.put(static_cast<std::uint8_t>(LookupProtocol::Error));
+        error.put_string(e.what());
+        return error.bytes;
+    }
+}
+
+void LookupServer::watch_loop() {
+    std::unique_lock<std::mutex> lock(watch_mutex);
+    while (!watch_wakeup.wait_for(lock, std::chrono::duration<double>(poll_interval), [this] { return stopping.load(); })) {
+        for (auto& [name, table] : table_map) {
+            std::error_code error;
+            auto modified = std::filesystem::last_write_time(table->filename, error);
+            if (error) continue;   // replaced by rename right now, or removed: keep serving the last snapshot
+            auto size = std::filesystem::file_size(table->filename, error);
+            bool changed = modified != table->modified || size != table->size;
+            if (error || (!changed && !table->failed)) continue;
+            try {
+                table->slot.publish(AdaptiveGaussTreeBatch(nullptr, table->filename));
+                table->failed = false;
+                ++reload_count;
+            } catch (const std::exception& e) {
+                // retried at every poll: a writer may finish the file without changing its time or size again
+                if (changed || !table->failed) {
+                    std::cerr << "aq lookup server: keeping the last \"" << name << "\", reload failed: " << e.what() << std::endl;
+                }
+                table->failed = true;
+            }
+            table->modified = modified;
+            table->size = size;
+        }
+    }
+}
+
+LookupClient::LookupClient(const std::string& socket_path) {
+    fd = connect_socket(socket_path);
+    if (fd < 0) throw std::runtime_error("No lookup server answers on " + socket_path + ": " + std::strerror(errno));
+}
+
+LookupClient::~LookupClient() {
+    if (fd >= 0) ::close(fd);
+}
+
+std::string LookupClient::exchange(const std::string& request) {
+    std::string response;
+    if (!write_message(fd, request) || !read_message(fd, response)) {
+        throw std::runtime_error("The lookup server closed the connection.");
+    }
+    MessageReader reader(response);
+    if (reader.get<std::uint8_t>() != LookupProtocol::Ok) throw std::runtime_error(reader.get_string());
+    return response;
+}
+
+#else
+
+LookupServer::LookupServer(const std::string&, const std::vector<std::string>&, double) {
+    throw std::runtime_error("The lookup server needs Unix domain sockets, which this build does not have.");
+}
+LookupServer::~LookupServer() = default;
+void LookupServer::stop() {}
+std::vector<std::pair<std::string, std::size_t>> LookupServer::tables() const { return {}; }
+
+LookupClient::LookupClient(const std::string&) {
+    throw std::runtime_error("The lookup client needs Unix domain sockets, which this build does not have.");
+}
+LookupClient::~LookupClient() = default;
+std::string LookupClient::exchange(const std::string&) { return {}; }
+
+#endif
+
+std::vector<std::pair<double, double>> LookupClient::lookup(const std::string& table, const std::vector<ParamMap>& combinations) {
+    if (combinations.empty()) return {};
+    std::set<std::string> keys;   // sorted, so the order does not depend on the hashing of ParamMap
+    for (const auto& entry : combinations.front()) keys.insert(entry.first);
+
+    MessageWriter request;
+    request.put(static_cast<std::uint8_t>(LookupProtocol::Lookup));
+    request.put_string(table);
+    request.put(static_cast<std::uint32_t>(keys.size()));
+    for (const auto& key : keys) request.put_string(key);
+    request.put(static_cast<std::uint32_t>(combinations.size()));
+    for (const ParamMap& combination : combinations) {
+        for (const auto& key : keys) {
+            auto value = combination.find(key);
+            if (value == combination.end() || combination.size() != keys.size()) {
+                std::ostringstream message;
+                message << "Lookup combination " << combination << " does not have the keys of the first.";
+                throw std::runtime_error(message.str());
+            }
+            auto type = static_cast<std::uint8_t>(value->second.index());
+            request.put(type);
+            if (type == IntValue) request.put(static_cast<std::int64_t>(std::get<int>(value->second)));
+            else if (type == DoubleValue) request.put(std::get<double>(value->second));
+            else request.put_string(std::get<std::string>(value->second));
+        }
+    }
+
+    std::string response = exchange(request.bytes);
+    MessageReader reader(response);
+    reader.get<std::uint8_t>();
+    std::vector<std::pair<double, double>> results(combinations.size());
+    for (auto& [integral, error] : results) {
+        integral = reader.get<double>();
+        error = reader.get<double>();
+    }
+    return results;
+}
+
+std::pair<double, double> LookupClient::lookup(const std::string& table, const ParamMap& combination) {
+    return lookup(table, std::vector<ParamMap>{combination}).front();
+}
+
+std::vector<std::pair<std::string, std::size_t>> LookupClient::tables() {
+    MessageWriter request;
+    request.put(static_cast<std::uint8_t>(LookupProtocol::Tables));
+    std::string response = exchange(request.bytes);
+    MessageReader reader(response);
+    reader.get<std::uint8_t>();
+    std::vector<std::pair<std::string, std::size_t>> list(reader.get<std::uint32_t>());
+    for (auto& [name, trees] : list) {
+        name = reader.get_string();
+        trees = reader.get<std::uint64_t>();
+    }
+    return list;
+}
@@ -16,3 +16,17 @@ double  polylog_wrapper( ParamMap parameters,  double t) {
     double result =  polylog_integrand(s, z, t);
     return result;
 }
+
+std::function<void(const ParamMap&, double, std::vector<double>&)> polylog_components(std::vector<int> s_values) {
+    std::vector<double> gammas;
+    for (int s : s_values) gammas.push_back(std::tgamma(s));
+    return [s_values, gammas](const ParamMap& parameters, double t, std::vector<double>& out) {
+        double z = std::get<double>(parameters.at("z"));
+        double log_t = std::log(t);
+        double denominator = 1.0 - t * z;
+        for (std::size_t k = 0; k < s_values.size(); ++k) {
+            int sgn = (s_values[k] % 2 == 0) ? -1 : 1;
+            out[k] = sgn * z * std::pow(log_t, s_values[k] - 1) / (gammas[k] * denominator);
+        }
+    };
+}
@@ -1,19 +1,33 @@
 #include <quadrature.hpp>
+#include <algorithm>
+#include <cmath>
+#include <summation.hpp>
 
-// Constructor: Allows infinite limits using std::nullopt
-Quadrature::Quadrature(const WeightsLoader& loader, int n1, int n2, std::optional<double> lower, std::optional<double> upper, std::string methodName)
-    : weightsLoader(loader), order1(n1), order2(n2), result(0.0), error(0.0), lowerLimit(lower), upperLimit(upper), method(methodName) {
+std::function<double(ParamMap, double)> single_point(PointsIntegrand f) {
+    return [f](ParamMap p, double x) {
+        std::vector<double> value(1);
+        f(p, {x}, value);
+        return value[0];
+    };
+}
 
-    if (!weightsLoader.hasOrder(order1) || !weightsLoader.hasOrder(order2)) {
+// Both orders must exist before either rule is fetched from its loader
+static std::shared_ptr<const QuadratureRule> checked_rule(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2, bool second) {
+    if (!loader1.hasOrder(n1) || !loader2.hasOrder(n2)) {
         throw std::invalid_argument("Requested quadrature orders not found in WeightsLoader.");
     }
+    return second ? loader2.getRule(n2) : loader1.getRule(n1);
+}
 
-    nodes1 = weightsLoader.getNodes(order1);
-    weights1 = weightsLoader.getWeights(order1);
+// Constructor: Allows infinite limits using std::nullopt
+Quadrature::Quadrature(const WeightsLoader& loader, int n1, int n2, std::optional<double> lower, std::optional<double> upper, std::string methodName)
+    : Quadrature(loader, loader, n1, n2, lower, upper, methodName) {}
 
-    nodes2 = weightsLoader.getNodes(order2);
-    weights2 = weightsLoader.getWeights(order2);
-}
+Quadrature::Quadrature(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2,
+                       std::optional<double> lower, std::optional<double> upper, std::string methodName)
+    : weightsLoader(loader1), order1(n1), order2(n2), result(0.0), error(0.0), lowerLimit(lower), upperLimit(upper), method(methodName),
+      rule1(checked_rule(loader1, loader2, n1, n2, false)), rule2(checked_rule(loader1, loader2, n1, n2, true)),
+      nodes1(rule1->nodes), weights1(rule1->weights), nodes2(rule2->nodes), weights2(rule2->weights) {}
 
 // Default transformation: Handles finite limits only
 double Quadrature::transformVariable(double t) const {
@@ -25,6 +39,91 @@ double Quadrature::transformVariable(double t) const {
     throw std::logic_error("transformVariable() must be overridden for infinite limits.");
 }
 
+// Default weight: half the length of a finite interval (the [-1,1] rules)
+double Quadrature::point_weight(double) const {
+    if (lowerLimit.has_value() && upperLimit.has_value()) {
+        return (upperLimit.value() - lowerLimit.value()) / 2.0;
+    }
+    throw std::logic_error("point_weight() must be overridden for infinite limits.");
+}
+
+double Quadrature::abscissa(const QuadratureRule& rule, std::size_t i) const {
+    if (rule.complements.empty()) return transformVariable(rule.nodes[i]);
+    double lower = lowerLimit.value(), upper = upperLimit.value();
+    double half_length = (upper - lower) / 2.0;
+    double x = rule.nodes[i] < 0 ? lower + half_length * rule.complements[i] : upper - half_length * rule.complements[i];
+    if (x <= lower) return std::nextafter(lower, upper);   // closer to the end than its resolution
+    if (x >= upper) return std::nextafter(upper, lower);
+    return x;
+}
+
+double Quadrature::integrate_components(const VectorIntegrand& func, const ParamMap& parameters, std::size_t width) {
+    std::vector<double> values(width);
+    std::vector<Summation::Accumulator> sum1(width, Summation::Accumulator(summation)), sum2 = sum1;
+    std::vector<double> magnitude(width, 0.0);
+    for (size_t i = 0; i < nodes1.size(); ++i) {
+        double x = abscissa(*rule1, i);
+        func(parameters, x, values);
+        double w = weights1[i] * point_weight(x);
+        for (std::size_t k = 0; k < width; ++k) {
+            sum1[k].add_product(w, values[k]);
+            magnitude[k] += std::abs(w * values[k]);
+        }
+    }
+    for (size_t i = 0; i < nodes2.size(); ++i) {
+        double x = abscissa(*rule2, i);
+        func(parameters, x, values);
+        double w = weights2[i] * point_weight(x);
+        for (std::size_t k = 0; k < width; ++k) sum2[k].add_product(w, values[k]);
+    }
+    component_results.resize(width);
+    component_errors.resize(width);
+    component_roundoffs.resize(width);
+    error = 0.0;
+    for (std::size_t k = 0; k < width; ++k) {
+        component_results[k] = sum1[k].value();
+        component_errors[k] = std::abs(component_results[k] - sum2[k].value());
+        component_roundoffs[k] = Summation::roundoff(magnitude[k]);
+        error = std::max(error, component_errors[k]);
+    }
+    result = width ? component_results[0] : 0.0;
+    roundoff = width ? component_roundoffs[0] : 0.0;
+    return error;
+}
+
+double Quadrature::integrate_points(const PointsIntegrand& func, const ParamMap& parameters) {
+    std::vector<double> x, w, x2, w2;
+    rule_points(false, x, w);
+    rule_points(true, x2, w2);
+    const std::size_t n = x.size();
+    x.insert(x.end(), x2.begin(), x2.end());
+    std::vector<double> values(x.size());
+    func(parameters, x, values);
+    Summation::Accumulator sum1(summation), sum2(summation);
+    double magnitude = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum1.add_product(w[i], values[i]);
+        magnitude += std::abs(w[i] * values[i]);
+    }
+    for (std::size_t i = 0; i < w2.size(); ++i) sum2.add_product(w2[i], values[n + i]);
+    result = sum1.value();
+    error = std::abs(result - sum2.value());
+    roundoff = Summation::roundoff(magnitude);
+    return result;
+}
+
+void Quadrature::rule_points(bool second, std::vector<double>& x, std::vector<double>& w) const {
+    const QuadratureRule& rule = second ? *rule2 : *rule1;
+    const std::vector<double>& nodes = rule.nodes;
+    const std::vector<double>& weights = rule.weights;
+    x.resize(nodes.size());
+    w.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        x[i] = abscissa(rule, i);
+        w[i] = weights[i] * point_weight(x[i]);
+    }
+}
+
 //overload to print ParamType
 std::ostream& operator<<(std::ostream& os, const ParamType& param) {
     std::visit([&os](auto&& value) {
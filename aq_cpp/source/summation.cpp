@@ -0,0 +1,18 @@
+#include <summation.hpp>
+#include <stdexcept>
+
+std::string Summation::to_string(Method method) {
+    switch (method) {
+        case Method::Neumaier: return "neumaier";
+        case Method::Pairwise: return "pairwise";
+        case Method::DoubleDouble: return "double-double";
+        default: return "naive";
+    }
+}
+
+Summation::Method Summation::from_string(const std::string& name) {
+    for (Method method : {Method::Naive, Method::Neumaier, Method::Pairwise, Method::DoubleDouble}) {
+        if (to_string(method) == name) return method;
+    }
+    throw std::runtime_error("Unknown summation method: " + name + " (naive, neumaier, pairwise, double-double)");
+}
@@ -0,0 +1,121 @@
+#include <tanh_sinh_quadrature.hpp>
+#include <cmath>
+#include <stdexcept>
+#include <summation.hpp>
+
+namespace {
+    const double pi = std::acos(-1.0);
+    const double min_complement = 1e-300;   // last points: beyond, the distance to the end underflows
+
+    // Point t > 0 of the level with step h:  x = 1 - complement, weight including h
+    void tanh_sinh_point(double t, double h, double& complement, double& weight) {
+        double e = std::exp(-pi * std::sinh(t));   // exp(-2 u), u = pi/2 sinh t
+        complement = 2.0 * e / (1.0 + e);
+        weight = h * pi / 2 * std::cosh(t) * 4.0 * e / ((1.0 + e) * (1.0 + e));
+    }
+}
+
+WeightsLoader TanhSinhQuadrature::rules(int max_level) {
+    std::map<int, QuadratureRule> levels;
+    std::vector<double> t = {0.0};   // abscissas in t, in storage order: those of the previous level first
+    for (int level = 0; level <= max_level; ++level) {
+        const double h = std::ldexp(1.0, -level);
+        for (long j = 1; ; j += level == 0 ? 1 : 2) {   // level 0: all steps, then the midpoints only
+            double complement, weight;
+            tanh_sinh_point(j * h, h, complement, weight);
+            if (complement < min_complement) break;
+            t.push_back(j * h);
+            t.push_back(-j * h);
+        }
+        QuadratureRule rule;
+        for (double ti : t) {
+            double complement = 1.0, weight = h * pi / 2;
+            if (ti != 0.0) tanh_sinh_point(std::abs(ti), h, complement, weight);
+            rule.nodes.push_back(ti < 0 ? complement - 1.0 : 1.0 - complement);
+            rule.weights.push_back(weight);
+            rule.complements.push_back(complement);
+        }
+        levels[level] = std::move(rule);
+    }
+    return WeightsLoader(method_name, std::move(levels));
+}
+
+TanhSinhQuadrature::TanhSinhQuadrature(const WeightsLoader& loader, int n1, int n2, double lower, double upper)
+    : TanhSinhQuadrature(loader, loader, n1, n2, lower, upper) {}
+
+TanhSinhQuadrature::TanhSinhQuadrature(const WeightsLoader& loader1, const WeightsLoader& loader2, int n1, int n2, double lower, double upper)
+    : Quadrature(loader1, loader2, n1, n2, lower, upper, method_name) {
+    if (rule1->complements.empty() || rule2->complements.empty()) {
+        throw std::invalid_argument("TanhSinhQuadrature needs the rules of TanhSinhQuadrature::rules().");
+    }
+}
+
+// The coarser level is the leading part of the finer one: every point is evaluated once for both sums
+double TanhSinhQuadrature::integrate(std::function<double(ParamMap, double)> func, ParamMap parameters) {
+    const QuadratureRule& fine = nodes2.size() >= nodes1.size() ? *rule2 : *rule1;
+    Summation::Accumulator sum1(summation), sum2(summation);
+    double magnitude = 0.0;
+    for (std::size_t i = 0; i < fine.nodes.size(); ++i) {
+        double f = func(parameters, abscissa(fine, i));
+        if (i < weights1.size()) {
+            sum1.add_product(weights1[i], f);
+            magnitude += std::abs(weights1[i] * f);
+        }
+        if (i < weights2.size()) sum2.add_product(weights2[i], f);
+    }
+    double half_length = (upperLimit.value() - lowerLimit.value()) / 2.0;
+    result = sum1.value() * half_length;
+    error = std::abs(result - sum2.value() * half_length);
+    roundoff = Summation::roundoff(magnitude * half_length);
+    return result;
+}
+
+double TanhSinhQuadrature::integrate_points(const PointsIntegrand& func, const ParamMap& parameters) {
+    const QuadratureRule& fine = nodes2.size() >= nodes1.size() ? *rule2 : *rule1;
+    std::vector<double> x(fine.nodes.size()), values(fine.nodes.size());
+    for (std::size_t i = 0; i < x.size(); ++i) x[i] = abscissa(fine, i);
+    func(parameters, x, values);
+    Summation::Accumulator sum1(summation), sum2(summation);
+    double magnitude = 0.0;
+    for (std::size_t i = 0; i < weights1.size(); ++i) {
+        sum1.add_product(weights1[i], values[i]);
+        magnitude += std::abs(weights1[i] * values[i]);
+    }
+    for (std::size_t i = 0; i < weights2.size(); ++i) sum2.add_product(weights2[i], values[i]);
+    double half_length = (upperLimit.value() - lowerLimit.value()) / 2.0;
+    result = sum1.value() * half_length;
+    error = std::abs(result - sum2.value() * half_length);
+    roundoff = Summation::roundoff(magnitude * half_length);
+    return result;
+}
+
+double TanhSinhQuadrature::integrate_components(const VectorIntegrand& func, const ParamMap& parameters, std::size_t width) {
+    const QuadratureRule& fine = nodes2.size() >= nodes1.size() ? *rule2 : *rule1;
+    std::vector<double> values(width);
+    std::vector<Summation::Accumulator> sum1(width, Summation::Accumulator(summation)), sum2 = sum1;
+    std::vector<double> magnitude(width, 0.0);
+    for (std::size_t i = 0; i < fine.nodes.size(); ++i) {
+        func(parameters, abscissa(fine, i), values);
+        for (std::size_t k = 0; k < width; ++k) {
+            if (i < weights1.size()) {
+                sum1[k].add_product(weights1[i], values[k]);
+                magnitude[k] += std::abs(weights1[i] * values[k]);
+            }
+            if (i < weights2.size()) sum2[k].add_product(weights2[i], values[k]);
+        }
+    }
+    double half_length = (upperLimit.value() - lowerLimit.value()) / 2.0;
+    component_results.resize(width);
+    component_errors.resize(width);
+    component_roundoffs.resize(width);
+    error = 0.0;
+    for (std::size_t k = 0; k < width; ++k) {
+        component_results[k] = sum1[k].value() * half_length;
+        component_errors[k] = std::abs(component_results[k] - sum2[k].value() * half_length);
+        component_roundoffs[k] = Summation::roundoff(magnitude[k] * half_length);
+        error = std::max(error, component_errors[k]);
+    }
+    result = width ? component_results[0] : 0.0;
+    roundoff = width ? component_roundoffs[0] : 0.0;
+    return error;
+}
@@ -0,0 +1,135 @@
+#include <trace.hpp>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+std::atomic<bool> Trace::active{false};
+std::atomic<bool> Trace::levels{false};
+
+namespace {
+    struct TraceEvent {
+        std::string name;
+        const char* category;
+        double start_us, duration_us;
+        json args;
+    };
+
+    // One per thread that ever recorded; owned jointly by the thread and the registry so that events of threads
+    // that exited before stop() are still written
+    struct ThreadBuffer {
+        int tid = 0;
+        std::string thread_name;
+        std::vector<TraceEvent> events;
+    };
+
+    std::mutex registry_mutex;   // guards the lists below, never taken while recording an event
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    json imported = json::array();
+    std::string trace_file;
+
+    thread_local std::shared_ptr<ThreadBuffer> local_buffer;
+
+    ThreadBuffer& thread_buffer() {
+        if (!local_buffer) {
+            local_buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            local_buffer->tid = static_cast<int>(buffers.size()) + 1;
+            local_buffer->thread_name = "thread " + std::to_string(local_buffer->tid);
+            buffers.push_back(local_buffer);
+        }
+        return *local_buffer;
+    }
+
+    int process_id() {
+#ifndef _WIN32
+        return static_cast<int>(getpid());
+#else
+        return 0;
+#endif
+    }
+}
+
+void Trace::start(const std::string& filename, bool depth_levels) {
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (auto& buffer : buffers) buffer->events.clear();
+        imported = json::array();
+        trace_file = filename;
+    }
+    levels.store(depth_levels);
+    active.store(true);
+}
+
+void Trace::stop() {
+    active.store(false);
+    levels.store(false);
+    const int pid = process_id();
+    json events = json::array();
+    events.push_back({{"name", "process_name"}, {"ph", "M"}, {"pid", pid}, {"tid", 0}, {"args", {{"name", "aq " + std::to_string(pid)}}}});
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& buffer : buffers) {
+        if (buffer->events.empty()) continue;
+        events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", buffer->tid}, {"args", {{"name", buffer->thread_name}}}});
+        for (auto& event : buffer->events) {
+            json entry = {{"name", std::move(event.name)}, {"cat", event.category}, {"ph", "X"}, {"pid", pid}, {"tid", buffer->tid},
+                          {"ts", event.start_us}, {"dur", event.duration_us}};
+            if (!event.args.is_null()) entry["args"] = std::move(event.args);
+            events.push_back(std::move(entry));
+        }
+        buffer->events.clear();
+    }
+    for (auto& event : imported) events.push_back(std::move(event));
+    imported = json::array();
+
+    std::ofstream file(trace_file);
+    if (!file) {
+        throw std::runtime_error("Error opening trace file: " + trace_file);
+    }
+    file << json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump();
+}
+
+void Trace::set_thread_name(const std::string& name) {
+    ThreadBuffer& buffer = thread_buffer();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffer.thread_name = name;
+}
+
+void Trace::import_file(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Error opening trace file: " + filename);
+    }
+    json data = json::parse(file);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& event : data["traceEvents"]) imported.push_back(std::move(event));
+}
+
+// The steady clock's own epoch (boot time on Linux) is shared by all processes, so traces of the aq_driver workers
+// line up with the coordinator's after import_file
+double Trace::now_us() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(std::string name, const char* category, double start_us, double duration_us, json args) {
+    thread_buffer().events.push_back({std::move(name), category, start_us, duration_us, std::move(args)});
+}
+
+Trace::Span::Span(std::string name, const char* category)
+    : recording(Trace::enabled()), name(std::move(name)), category(category) {
+    if (recording) start_us = Trace::now_us();
+}
+
+Trace::Span::~Span() {
+    if (recording && Trace::enabled()) {
+        double stop_us = Trace::now_us();
+        Trace::record(std::move(name), category, start_us, stop_us - start_us, std::move(args));
+    }
+}
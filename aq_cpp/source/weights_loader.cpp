@@ -1,53 +1,202 @@
 #include <weights_loader.hpp>
+#include <json_sax_loader.hpp>
+#include <filesystem>
 
-WeightsLoader::WeightsLoader(const std::string& filename) {
-    std::ifstream file(filename);
+// --- RuleIndex ---------------------------------------------------------------------------------------------
+
+// One pass over the raw bytes: track nesting and strings, remember the two header scalars and the byte range
+// of every object under "n".  Nothing is converted to double here.
+RuleIndex::RuleIndex(const std::string& filename) : filename(filename) {
+    std::ifstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         throw std::runtime_error("Error opening JSON file: " + filename);
     }
+    modified = std::filesystem::last_write_time(filename);
+    size = std::filesystem::file_size(filename);
+
+    int depth = 0;
+    bool in_string = false, escape = false, in_n = false;
+    std::string token, key1, key2, raw;
+    bool capture = false;                       // collecting the value of "method" / "n_max"
+    std::streamoff order_begin = 0;
+
+    auto finish_capture = [&]() {
+        if (!capture) return;
+        capture = false;
+        json value = json::parse(raw);
+        if (key1 == "method") method = value.get<std::string>();
+        if (key1 == "n_max") n_max = value.get<int>();
+    };
+
+    std::vector<char> buffer(1 << 16);
+    std::streamoff base = 0;
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        std::streamsize count = file.gcount();
+        for (std::streamsize i = 0; i < count; ++i) {
+            char c = buffer[i];
+            if (in_string) {
+                if (escape) {
+                    escape = false;
+                } else if (c == '\\') {
+                    escape = true;
+                } else if (c == '"') {
+                    in_string = false;
+                    if (capture) raw = "\"" + token + "\"";
+                    continue;
+                }
+                if (depth <= 2) token += c;
+                continue;
+            }
+            switch (c) {
+                case '"':
+                    in_string = true;
+                    token.clear();
+                    break;
+                case '{':
+                case '[':
+                    if (c == '{' && depth == 1 && key1 == "n") in_n = true;
+                    if (c == '{' && depth == 2 && in_n) order_begin = base + i;
+                    ++depth;
+                    break;
+                case '}':
+                case ']':
+                    if (depth == 1) finish_capture();
+                    --depth;
+                    if (c == '}' && depth == 2 && in_n) {
+                        offsets[std::stoi(key2)] = {order_begin, static_cast<std::size_t>(base + i + 1 - order_begin)};
+                    }
+                    if (depth == 1) in_n = false;
+                    break;
+                case ':':
+                    if (depth == 1) {
+                        key1 = token;
+                        if (key1 == "method" || key1 == "n_max") {
+                            capture = true;
+                            raw.clear();
+                        }
+                    } else if (depth == 2 && in_n) {
+                        key2 = token;
+                    }
+                    break;
+                case ',':
+                    if (depth == 1) finish_capture();
+                    break;
+                default:
+                    if (capture && depth == 1 && !std::isspace(static_cast<unsigned char>(c))) raw += c;
+            }
+        }
+        base += count;
+    }
+    if (offsets.empty()) {
+        throw std::runtime_error("No quadrature orders found in JSON file: " + filename);
+    }
+}
+
+namespace {
+std::mutex registry_mutex;
+std::unordered_map<std::string, std::weak_ptr<RuleIndex>> registry;   // path@mtime -> index, while any loader holds it
+}  // namespace
 
-    json j;
-    file >> j;
-    file.close();
+std::shared_ptr<RuleIndex> RuleIndex::open(const std::string& filename) {
+    std::string key = filename;
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(filename, ec);
+    if (!ec) key = canonical.string();
+    auto stamp = std::filesystem::last_write_time(filename, ec);
+    if (!ec) key += "@" + std::to_string(stamp.time_since_epoch().count());   // a rewritten file is re-indexed
 
-    // Load method and n_max
-    method = j["method"].get<std::string>();
-    n_max = j["n_max"].get<int>();  // Load n_max from JSON
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    // drop indexes nobody holds any more (closed or rewritten files), so long-lived processes that reload do not pile them up
+    for (auto it = registry.begin(); it != registry.end();) it = it->second.expired() ? registry.erase(it) : std::next(it);
+    if (auto existing = registry[key].lock()) return existing;
+    auto index = std::make_shared<RuleIndex>(filename);
+    registry[key] = index;
+    return index;
+}
+
+std::size_t RuleIndex::registered() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry.size();
+}
+
+std::shared_ptr<const QuadratureRule> RuleIndex::getRule(int n) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = decoded.find(n);
+    if (cached != decoded.end()) return cached->second;
 
-    // Load nodes and weights for each order
-    for (const auto& [key, value] : j["n"].items()) {
-        int order = std::stoi(key);
-        nodes[order] = value["0"].get<std::vector<double>>();
-        weights[order] = value["1"].get<std::vector<double>>();
+    auto it = offsets.find(n);
+    if (it == offsets.end()) {
+        throw std::out_of_range("Order not found in JSON data: " + std::to_string(n));
+    }
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening JSON file: " + filename);
     }
+    // the offsets would point into other content
+    std::error_code ec;
+    auto now_modified = std::filesystem::last_write_time(filename, ec);
+    if (ec || now_modified != modified || std::filesystem::file_size(filename, ec) != size || ec) {
+        throw std::runtime_error("JSON file " + filename + " was rewritten after it was indexed; open it again to read order "
+                                 + std::to_string(n) + ".");
+    }
+    std::string text(it->second.second, '\0');
+    file.seekg(it->second.first);
+    file.read(&text[0], text.size());
+
+    json value = json::parse(text);
+    auto rule = std::make_shared<QuadratureRule>();
+    rule->nodes = value["0"].get<std::vector<double>>();
+    rule->weights = value["1"].get<std::vector<double>>();
+    decoded[n] = rule;
+    return rule;
+}
+
+std::size_t RuleIndex::decodedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return decoded.size();
 }
 
+// --- WeightsLoader -----------------------------------------------------------------------------------------
 
-WeightsLoader::WeightsLoader(json js, const std::string& key, const std::string& method, const std::string& n_key){ 
+WeightsLoader::WeightsLoader(const std::string& filename) : index(RuleIndex::open(filename)) {
+    method = index->getMethod();
+    n_max = index->getNMax();
+}
+
+
+WeightsLoader::WeightsLoader(json js, const std::string& key, const std::string& method, const std::string& n_key){
     this->method = method;
     this->n_max = js[n_key].get<int>();
 
     // Extract the values
     std::vector<std::vector<double>> values = js[key].get<std::vector<std::vector<double>>>();
-    nodes[this->n_max] = values[0];
-    weights[this->n_max] = values[1];
+    rules[this->n_max] = std::make_shared<const QuadratureRule>(QuadratureRule{values[0], values[1], {}});
+}
+
+WeightsLoader::WeightsLoader(const std::string& method, int n, std::vector<double> nodes, std::vector<double> weights)
+    : method(method), n_max(n) {
+    rules[n] = std::make_shared<const QuadratureRule>(QuadratureRule{std::move(nodes), std::move(weights), {}});
+}
+
+WeightsLoader::WeightsLoader(const std::string& method, std::map<int, QuadratureRule> computed)
+    : method(method), n_max(computed.empty() ? 0 : computed.rbegin()->first) {
+    for (auto& [n, rule] : computed) rules[n] = std::make_shared<const QuadratureRule>(std::move(rule));
 }
 
+std::shared_ptr<const QuadratureRule> WeightsLoader::getRule(int n) const {
+    auto it = rules.find(n);
+    if (it != rules.end()) return it->second;
+    if (index) return index->getRule(n);
+    throw std::out_of_range("Order not found in JSON data: " + std::to_string(n));
+}
 
 std::vector<double> WeightsLoader::getNodes(int n) const {
-    if (nodes.find(n) != nodes.end()) {
-        return nodes.at(n);
-    } else {
-        throw std::out_of_range("Order not found in JSON data: " + std::to_string(n));
-    }
+    return getRule(n)->nodes;
 }
 
 std::vector<double> WeightsLoader::getWeights(int n) const {
-    if (weights.find(n) != weights.end()) {
-        return weights.at(n);
-    } else {
-        throw std::out_of_range("Order not found in JSON data: " + std::to_string(n));
-    }
+    return getRule(n)->weights;
 }
 
 std::string WeightsLoader::getMethod() const {
@@ -59,5 +208,5 @@ int WeightsLoader::getNMax() const {
 }
 
 bool WeightsLoader::hasOrder(int n) const {
-    return nodes.find(n) != nodes.end() && weights.find(n) != weights.end();
+    return rules.count(n) != 0 || (index && index->hasOrder(n));
 }
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include "adaptive_cubature_2d.hpp"
+#include "adaptive_gauss_tree.hpp"
+
+int main() {
+    try {
+        WeightsLoader legendre("../model_json/legendre.json");
+        WeightsLoader laguerre("../model_json/laguerre.json");
+        double tol = 1e-10;
+        int n1 = 10, n2 = 15, minD = 1, maxD = 30;
+
+        // smooth: 1 / (1 + x + y) on [0, 1]^2 = 3 ln 3 - 4 ln 2
+        long calls = 0;
+        Integrand2D smooth = [&calls](const ParamMap&, double x, double y) { ++calls; return 1.0 / (1.0 + x + y); };
+        AdaptiveCubature2D cubature(smooth, 0.0, 1.0, 0.0, 1.0, tol, minD, maxD, n1, n2, {},
+                                    legendre, legendre, laguerre, laguerre);
+        double exact = 3 * std::log(3.0) - 4 * std::log(2.0);
+        auto [integral, error] = cubature.get_integral_and_error();
+        std::cout << std::setprecision(16) << "1/(1+x+y): " << integral << " (exact " << exact << "), error " << error
+                  << ", " << cubature.node_count() << " rectangles, " << calls << " calls" << std::endl;
+        if (std::abs(integral - exact) > tol) {
+            std::cout << "smooth cubature failed" << std::endl;
+            return 1;
+        }
+
+        // the same integral by nesting 1D trees at the usual orders 100/150: an inner tree in y at every outer abscissa x
+        long nested_calls = 0;
+        std::function<double(ParamMap, double)> outer = [&](ParamMap, double x) {
+            std::function<double(ParamMap, double)> inner = [&nested_calls, x](ParamMap, double y) { ++nested_calls; return 1.0 / (1.0 + x + y); };
+            AdaptiveGaussTree tree(inner, 0.0, 1.0, tol, minD, maxD, 100, 150, 0.0, 0.0, false, false, legendre, legendre, laguerre, laguerre);
+            return tree.get_integral_and_error().first;
+        };
+        AdaptiveGaussTree nested(outer, 0.0, 1.0, tol, minD, maxD, 100, 150, 0.0, 0.0, false, false, legendre, legendre, laguerre, laguerre);
+        std::cout << "nested 1D trees: " << nested.get_integral_and_error().first << ", " << nested_calls << " calls" << std::endl;
+        if (calls * 100 > nested_calls) {
+            std::cout << "cubature is not cheaper than nested trees" << std::endl;
+            return 1;
+        }
+
+        // singular edge: exp(-x - y) / sqrt(x) = sqrt(pi) erf(1) (1 - 1/e)
+        Integrand2D singular = [](const ParamMap&, double x, double y) { return std::exp(-x - y) / std::sqrt(x); };
+        SingularEdges edges;
+        edges.x_lower = {true, 0.5};
+        AdaptiveCubature2D edge(singular, 0.0, 1.0, 0.0, 1.0, tol, minD, maxD, n1, n2, edges,
+                                legendre, legendre, laguerre, laguerre, {}, "Project", "Author", "singular edge x = 0");
+        exact = std::sqrt(M_PI) * std::erf(1.0) * (1 - std::exp(-1.0));
+        std::tie(integral, error) = edge.get_integral_and_error();
+        std::cout << "exp(-x-y)/sqrt(x): " << integral << " (exact " << exact << "), error " << error << ", "
+                  << edge.node_count() << " rectangles" << std::endl;
+        if (std::abs(integral - exact) > tol) {
+            std::cout << "singular edge failed" << std::endl;
+            return 1;
+        }
+
+        // anisotropic: only x needs refinement, so the splits are along x
+        Integrand2D steep = [](const ParamMap& p, double x, double y) { return std::exp(std::get<double>(p.at("k")) * x) * (1 + y); };
+        exact = (std::exp(30.0) - 1) / 30.0 * 1.5;
+        AdaptiveCubature2D anisotropic(steep, 0.0, 1.0, 0.0, 1.0, tol * exact, minD, maxD, n1, n2, {},
+                                       legendre, legendre, laguerre, laguerre, {{"k", 30.0}});
+        std::tie(integral, error) = anisotropic.get_integral_and_error();
+        std::cout << "exp(30x)(1+y): relative error " << std::abs(integral - exact) / exact << ", " << anisotropic.node_count() << " rectangles" << std::endl;
+        if (std::abs(integral - exact) > tol * exact) {
+            std::cout << "anisotropic cubature failed" << std::endl;
+            return 1;
+        }
+
+        // JSON round trip
+        edge.add_update_log("round trip");
+        edge.save_to_json("cubature_output.json", true, false, true);
+        AdaptiveCubature2D loaded(singular, legendre, legendre, laguerre, laguerre, "cubature_output.json");
+        loaded.print_update_log();
+        AdaptiveCubature2D copied = loaded;
+        if (loaded.get_integral_and_error() != edge.get_integral_and_error() || loaded.node_count() != edge.node_count()
+            || copied.get_integral_and_error() != edge.get_integral_and_error()) {
+            std::cout << "cubature changed in the round trip" << std::endl;
+            return 1;
+        }
+        std::cout << "round trip ok" << std::endl;
+
+        // compensated summation below the round-off level: the leaves that stay above tol are reported and saved
+        AdaptiveCubature2D tight(steep, 0.0, 1.0, 0.0, 1.0, 1e-17 * exact, minD, 8, n1, n2, {},
+                                 legendre, legendre, laguerre, laguerre, {{"k", 30.0}}, "Project", "Author", "project description",
+                                 "references", "1.0", "Initial Train", Summation::Method::Neumaier);
+        tight.save_to_json("cubature_output.json", true);
+        AdaptiveCubature2D tight_loaded(steep, legendre, legendre, laguerre, laguerre, "cubature_output.json", {{"k", 30.0}});
+        std::cout << "exp(30x)(1+y) at relative tol 1e-17, neumaier: " << tight.node_count() << " rectangles, "
+                  << tight.roundoff_limited_leaves() << " round-off leaves" << std::endl;
+        if (tight.roundoff_limited_leaves() == 0 || tight_loaded.roundoff_limited_leaves() != tight.roundoff_limited_leaves()
+            || tight_loaded.get_integral_and_error() != tight.get_integral_and_error()) {
+            std::cout << "round-off limited leaves not reported" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -9,6 +9,10 @@
 #include "adaptive_gauss_batch.hpp"
 #include <typeinfo>
 #include <chrono>
+#include <map>
+#include <set>
+#include <limits>
+#include "trace.hpp"
 
 int main() {
     std::function<double(ParamMap, double)> func = polylog_wrapper;
@@ -94,5 +98,345 @@ int main() {
     std::cout << "check batch_from_file to verify deep copy "  <<std::endl;
     batch_plus_equals_results.printCollection(); 
 
+//  Compact (leaf-only) files: size and load time against the verbose layout
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test compact save "  <<std::endl;
+    AdaptiveGaussTreeBatch polylogs = AdaptiveGaussTreeBatch(func, "../model_json/polylogs.json");
+    polylogs.save_to_json("polylogs_full.json", true, false, false);
+    polylogs.save_to_json("polylogs_compact.json", true, false, false, true);
+    std::cout << "verbose: " << std::filesystem::file_size("polylogs_full.json") << " bytes, compact: "
+              << std::filesystem::file_size("polylogs_compact.json") << " bytes" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    AdaptiveGaussTreeBatch polylogs_full = AdaptiveGaussTreeBatch(func, "polylogs_full.json");
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "verbose load: " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << " us" << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    AdaptiveGaussTreeBatch polylogs_compact = AdaptiveGaussTreeBatch(func, "polylogs_compact.json");
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "compact load: " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << " us" << std::endl;
+
+    for (const auto& [key, tree] : polylogs_full.getCollection()) {
+        auto [integral, error] = tree->get_integral_and_error();
+        auto [integral_c, error_c] = polylogs_compact.getCollection().at(key)->get_integral_and_error();
+        if (integral != integral_c || error != error_c) {
+            std::cout << "compact mismatch for " << key << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "compact reload matches for all " << polylogs_compact.getCollection().size() << " trees" << std::endl;
+
+//  Append-only log: the positive z batch, then the negative z batch, then the positive one again (replaces its trees)
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test append_to_log "  <<std::endl;
+    std::filesystem::remove("batch_log.jsonl");
+    batch.append_to_log("batch_log.jsonl", "positive z");
+    batch_for_merge.append_to_log("batch_log.jsonl", "negative z");
+    batch.append_to_log("batch_log.jsonl", "positive z again");
+    {
+        std::ofstream torn("batch_log.jsonl", std::ios::app);
+        torn << "{\"aq_batch_segment\":1,\"name\":";     // interrupted write, must be ignored
+    }
+    AdaptiveGaussTreeBatch from_log = AdaptiveGaussTreeBatch(func, "batch_log.jsonl");
+    from_log.printCollection();
+    if (from_log.getCollection().size() != batch.getCollection().size() + batch_for_merge.getCollection().size()) {
+        std::cout << "log reload has the wrong number of trees" << std::endl;
+        return 1;
+    }
+    // every entry once, in the order written, even two appends with the same message in the same second
+    if (from_log.get_update_log().size() != batch.get_update_log().size() + batch_for_merge.get_update_log().size()
+        || from_log.get_update_log().back() != batch.get_update_log().back()) {
+        std::cout << "log reload has the wrong update log" << std::endl;
+        return 1;
+    }
+
+    std::cout << "log size: " << std::filesystem::file_size("batch_log.jsonl") << " bytes" << std::endl;
+    AdaptiveGaussTreeBatch::compact_log("batch_log.jsonl");
+    std::cout << "compacted log size: " << std::filesystem::file_size("batch_log.jsonl") << " bytes" << std::endl;
+    AdaptiveGaussTreeBatch compacted = AdaptiveGaussTreeBatch(func, "batch_log.jsonl");
+    for (const auto& [key, tree] : from_log.getCollection()) {
+        if (tree->get_integral_and_error() != compacted.getCollection().at(key)->get_integral_and_error()) {
+            std::cout << "compacted log mismatch for " << key << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "compacted log matches for all " << compacted.getCollection().size() << " trees" << std::endl;
+    compacted.append_to_log("batch_log.jsonl", "same second");
+    compacted.append_to_log("batch_log.jsonl", "same second");
+    if (AdaptiveGaussTreeBatch(func, "batch_log.jsonl").get_update_log() != compacted.get_update_log()) {
+        std::cout << "appended update log entries lost or repeated" << std::endl;
+        return 1;
+    }
+
+//  Parameters that agree to six decimals are still distinct trees in files and logs; compaction keeps the roots
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test full-precision parameter keys "  <<std::endl;
+    auto exponential = [](ParamMap p, double x) { return std::exp(-std::get<double>(p.at("c")) * x); };
+    ParamCollection close_rates = {{"c", std::vector<double>{0.1234567, 0.1234568, 2.5}}};
+    AdaptiveGaussTreeBatch close_batch(exponential, lower, upper, 1e-13, 0, 30, 3, 5, 0.0, 0.0, false, false,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, close_rates);
+    close_batch.save_to_json("test_close.json", true, false, false);
+    std::filesystem::remove("test_close.jsonl");
+    close_batch.append_to_log("test_close.jsonl", "with roots", true);
+    close_batch.append_to_log("test_close.jsonl", "again");
+    AdaptiveGaussTreeBatch::compact_log("test_close.jsonl");
+    std::ifstream compacted_close("test_close.jsonl");
+    json close_segment = json::parse(compacted_close);
+    for (const std::string file : {"test_close.json", "test_close.jsonl"}) {
+        AdaptiveGaussTreeBatch close_loaded(exponential, file);
+        if (close_loaded.getCollection().size() != 3) {
+            std::cout << file << ": " << close_loaded.getCollection().size() << " of 3 trees" << std::endl;
+            return 1;
+        }
+        for (const auto& [key, tree] : close_batch.getCollection()) {
+            if (close_loaded.getCollection().at(key)->get_integral_and_error() != tree->get_integral_and_error()) {
+                std::cout << file << " differs for " << key << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (!close_segment.contains("legendre_roots_n1") || !close_segment.contains("laguerre_roots_n2")) {
+        std::cout << "compact_log dropped the root tables" << std::endl;
+        return 1;
+    }
+    std::cout << "3 trees with c = 0.1234567, 0.1234568, 2.5 reload from the file and the compacted log (with roots)" << std::endl;
+
+//  Move merge and k-way merge of files
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test merge_files "  <<std::endl;
+    batch_for_merge.save_to_json("test_negative_z.json", true, false, false, true);
+    polylogs.save_to_json("test_polylogs.json", true, false, false, true);
+    start = std::chrono::high_resolution_clock::now();
+    AdaptiveGaussTreeBatch copied = AdaptiveGaussTreeBatch(func, "test.json");
+    copied += AdaptiveGaussTreeBatch(func, "test_negative_z.json");     // rvalue: trees are moved, not copied
+    AdaptiveGaussTreeBatch copied_polylogs = AdaptiveGaussTreeBatch(func, "test_polylogs.json");
+    copied.merge(copied_polylogs);                                      // lvalue: deep copy
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "sequential load + merge: " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << " us" << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    AdaptiveGaussTreeBatch merged = AdaptiveGaussTreeBatch::merge_files(func, {"test.json", "test_negative_z.json", "test_polylogs.json"}, 3);
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "merge_files (3 threads): " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << " us" << std::endl;
+    std::cout << "merged trees: " << merged.getCollection().size() << std::endl;
+    if (merged.getCollection().size() != copied.getCollection().size()) {
+        std::cout << "merge_files and sequential merge disagree" << std::endl;
+        return 1;
+    }
+    for (const auto& [key, tree] : copied.getCollection()) {
+        if (tree->get_integral_and_error() != merged.getCollection().at(key)->get_integral_and_error()) {
+            std::cout << "merge_files mismatch for " << key << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "merge_files matches the sequential merge" << std::endl;
+
+//  Batch over an explicit list of combinations (one shard of a grid)
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test explicit combinations "  <<std::endl;
+    std::vector<ParamMap> grid = AdaptiveGaussTreeBatch::expand_grid(params);
+    std::vector<ParamMap> shard(grid.begin(), grid.begin() + grid.size() / 3);
+    AdaptiveGaussTreeBatch shard_batch = AdaptiveGaussTreeBatch(
+        func, lower,  upper, tol,  minD,  maxD,  n1,  n2,
+         alphaA,  alphaB, singularA,  singularB,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2,
+        shard
+    );
+    shard_batch.printCollection();
+    for (const auto& [key, tree] : shard_batch.getCollection()) {
+        if (tree->get_integral_and_error() != batch.getCollection().at(key)->get_integral_and_error()) {
+            std::cout << "shard batch mismatch for " << key << std::endl;
+            return 1;
+        }
+    }
+    std::cout << shard_batch.getCollection().size() << " of " << grid.size() << " combinations match the full batch" << std::endl;
+
+//  Checkpoint and resume: the first build "crashes" part way through, the second continues from the checkpoint
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test checkpoint and resume "  <<std::endl;
+    ParamCollection params3;
+    params3["s"] = std::vector<int>{2, 3};
+    params3["z"] = std::vector<double>{0.5, 0.99, 1.0};
+    long evaluations = 0, crash_after = -1;
+    std::function<double(ParamMap, double)> counted = [&](ParamMap p, double t) {
+        if (crash_after >= 0 && evaluations >= crash_after) throw std::runtime_error("simulated crash");
+        ++evaluations;
+        return polylog_wrapper(p, t);
+    };
+    AdaptiveGaussTreeBatch reference_batch = AdaptiveGaussTreeBatch(
+        counted, lower, upper, 1e-14, minD, maxD, n1, n2, alphaA, alphaB, singularA, singularB,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, params3);
+    long full_evaluations = evaluations;
+    if (TreeStats::enabled && reference_batch.total_stats().evaluations != static_cast<size_t>(full_evaluations)) {
+        std::cout << "build statistics miss evaluations" << std::endl;
+        return 1;
+    }
+    for (const auto& [key, stats] : reference_batch.get_stats()) std::cout << key << " " << stats.to_json().dump() << std::endl;
+    reference_batch.save_to_json("test_stats.json", true, false, false, false, true);
+    if (AdaptiveGaussTreeBatch(counted, "test_stats.json").getCollection().size() != reference_batch.getCollection().size()) {
+        std::cout << "batch with statistics did not load" << std::endl;
+        return 1;
+    }
+
+    BatchCheckpoint checkpoint{"test_checkpoint.json", 0.0};   // interval 0: save the frontier after every node
+    std::filesystem::remove(checkpoint.filename);
+    std::filesystem::remove(checkpoint.filename + ".log");
+    evaluations = 0;
+    crash_after = full_evaluations * 7 / 10;                      // part way through the fifth tree
+    try {
+        AdaptiveGaussTreeBatch crashed = AdaptiveGaussTreeBatch(
+            counted, lower, upper, 1e-14, minD, maxD, n1, n2, alphaA, alphaB, singularA, singularB,
+            legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, params3,
+            name, author, description, reference, version, update_log_message, checkpoint);
+        std::cout << "expected the build to be interrupted" << std::endl;
+        return 1;
+    } catch (const std::runtime_error& e) {
+        std::cout << "interrupted after " << evaluations << " of " << full_evaluations << " evaluations: " << e.what() << std::endl;
+    }
+    evaluations = 0;
+    crash_after = -1;
+    AdaptiveGaussTreeBatch resumed = AdaptiveGaussTreeBatch(counted, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, checkpoint);
+    std::cout << "resume needed " << evaluations << " more evaluations" << std::endl;
+    resumed.printCollection();
+    for (const auto& [key, tree] : reference_batch.getCollection()) {
+        if (tree->get_integral_and_error() != resumed.getCollection().at(key)->get_integral_and_error()) {
+            std::cout << "resumed build differs for " << key << std::endl;
+            return 1;
+        }
+    }
+    if (evaluations + full_evaluations * 7 / 10 > full_evaluations + n2 + n1) {   // at most the node being evaluated is lost
+        std::cout << "resume repeated finished work" << std::endl;
+        return 1;
+    }
+    std::cout << "resumed build matches the uninterrupted one" << std::endl;
+
+    // parameters that agree to six decimals: both finished trees come back from the log, only the last node is lost
+    std::function<double(ParamMap, double)> counted_exponential = [&](ParamMap p, double x) {
+        if (crash_after >= 0 && evaluations >= crash_after) throw std::runtime_error("simulated crash");
+        ++evaluations;
+        return std::exp(-std::get<double>(p.at("c")) * x);
+    };
+    evaluations = 0;
+    crash_after = -1;
+    AdaptiveGaussTreeBatch close_reference(counted_exponential, lower, upper, 1e-14, 0, 30, 3, 5, 0.0, 0.0, false, false,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, close_rates);
+    long close_evaluations = evaluations;
+    BatchCheckpoint close_checkpoint{"test_checkpoint_close.json", 0.0};
+    std::filesystem::remove(close_checkpoint.filename);
+    std::filesystem::remove(close_checkpoint.filename + ".log");
+    evaluations = 0;
+    crash_after = close_evaluations - 1;                          // in the last tree
+    try {
+        AdaptiveGaussTreeBatch crashed(counted_exponential, lower, upper, 1e-14, 0, 30, 3, 5, 0.0, 0.0, false, false,
+            legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, close_rates,
+            name, author, description, reference, version, update_log_message, close_checkpoint);
+        std::cout << "expected the build to be interrupted" << std::endl;
+        return 1;
+    } catch (const std::runtime_error&) {
+    }
+    evaluations = 0;
+    crash_after = -1;
+    AdaptiveGaussTreeBatch close_resumed(counted_exponential, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, close_checkpoint);
+    std::cout << "c = 0.1234567, 0.1234568, 2.5: resume needed " << evaluations << " of " << close_evaluations << " evaluations" << std::endl;
+    for (const auto& [key, tree] : close_reference.getCollection()) {
+        if (tree->get_integral_and_error() != close_resumed.getCollection().at(key)->get_integral_and_error()) {
+            std::cout << "resumed build differs for " << key << std::endl;
+            return 1;
+        }
+    }
+    if (evaluations > 3 + 5) {
+        std::cout << "resume repeated finished trees" << std::endl;
+        return 1;
+    }
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test trace export "  <<std::endl;
+    Trace::start("test_trace.json", true);
+    AdaptiveGaussTreeBatch traced = AdaptiveGaussTreeBatch(
+        func, lower, upper, 1e-12, minD, maxD, n1, n2, alphaA, alphaB, singularA, singularB,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, params3);
+    traced.save_to_json("test_trace_batch.json", true);
+    AdaptiveGaussTreeBatch::merge_files(func, {"test.json", "test_negative_z.json", "test_polylogs.json"}, 3);
+    Trace::stop();
+    std::ifstream trace_file("test_trace.json");
+    json trace = json::parse(trace_file);
+    std::map<std::string, int> span_counts;
+    std::set<int> threads;
+    for (const auto& event : trace["traceEvents"]) {
+        if (event["ph"] != "X") continue;
+        std::string span_name = event["name"];
+        ++span_counts[span_name];
+        threads.insert(event["tid"].get<int>());
+    }
+    for (const auto& [span_name, count] : span_counts) std::cout << span_name << ": " << count << std::endl;
+    std::cout << "threads with events: " << threads.size() << std::endl;
+    if (span_counts["tree/build"] != static_cast<int>(traced.getCollection().size()) || span_counts["depth 0"] != span_counts["tree/build"]
+        || span_counts["batch/combinations"] != 1 || span_counts["batch/build_trees"] != 1 || span_counts["batch/save"] != 1
+        || span_counts["batch/load"] != 3) {
+        std::cout << "unexpected trace events" << std::endl;
+        return 1;
+    }
+    std::cout << "trace written to test_trace.json (open in https://ui.perfetto.dev)" << std::endl;
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test semi-infinite interval "  <<std::endl;
+    auto decay = [](ParamMap p, double x) { return std::exp(-std::get<double>(p["c"]) * x); };
+    ParamCollection rates = {{"c", std::vector<double>{0.5, 1.0, 2.0}}};
+    BatchCheckpoint tail_checkpoint{"test_checkpoint_tail.json", 0.0};
+    std::filesystem::remove(tail_checkpoint.filename);
+    std::filesystem::remove(tail_checkpoint.filename + ".log");
+    AdaptiveGaussTreeBatch tail_batch(decay, 0.0, std::numeric_limits<double>::infinity(), 1e-12, 2, 30, 20, 40, 0.0, 0.0, false, false,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, rates, name, author, description, reference, version, update_log_message,
+        tail_checkpoint);
+    tail_batch.save_to_json("test_tail.json", true, false, false, true);
+    AdaptiveGaussTreeBatch tail_loaded(decay, "test_tail.json");
+    AdaptiveGaussTreeBatch tail_resumed(decay, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, tail_checkpoint);   // all trees in the log
+    for (const auto& [key, tree] : tail_batch.getCollection()) {
+        double c = std::get<double>(key.at("c"));
+        double integral = tree->get_integral_and_error().first;
+        std::cout << "c = " << c << ": " << integral << " (exact " << 1.0 / c << ")" << std::endl;
+        if (std::abs(integral - 1.0 / c) > 1e-12 || tail_loaded.getCollection().at(key)->get_interval().get_upper() != std::numeric_limits<double>::infinity()
+            || tail_loaded.getCollection().at(key)->get_integral_and_error() != tree->get_integral_and_error()
+            || tail_resumed.getCollection().at(key)->get_integral_and_error() != tree->get_integral_and_error()) {
+            std::cout << "semi-infinite batch failed" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout <<"\n\n\n\n\n\n"<< "Test vector-valued integrand "  <<std::endl;
+    long vector_evaluations = 0;
+    auto components = polylog_components(s);
+    VectorIntegrand counted_components = [&](const ParamMap& p, double t, std::vector<double>& out) {
+        ++vector_evaluations;
+        components(p, t, out);
+    };
+    start = std::chrono::high_resolution_clock::now();
+    AdaptiveGaussTreeBatch vector_batch(counted_components, "s", std::vector<ParamType>(s.begin(), s.end()),
+        lower, upper, tol, minD, maxD, n1, n2, alphaA, alphaB, singularA, singularB,
+        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, {{"z", z}});
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "Time to generate in milliseconds: \t" << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count()
+              << " ms, " << vector_evaluations << " vector evaluations" << std::endl;
+    if (TreeStats::enabled) {
+        std::cout << "scalar batch: " << batch.total_stats().evaluations << " evaluations" << std::endl;
+        if (static_cast<size_t>(vector_evaluations) >= batch.total_stats().evaluations) {
+            std::cout << "vector batch evaluates the integrand more often than the scalar batch" << std::endl;
+            return 1;
+        }
+    }
+    vector_batch.save_to_json("test_vector.json", true, false, false, true);
+    AdaptiveGaussTreeBatch vector_loaded(func, "test_vector.json");    // an ordinary batch over s and z
+    double worst = 0.0;
+    for (const auto& [key, tree] : batch.getCollection()) {
+        double integral = tree->get_integral_and_error().first;
+        worst = std::max(worst, std::abs(vector_batch.getCollection().at(key)->get_integral_and_error().first - integral));
+        if (vector_loaded.getCollection().at(key)->get_integral_and_error() != vector_batch.getCollection().at(key)->get_integral_and_error()) {
+            std::cout << "vector batch did not reload" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "largest difference to the scalar batch: " << worst << std::endl;
+    if (vector_batch.getCollection().size() != batch.getCollection().size() || worst > 1e-11) {
+        std::cout << "vector batch differs from the scalar batch" << std::endl;
+        return 1;
+    }
+
     return 0;
 }
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cmath>
+#include <limits>
+#include <iomanip>
 #include "adaptive_gauss_tree.hpp"
 #include "polylog_port.hpp"
 
@@ -10,6 +12,16 @@ double test_function(ParamMap params, double x) {
     return std::log(x) / std::sqrt(x);
 }
 
+// Verbose layout of a tree without the values of interior nodes, which the leaf-compact layout rebuilds as the sums
+// of their children: what a compact round trip has to keep (bounds, leaves, alpha, seed and pending flags)
+json leaf_structure(json node) {
+    if (node.is_null() || node["left"].is_null()) return node;
+    for (const char* key : {"integral", "error", "method", "alpha", "n1", "n2"}) node.erase(key);
+    node["left"] = leaf_structure(node["left"]);
+    node["right"] = leaf_structure(node["right"]);
+    return node;
+}
+
 int main() {
     try {
         // Load quadrature weights
@@ -42,6 +54,321 @@ int main() {
         std::cout << "Loaded Integral: " << integral2 << "\n";
         std::cout << "Loaded Estimated Error: " << error2 << "\n";        
 
+        // Leaf-only layout
+        adaptive_tree.save_to_json("adaptive_output_compact.json", true, false, true);
+        AdaptiveGaussTree compact_tree(test_function, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_compact.json");
+        auto [integral_c, error_c] = compact_tree.get_integral_and_error();
+        std::cout << "Loaded Integral (compact): " << integral_c << "\n";
+        std::cout << "Loaded Estimated Error (compact): " << error_c << "\n";
+
+        // build statistics
+        if (TreeStats::enabled) {
+            const TreeStats& stats = adaptive_tree.get_stats();
+            std::cout << "Build stats: " << stats.to_json().dump() << "\n";
+            size_t per_depth = 0;
+            for (size_t count : stats.nodes_per_depth) per_depth += count;
+            if (stats.nodes() != adaptive_tree.node_count() || per_depth != stats.nodes()
+                || stats.evaluations != stats.nodes() * (100 + 150) || AdaptiveGaussTree(adaptive_tree).get_stats().evaluations != stats.evaluations) {
+                std::cout << "inconsistent build statistics" << std::endl;
+                return 1;
+            }
+            adaptive_tree.save_to_json("adaptive_output_stats.json", true, false, false, true);
+            AdaptiveGaussTree stats_tree(test_function, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_stats.json");
+            std::cout << "Loaded Integral (with stats): " << stats_tree.get_integral_and_error().first << "\n";
+        }
+
+        // hp-adaptive refinement: a smooth integrand gets higher orders instead of more bisections
+        {
+            auto smooth = [](ParamMap, double x) { return std::cos(20.0 * x) * std::exp(-x); };
+            const double exact = (std::exp(-1.0) * (20.0 * std::sin(20.0) - std::cos(20.0)) + 1.0) / 401.0;
+            AdaptiveGaussTree h_tree(smooth, 0.0, 1.0, 1e-12, 0, 20, 10, 20, 0.0, 0.0, false, false,
+                                     legendre_n1, legendre_n2, laguerre_n1, laguerre_n2);
+            AdaptiveGaussTree hp_tree(smooth, 0.0, 1.0, 1e-12, 0, 20, 10, 20, 0.0, 0.0, false, false,
+                                      legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, {},
+                                      "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                      HpRefinement{80});
+            double h_error = std::abs(h_tree.get_integral_and_error().first - exact);
+            double hp_error = std::abs(hp_tree.get_integral_and_error().first - exact);
+            std::cout << "h:  " << h_tree.node_count() << " nodes, error " << h_error << "\n";
+            std::cout << "hp: " << hp_tree.node_count() << " nodes, error " << hp_error << "\n";
+            if (hp_error > 1e-12 || hp_tree.node_count() >= h_tree.node_count()) {
+                std::cout << "hp refinement did not pay off" << std::endl;
+                return 1;
+            }
+            if (TreeStats::enabled) {
+                std::cout << "hp stats: " << hp_tree.get_stats().to_json().dump() << "\n";
+                if (hp_tree.get_stats().order_raises == 0 || hp_tree.get_stats().evaluations >= h_tree.get_stats().evaluations) {
+                    std::cout << "hp refinement did not pay off" << std::endl;
+                    return 1;
+                }
+            }
+            // the per-node orders survive both layouts
+            for (bool compact : {false, true}) {
+                hp_tree.save_to_json("adaptive_output_hp.json", true, false, compact);
+                AdaptiveGaussTree hp_loaded(smooth, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_hp.json");
+                if (hp_loaded.get_tree_serialized(false, compact) != hp_tree.get_tree_serialized(false, compact) || hp_loaded.get_hp().max_order != 80) {
+                    std::cout << "hp tree changed in the round trip (compact = " << compact << ")" << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        // endpoint singularity detection: undeclared power singularities at either endpoint
+        {
+            auto left_power = [](ParamMap, double x) { return x == 0.0 ? 0.0 : 1.0 / std::sqrt(x) + std::cos(x); };
+            auto right_power = [](ParamMap, double x) { return x == 1.0 ? 0.0 : std::pow(1.0 - x, -0.3); };
+            const double left_exact = 2.0 + std::sin(1.0), right_exact = 1.0 / 0.7;
+            SingularityDetection detect;
+            detect.enabled = true;
+            for (bool lower_endpoint : {true, false}) {
+                auto f = lower_endpoint ? std::function<double(ParamMap, double)>(left_power) : std::function<double(ParamMap, double)>(right_power);
+                double exact = lower_endpoint ? left_exact : right_exact, expected_alpha = lower_endpoint ? 0.5 : 0.3;
+                AdaptiveGaussTree plain(f, 0.0, 1.0, 1e-10, 2, 30, 40, 100, 0.0, 0.0, false, false,
+                                        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2);
+                AdaptiveGaussTree detected(f, 0.0, 1.0, 1e-10, 2, 30, 40, 100, 0.0, 0.0, false, false,
+                                           legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, {},
+                                           "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                           {}, detect);
+                double plain_error = std::abs(plain.get_integral_and_error().first - exact);
+                double detected_error = std::abs(detected.get_integral_and_error().first - exact);
+                std::optional<double> alpha = detected.get_detected_alpha(lower_endpoint);
+                std::cout << (lower_endpoint ? "lower" : "upper") << " endpoint: " << plain.node_count() << " nodes, error "
+                          << plain_error << " undetected; " << detected.node_count() << " nodes, error " << detected_error
+                          << ", alpha " << (alpha ? *alpha : 0.0) << " detected\n";
+                if (!alpha || std::abs(*alpha - expected_alpha) > 0.05 || detected.get_detected_alpha(!lower_endpoint)
+                    || detected_error > 1e-10 || detected.node_count() >= plain.node_count()) {
+                    std::cout << "endpoint singularity not detected" << std::endl;
+                    return 1;
+                }
+            }
+            auto smooth = [](ParamMap, double x) { return std::cos(20.0 * x) * std::exp(-x); };
+            AdaptiveGaussTree smooth_tree(smooth, 0.0, 1.0, 1e-12, 2, 30, 10, 20, 0.0, 0.0, false, false,
+                                          legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, {},
+                                          "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                          {}, detect);
+            if (smooth_tree.get_detected_alpha(true) || smooth_tree.get_detected_alpha(false)) {
+                std::cout << "singularity detected in a smooth integrand" << std::endl;
+                return 1;
+            }
+        }
+
+        // interior breakpoints: a kink at 0.3 and an integrable singularity at 1/3 that no bisection reaches
+        {
+            const double pole = 1.0 / 3.0;
+            auto f = [pole](ParamMap, double x) { return x == pole ? 0.0 : std::abs(x - 0.3) + 1.0 / std::sqrt(std::abs(x - pole)); };
+            const double exact = (0.09 + 0.49) / 2 + 2.0 * std::sqrt(pole) + 2.0 * std::sqrt(1.0 - pole);
+            AdaptiveGaussTree plain(f, 0.0, 1.0, 1e-10, 2, 30, 40, 100, 0.0, 0.0, false, false,
+                                    legendre_n1, legendre_n2, laguerre_n1, laguerre_n2);
+            AdaptiveGaussTree split(f, 0.0, 1.0, 1e-10, 2, 30, 40, 100, 0.0, 0.0, false, false,
+                                    legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, {},
+                                    "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                    {}, {}, {{0.3}, {pole, true, 0.5}, {2.0}});
+            double plain_error = std::abs(plain.get_integral_and_error().first - exact);
+            double split_error = std::abs(split.get_integral_and_error().first - exact);
+            std::cout << "breakpoints: " << plain.node_count() << " nodes, error " << plain_error << " without; "
+                      << split.node_count() << " nodes, error " << split_error << " with\n";
+            if (split.get_breakpoints().size() != 2 || split_error > 1e-10 || split.node_count() >= plain.node_count()) {
+                std::cout << "breakpoints did not pay off" << std::endl;
+                return 1;
+            }
+            // the splits survive both layouts
+            for (bool compact : {false, true}) {
+                split.save_to_json("adaptive_output_breakpoints.json", true, false, compact);
+                AdaptiveGaussTree loaded(f, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_breakpoints.json");
+                if (loaded.get_tree_serialized(false, compact) != split.get_tree_serialized(false, compact)
+                    || leaf_structure(loaded.get_tree_serialized()) != leaf_structure(split.get_tree_serialized())
+                    || loaded.get_integral_and_error() != split.get_integral_and_error()) {
+                    std::cout << "split tree changed in the round trip (compact = " << compact << ")" << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        // singular endpoints of intervals other than [0, 1], and infinite intervals
+        {
+            const double inf = std::numeric_limits<double>::infinity();
+            struct Case { const char* name; std::function<double(ParamMap, double)> f; double lower, upper, exact, alphaA, alphaB; bool singularA, singularB; };
+            std::vector<Case> cases = {
+                {"(x-2)^-0.5 on [2, 5]", [](ParamMap, double x) { return 1.0 / std::sqrt(x - 2.0); }, 2.0, 5.0, 2.0 * std::sqrt(3.0), 0.5, 0.0, true, false},
+                {"(3-x)^-0.3 on [1, 3]", [](ParamMap, double x) { return std::pow(3.0 - x, -0.3); }, 1.0, 3.0, std::pow(2.0, 0.7) / 0.7, 0.0, 0.3, false, true},
+                {"exp(-x) on [1, inf)", [](ParamMap, double x) { return std::exp(-x); }, 1.0, inf, std::exp(-1.0), 0.0, 0.0, false, false},
+                {"1/(1+x^2) on [0, inf)", [](ParamMap, double x) { return 1.0 / (1.0 + x * x); }, 0.0, inf, M_PI / 2, 0.0, 0.0, false, false},
+                {"exp(x) on (-inf, 0]", [](ParamMap, double x) { return std::exp(x); }, -inf, 0.0, 1.0, 0.0, 0.0, false, false},
+                {"exp(-x^2) on (-inf, inf)", [](ParamMap, double x) { return std::exp(-x * x); }, -inf, inf, std::sqrt(M_PI), 0.0, 0.0, false, false},
+                {"x^-0.5 exp(-x) on [0, inf)", [](ParamMap, double x) { return std::exp(-x) / std::sqrt(x); }, 0.0, inf, std::sqrt(M_PI), 0.5, 0.0, true, false},
+            };
+            for (const Case& c : cases) {
+                AdaptiveGaussTree tree(c.f, c.lower, c.upper, 1e-10, 2, 30, 20, 40, c.alphaA, c.alphaB, c.singularA, c.singularB,
+                                       legendre_n1, legendre_n2, laguerre_n1, laguerre_n2);
+                double error = std::abs(tree.get_integral_and_error().first - c.exact);
+                std::cout << c.name << ": " << tree.node_count() << " nodes, error " << error << "\n";
+                if (error > 1e-10 || tree.node_count() > 25) {
+                    std::cout << "interval not handled" << std::endl;
+                    return 1;
+                }
+                // the interval survives both layouts
+                for (bool compact : {false, true}) {
+                    tree.save_to_json("adaptive_output_interval.json", true, false, compact);
+                    AdaptiveGaussTree loaded(c.f, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_interval.json");
+                    if (loaded.get_interval().get_lower() != c.lower || loaded.get_interval().get_upper() != c.upper
+                        || leaf_structure(loaded.get_tree_serialized()) != leaf_structure(tree.get_tree_serialized())
+                        || loaded.get_integral_and_error() != tree.get_integral_and_error()) {
+                        std::cout << "interval changed in the round trip (compact = " << compact << ")" << std::endl;
+                        return 1;
+                    }
+                }
+            }
+            try {
+                AdaptiveGaussTree invalid(cases[2].f, 1.0, inf, 1e-10, 2, 30, 20, 40, 0.0, 0.0, false, true,
+                                          legendre_n1, legendre_n2, laguerre_n1, laguerre_n2);
+                std::cout << "singular infinite endpoint accepted" << std::endl;
+                return 1;
+            } catch (const std::runtime_error&) {}
+        }
+
+        // a checkpointed frontier (pending leaves) of a tree with a singular endpoint and a breakpoint (seeds) in the
+        // compact layout: the build continues from it exactly as from the verbose one (the finished trees above check
+        // the leaf alphas)
+        {
+            auto f = [](ParamMap, double x) { return 1.0 / std::sqrt(x - 2.0) + std::abs(x - 3.5); };
+            json verbose_frontier, compact_frontier;
+            int checkpoints = 0;
+            auto capture = [&](const AdaptiveGaussTree& tree) {
+                if (++checkpoints != 3) return;
+                verbose_frontier = tree.get_tree_serialized();
+                compact_frontier = tree.get_tree_serialized(false, true);
+            };
+            auto build = [&](const json& partial, std::function<void(const AdaptiveGaussTree&)> hook) {
+                return AdaptiveGaussTree(f, 2.0, 5.0, 1e-10, 2, 30, 20, 40, 0.5, 0.0, true, false,
+                                         legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, {},
+                                         "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                         {}, {}, {{3.5}}, {}, TreeCheckpoint{partial, hook, 0.0, nullptr});
+            };
+            AdaptiveGaussTree full = build(nullptr, capture);
+            AdaptiveGaussTree from_verbose = build(verbose_frontier, nullptr);
+            AdaptiveGaussTree from_compact = build(compact_frontier, nullptr);
+            std::cout << "compact frontier: " << compact_frontier.dump().size() << " bytes, " << compact_frontier["leaf_pending"].size()
+                      << " pending leaves; continued build " << from_compact.get_integral_and_error().first << "\n";
+            if (!compact_frontier.contains("leaf_pending") || !compact_frontier.contains("leaf_seeds")
+                || leaf_structure(from_compact.get_tree_serialized()) != leaf_structure(from_verbose.get_tree_serialized())
+                || from_compact.get_integral_and_error() != full.get_integral_and_error()) {
+                std::cout << "compact frontier does not continue like the verbose one" << std::endl;
+                return 1;
+            }
+        }
+
+        // vector-valued integrand: x^k on [0, 2] for k = 0..3, one partition for all components
+        {
+            VectorIntegrand powers = [](const ParamMap&, double x, std::vector<double>& out) {
+                for (std::size_t k = 0; k < out.size(); ++k) out[k] = std::pow(x, k);
+            };
+            AdaptiveGaussTree vector_tree(powers, 4, 0.0, 2.0, 1e-12, 2, 30, 20, 40, 0.0, 0.0, false, false,
+                                          legendre_n1, legendre_n2, laguerre_n1, laguerre_n2);
+            for (std::size_t k = 0; k < vector_tree.component_count(); ++k) {
+                std::unique_ptr<AdaptiveGaussTree> component = vector_tree.component_tree(k);
+                double exact = std::pow(2.0, k + 1) / (k + 1);
+                std::cout << "x^" << k << " on [0, 2]: " << component->get_integral_and_error().first << " (exact " << exact << ")\n";
+                component->save_to_json("adaptive_output_interval.json", true, false, true);
+                std::function<double(ParamMap, double)> scalar = [k](ParamMap, double x) { return std::pow(x, k); };
+                AdaptiveGaussTree loaded(scalar, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_interval.json");
+                if (std::abs(component->get_integral_and_error().first - exact) > 1e-12
+                    || loaded.get_integral_and_error() != component->get_integral_and_error()) {
+                    std::cout << "vector-valued component " << k << " failed" << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        // compensated summation: exact where `+=` loses the small terms, and round-off no longer refines the tree
+        {
+            using Method = Summation::Method;
+            for (Method method : {Method::Naive, Method::Neumaier, Method::Pairwise, Method::DoubleDouble}) {
+                Summation::Accumulator sum(method);
+                sum.add(1.0);
+                for (int i = 0; i < 1000; ++i) sum.add(1e-17);
+                sum.add(-1.0);
+                std::cout << Summation::to_string(method) << ": 1 + 1000 * 1e-17 - 1 = " << sum.value() << "\n";
+                double allowed = method == Method::Naive ? 1.0 : method == Method::Pairwise ? 2e-15 : 1e-20;   // pairwise: O(log n) ulp
+                if (std::abs(sum.value() - 1e-14) > allowed) {
+                    std::cout << "summation lost the small terms" << std::endl;
+                    return 1;
+                }
+            }
+            ParamMap li3 = {{"s", 3}, {"z", 0.9}};
+            std::size_t evaluations[2];
+            double integrals[2];
+            for (Method method : {Method::Naive, Method::Neumaier}) {
+                AdaptiveGaussTree tree(polylog_wrapper, 0.0, 1.0, 1e-14, 2, 20, 100, 150, 0.0, 0.0, true, false,
+                                       legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, li3,
+                                       "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                       {}, {}, {}, method);
+                for (bool compact : {false, true}) {
+                    tree.save_to_json("adaptive_output_summation.json", true, false, compact);
+                    AdaptiveGaussTree loaded(polylog_wrapper, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_summation.json", li3);
+                    if (loaded.get_summation() != method || loaded.get_integral_and_error() != tree.get_integral_and_error()
+                        || loaded.roundoff_limited_leaves() != tree.roundoff_limited_leaves()) {
+                        std::cout << "summation method or round-off leaves not restored from the file" << std::endl;
+                        return 1;
+                    }
+                }
+                // round-off limited leaves are final with error >= tolerance: counted by the tree, not only by the stats
+                if ((method == Method::Naive) != (tree.roundoff_limited_leaves() == 0)
+                    || (TreeStats::enabled && tree.roundoff_limited_leaves() != tree.get_stats().roundoff_leaves)) {
+                    std::cout << "round-off limited leaves not reported" << std::endl;
+                    return 1;
+                }
+                int i = method == Method::Naive ? 0 : 1;
+                integrals[i] = tree.get_integral_and_error().first;
+                evaluations[i] = tree.get_stats().evaluations;
+                std::cout << "Li_3(0.9) at tol 1e-14, " << Summation::to_string(method) << ": " << std::setprecision(17) << integrals[i]
+                          << std::setprecision(6) << ", " << tree.node_count() << " nodes, depth " << tree.get_stats().depth_reached()
+                          << ", " << tree.get_stats().roundoff_leaves << " round-off leaves\n";
+            }
+            if (std::abs(integrals[1] - integrals[0]) > 1e-14 || (TreeStats::enabled && evaluations[1] * 10 > evaluations[0])) {
+                std::cout << "compensated summation did not save the refinement" << std::endl;
+                return 1;
+            }
+        }
+
+        // Wynn epsilon extrapolation along the endpoint chains: undeclared singularities at either endpoint
+        {
+            struct Case { const char* name; std::function<double(ParamMap, double)> f; double exact; };
+            std::vector<Case> cases = {
+                {"x^-0.9", [](ParamMap, double x) { return std::pow(x, -0.9); }, 10.0},
+                {"log(x)", [](ParamMap, double x) { return std::log(x); }, -1.0},
+                {"(1 - x)^-0.5", [](ParamMap, double x) { return 1.0 / std::sqrt(1.0 - x); }, 2.0}};
+            SingularityDetection extrapolate;
+            extrapolate.extrapolate = true;
+            for (const Case& c : cases) {
+                AdaptiveGaussTree plain(c.f, 0.0, 1.0, 1e-10, 1, 40, 10, 15, 0.0, 0.0, false, false,
+                                        legendre_n1, legendre_n2, laguerre_n1, laguerre_n2);
+                AdaptiveGaussTree extrapolated(c.f, 0.0, 1.0, 1e-10, 1, 40, 10, 15, 0.0, 0.0, false, false,
+                                               legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, {},
+                                               "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                               {}, extrapolate);
+                double plain_error = std::abs(plain.get_integral_and_error().first - c.exact);
+                double extrapolated_error = std::abs(extrapolated.get_integral_and_error().first - c.exact);
+                std::cout << c.name << ": " << plain.node_count() << " nodes, error " << plain_error << " bisected; "
+                          << extrapolated.node_count() << " nodes, error " << extrapolated_error << " extrapolated\n";
+                if (extrapolated_error > 1e-10 || extrapolated.node_count() * 5 > plain.node_count()
+                    || (TreeStats::enabled && extrapolated.get_stats().extrapolations != 1)) {
+                    std::cout << "extrapolation did not pay off" << std::endl;
+                    return 1;
+                }
+                // the extrapolated leaf and the option survive both layouts
+                for (bool compact : {false, true}) {
+                    extrapolated.save_to_json("adaptive_output_wynn.json", true, false, compact);
+                    AdaptiveGaussTree loaded(c.f, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "adaptive_output_wynn.json");
+                    if (loaded.get_tree_serialized(false, compact) != extrapolated.get_tree_serialized(false, compact)
+                        || loaded.get_tree_serialized(false, compact).dump().find("Wynn-epsilon") == std::string::npos
+                        || !loaded.get_singularity_detection().extrapolate) {
+                        std::cout << "extrapolated tree changed in the round trip (compact = " << compact << ")" << std::endl;
+                        return 1;
+                    }
+                }
+            }
+        }
+
         // Load from JSON generated by python NB
 
         AdaptiveGaussTree loaded_tree_2(test_function, legendre_n1, legendre_n2, laguerre_n1, laguerre_n2, "../test_dump.json");
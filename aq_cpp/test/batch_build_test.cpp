@@ -0,0 +1,264 @@
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include "batch_build.hpp"
+
+namespace {
+
+bool same_trees(const AdaptiveGaussTreeBatch& batch, const AdaptiveGaussTreeBatch& reference, const ParamMap& param_map) {
+    return batch.getCollection().at(param_map)->get_tree_serialized() == reference.getCollection().at(param_map)->get_tree_serialized();
+}
+
+}  // namespace
+
+int main() {
+    try {
+        WeightsLoader legendre("../model_json/legendre.json");
+        WeightsLoader laguerre("../model_json/laguerre.json");
+        // x^k exp(-c x) on [0, 1]: 8 x 4 trees of a few levels each at n = 5, 8
+        std::function<double(ParamMap, double)> func = [](ParamMap p, double x) {
+            return std::pow(x, std::get<int>(p.at("k"))) * std::exp(-std::get<double>(p.at("c")) * x);
+        };
+        ParamCollection parameters = {{"k", std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7}}, {"c", std::vector<double>{0.5, 2.0, 8.0, 32.0}}};
+        std::vector<ParamMap> grid = AdaptiveGaussTreeBatch::expand_grid(parameters);
+        auto build = [&](std::function<double(ParamMap, double)> f, BatchControl control, BatchCheckpoint checkpoint = {}) {
+            return AdaptiveGaussTreeBatch(f, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                                          legendre, legendre, laguerre, laguerre, parameters,
+                                          "Project", "Author", "project description", "references", "1.0", "Initial Batch Creation",
+                                          checkpoint, {}, {}, nullptr, {}, control);
+        };
+        AdaptiveGaussTreeBatch reference = build(func, {});
+
+        // progress after every tree; an unreached deadline and an unset cancel flag change nothing
+        std::vector<BatchProgress> reports;
+        BatchControl watched{[&](const BatchProgress& progress) { reports.push_back(progress); }, 1.0,
+                             std::make_shared<std::atomic<bool>>(false), std::chrono::steady_clock::now() + std::chrono::hours(1)};
+        AdaptiveGaussTreeBatch controlled = build(func, watched);
+        double worst = 0.0;
+        for (const ParamMap& param_map : grid) {
+            worst = std::max(worst, reference.getCollection().at(param_map)->get_integral_and_error().second);
+            if (!same_trees(controlled, reference, param_map)) {
+                std::cout << "controlled build differs at " << param_map << std::endl;
+                return 1;
+            }
+        }
+        const BatchProgress& last = reports.back();
+        std::cout << reports.size() << " reports, last: " << last.trees_done << "/" << last.trees_total << " trees, "
+                  << last.evaluations << " evaluations, worst error " << last.worst_error << "\n";
+        if (reports.size() < grid.size() || last.trees_done != grid.size() || last.trees_total != grid.size()
+            || last.worst_error != worst || (TreeStats::enabled && last.evaluations != reference.total_stats().evaluations)
+            || !controlled.best_effort_trees().empty()) {
+            std::cout << "progress reports wrong" << std::endl;
+            return 1;
+        }
+
+        // in the background
+        BatchBuild background(func, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                              legendre, legendre, laguerre, laguerre, parameters);
+        while (!background.ready()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        AdaptiveGaussTreeBatch built = background.get();
+        for (const ParamMap& param_map : grid) {
+            if (!same_trees(built, reference, param_map)) {
+                std::cout << "background build differs at " << param_map << std::endl;
+                return 1;
+            }
+        }
+        if (background.progress().trees_done != grid.size()) {
+            std::cout << "background progress wrong" << std::endl;
+            return 1;
+        }
+
+        // a handle moved from has no build: it refuses instead of dereferencing nothing
+        BatchBuild taken = std::move(background);
+        int refusals = 0;
+        for (const std::function<void()>& use : std::vector<std::function<void()>>{
+                 [&] { background.progress(); }, [&] { background.wait(); }, [&] { background.get(); }, [&] { taken.get(); }}) {
+            try {
+                use();
+            } catch (const std::logic_error&) {
+                ++refusals;
+            }
+        }
+        background.cancel();
+        if (refusals != 4 || background.ready() || taken.progress().trees_done != grid.size()) {
+            std::cout << "moved-from handle not refused (" << refusals << " of 4)" << std::endl;
+            return 1;
+        }
+
+        // cancelled once the first trees are done; a dropped handle cancels its build too
+        std::function<double(ParamMap, double)> slow = [&](ParamMap p, double x) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            return func(p, x);
+        };
+        auto started = std::chrono::steady_clock::now();
+        {
+            BatchBuild dropped(slow, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                               legendre, legendre, laguerre, laguerre, parameters);
+        }
+        BatchBuild cancelled(slow, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                             legendre, legendre, laguerre, laguerre, parameters);
+        while (cancelled.progress().trees_done < 2 && !cancelled.ready()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cancelled.cancel();
+        try {
+            cancelled.get();
+            std::cout << "cancelled build returned a batch" << std::endl;
+            return 1;
+        } catch (const std::runtime_error& e) {
+            std::cout << "cancelled after " << cancelled.progress().trees_done << " trees (" << e.what() << "), "
+                      << std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() << " s\n";
+        }
+
+        // a running build assigned over is cancelled (not run to completion) before the handle takes the new one
+        auto flag = std::make_shared<std::atomic<bool>>(false);
+        std::atomic<std::size_t> replaced_done{0};
+        BatchBuild reassigned(slow, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                              legendre, legendre, laguerre, laguerre, parameters,
+                              {[&](const BatchProgress& progress) { replaced_done = progress.trees_done; }, 1.0, flag, std::nullopt});
+        while (reassigned.progress().trees_done < 1 && !reassigned.ready()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        reassigned = BatchBuild(func, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                                legendre, legendre, laguerre, laguerre, parameters);
+        std::cout << "replaced build cancelled after " << replaced_done << " trees\n";
+        if (!flag->load() || replaced_done >= grid.size()) {
+            std::cout << "replaced build not cancelled" << std::endl;
+            return 1;
+        }
+        AdaptiveGaussTreeBatch replacement = reassigned.get();
+        for (const ParamMap& param_map : grid) {
+            if (!same_trees(replacement, reference, param_map)) {
+                std::cout << "build assigned to a running handle differs at " << param_map << std::endl;
+                return 1;
+            }
+        }
+
+        // deadline: the tree of grid[cut] stalls past it, so it and the trees after it are best effort
+        const std::size_t cut = grid.size() / 2;
+        std::atomic<bool> stalled{false};
+        std::function<double(ParamMap, double)> stalling = [&](ParamMap p, double x) {
+            if (ParamMapEqual()(p, grid[cut]) && !stalled.exchange(true)) std::this_thread::sleep_for(std::chrono::milliseconds(400));
+            return func(p, x);
+        };
+        AdaptiveGaussTreeBatch bounded = build(stalling, {nullptr, 1.0, nullptr, std::chrono::steady_clock::now() + std::chrono::milliseconds(200)});
+        std::vector<ParamMap> best_effort = bounded.best_effort_trees();
+        std::cout << best_effort.size() << " of " << grid.size() << " trees best effort at the deadline\n";
+        if (best_effort != std::vector<ParamMap>(grid.begin() + cut, grid.end())) {
+            std::cout << "wrong trees cut at the deadline" << std::endl;
+            return 1;
+        }
+        // a cut tree is a coarser estimate, off by about its error estimate (the rule difference)
+        for (std::size_t i = 0; i < grid.size(); ++i) {
+            auto [integral, error] = bounded.getCollection().at(grid[i])->get_integral_and_error();
+            double exact = reference.getCollection().at(grid[i])->get_integral_and_error().first;
+            if ((i < cut && !same_trees(bounded, reference, grid[i])) || std::abs(integral - exact) > std::max(2.0 * error, 1e-12 * std::abs(exact))) {
+                std::cout << "tree " << grid[i] << " wrong after the deadline" << std::endl;
+                return 1;
+            }
+        }
+        for (bool compact : {false, true}) {
+            bounded.save_to_json("batch_build_output.json", true, false, false, compact);
+            AdaptiveGaussTreeBatch loaded(func, "batch_build_output.json");
+            if (loaded.best_effort_trees() != best_effort) {
+                std::cout << "best effort flags lost in the round trip (compact = " << compact << ")" << std::endl;
+                return 1;
+            }
+        }
+
+        // with a checkpoint, trees cut by the deadline stay out of the log and the resumed build finishes them
+        BatchCheckpoint checkpoint{"batch_build_checkpoint.json", 0.0};
+        std::filesystem::remove(checkpoint.filename);
+        std::filesystem::remove(checkpoint.filename + ".log");
+        AdaptiveGaussTreeBatch expired = build(func, {nullptr, 1.0, nullptr, std::chrono::steady_clock::now()}, checkpoint);
+        if (expired.best_effort_trees().size() != grid.size() || std::filesystem::exists(checkpoint.filename + ".log")) {
+            std::cout << "expired checkpointed build wrong" << std::endl;
+            return 1;
+        }
+        AdaptiveGaussTreeBatch resumed(func, legendre, legendre, laguerre, laguerre, checkpoint);
+        for (const ParamMap& param_map : grid) {
+            if (!same_trees(resumed, reference, param_map)) {
+                std::cout << "resumed build differs at " << param_map << std::endl;
+                return 1;
+            }
+        }
+        std::filesystem::remove(checkpoint.filename);
+        std::filesystem::remove(checkpoint.filename + ".log");
+
+        // a single tree stopped at once: root only, flag kept by the tree file
+        AdaptiveGaussTree stopped(func, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                                  legendre, legendre, laguerre, laguerre, grid.back(),
+                                  "Project", "Author", "project description", "references", "1.0", "Initial Train",
+                                  {}, {}, {}, {}, TreeCheckpoint{nullptr, nullptr, 0.0, [] { return true; }});
+        stopped.save_to_json("batch_build_tree_output.json", true);
+        AdaptiveGaussTree reloaded(func, legendre, legendre, laguerre, laguerre, "batch_build_tree_output.json", grid.back());
+        std::cout << "stopped tree: " << stopped.node_count() << " nodes, error " << stopped.get_integral_and_error().second << "\n";
+        if (!stopped.is_best_effort() || stopped.node_count() != 1 || !reloaded.is_best_effort()) {
+            std::cout << "stopped tree wrong" << std::endl;
+            return 1;
+        }
+
+        // vector-valued batch (components k = 0..7): the same control and checkpoints.  Cancelled within its second 
+        // tree, it resumes from the vector-valued frontier to the trees of an uninterrupted build.
+        VectorIntegrand powers = [](const ParamMap& p, double x, std::vector<double>& out) {
+            double value = std::exp(-std::get<double>(p.at("c")) * x);
+            for (double& component : out) {
+                component = value;
+                value *= x;
+            }
+        };
+        auto build_vector = [&](BatchControl control, BatchCheckpoint checkpoint = {}) {
+            return AdaptiveGaussTreeBatch(powers, "k", {0, 1, 2, 3, 4, 5, 6, 7}, 0.0, 1.0, 1e-12, 1, 30, 5, 8, 0.0, 0.0, false, false,
+                                          legendre, legendre, laguerre, laguerre, {{"c", std::vector<double>{0.5, 2.0, 8.0, 32.0}}},
+                                          "Project", "Author", "project description", "references", "1.0", "Initial Batch Creation",
+                                          checkpoint, {}, {}, nullptr, {}, control);
+        };
+        AdaptiveGaussTreeBatch vector_reference = build_vector({});
+        AdaptiveGaussTreeBatch vector_expired = build_vector({nullptr, 1.0, nullptr, std::chrono::steady_clock::now()});
+        if (vector_expired.best_effort_trees().size() != grid.size()) {
+            std::cout << "vector-valued build ignores the deadline" << std::endl;
+            return 1;
+        }
+        auto vector_cancel = std::make_shared<std::atomic<bool>>(false);
+        std::vector<BatchProgress> vector_reports;
+        BatchControl cancelling{[&](const BatchProgress& progress) {
+            vector_reports.push_back(progress);
+            if (progress.trees_done == 8 && std::count_if(vector_reports.begin(), vector_reports.end(),
+                                                          [](const BatchProgress& r) { return r.trees_done == 8; }) == 5) {
+                vector_cancel->store(true);
+            }
+        }, 0.0, vector_cancel, std::nullopt};
+        std::filesystem::remove(checkpoint.filename);
+        std::filesystem::remove(checkpoint.filename + ".log");
+        try {
+            build_vector(cancelling, checkpoint);
+            std::cout << "vector-valued build not cancelled" << std::endl;
+            return 1;
+        } catch (const std::runtime_error&) {}
+        std::ifstream state_file(checkpoint.filename);
+        json state = json::parse(state_file);
+        AdaptiveGaussTreeBatch vector_logged(func, checkpoint.filename + ".log");
+        std::cout << "vector-valued build cancelled with " << vector_logged.getCollection().size() << " trees logged, frontier "
+                  << (state["frontier"].is_null() ? "none" : state["frontier"]["parameters"].dump()) << "\n";
+        if (vector_reports.back().trees_total != grid.size() || vector_logged.getCollection().size() != 8 || state["frontier"].is_null()) {
+            std::cout << "cancelled vector-valued build wrong" << std::endl;
+            return 1;
+        }
+        // the logged trees come back from the leaf-compact layout, which rebuilds interior nodes from the leaves
+        AdaptiveGaussTreeBatch vector_resumed = build_vector({}, checkpoint);
+        for (const ParamMap& param_map : grid) {
+            if (vector_resumed.getCollection().at(param_map)->get_tree_serialized(false, true)
+                != vector_reference.getCollection().at(param_map)->get_tree_serialized(false, true)) {
+                std::cout << "resumed vector-valued build differs at " << param_map << std::endl;
+                return 1;
+            }
+        }
+        std::filesystem::remove(checkpoint.filename);
+        std::filesystem::remove(checkpoint.filename + ".log");
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
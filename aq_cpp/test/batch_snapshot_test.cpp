@@ -0,0 +1,113 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+#include "batch_snapshot.hpp"
+
+int main() {
+    try {
+        WeightsLoader legendre("../model_json/legendre.json");
+        WeightsLoader laguerre("../model_json/laguerre.json");
+        // x^k exp(-c x) on [0, 1]: 20 x 10 trees
+        std::function<double(ParamMap, double)> func = [](ParamMap p, double x) {
+            return std::pow(x, std::get<int>(p.at("k"))) * std::exp(-std::get<double>(p.at("c")) * x);
+        };
+        std::vector<int> k;
+        std::vector<double> c;
+        for (int i = 0; i < 20; ++i) k.push_back(i);
+        for (int i = 1; i <= 10; ++i) c.push_back(0.5 * i);
+        ParamCollection parameters = {{"k", k}, {"c", c}};
+        AdaptiveGaussTreeBatch batch(func, 0.0, 1.0, 1e-12, 1, 20, 10, 15, 0.0, 0.0, false, false,
+                                     legendre, legendre, laguerre, laguerre, parameters);
+        std::vector<ParamMap> queries = AdaptiveGaussTreeBatch::expand_grid(parameters);
+
+        SnapshotSlot slot(std::make_shared<const BatchSnapshot>(batch));
+        auto snapshot = slot.get();
+        for (const ParamMap& query : queries) {
+            if (snapshot->at(query) != batch.getCollection().at(query)->get_integral_and_error()) {
+                std::cout << "snapshot differs from the batch at " << query << std::endl;
+                return 1;
+            }
+        }
+        if (snapshot->size() != queries.size() || snapshot->find({{"k", 20}, {"c", 0.5}}) || snapshot->last_update().second.empty()) {
+            std::cout << "snapshot contents wrong" << std::endl;
+            return 1;
+        }
+        std::cout << snapshot->size() << " trees in the snapshot of \"" << snapshot->last_update().second << "\"\n";
+
+        // retrained table: the same grid at a tighter tolerance, marked by its update log message
+        AdaptiveGaussTreeBatch retrained(func, 0.0, 1.0, 1e-14, 1, 20, 10, 15, 0.0, 0.0, false, false,
+                                         legendre, legendre, laguerre, laguerre, parameters,
+                                         "Project", "Author", "project description", "references", "1.1", "Retrained");
+        auto fresh = std::make_shared<const BatchSnapshot>(retrained);
+
+        // readers query whatever snapshot is current while the publisher swaps the two back and forth; every answer
+        // must belong to the snapshot the reader holds.  A request is 4 lookups, read through a SnapshotSlot::Reader
+        // (the server's way) or through slot.get(), which copies the shared_ptr under the slot's lock
+        unsigned int threads = std::max(2u, std::thread::hardware_concurrency());
+        std::map<std::pair<bool, unsigned int>, double> rates;
+        for (bool through_reader : {true, false}) {
+            for (unsigned int readers : {1u, threads}) {
+                std::atomic<bool> stop{false};
+                std::atomic<long> lookups{0}, wrong{0};
+                std::atomic<std::size_t> most_refreshes{0};
+                std::vector<std::thread> pool;
+                for (unsigned int t = 0; t < readers; ++t) {
+                    pool.emplace_back([&, t] {
+                        SnapshotSlot::Reader reader(slot);
+                        long count = 0;
+                        std::size_t i = t;
+                        while (!stop.load(std::memory_order_relaxed)) {
+                            std::shared_ptr<const BatchSnapshot> copied;
+                            const BatchSnapshot* held = through_reader ? reader.get().get() : (copied = slot.get()).get();
+                            const std::shared_ptr<const BatchSnapshot>& expected = held->last_update().second == "Retrained" ? fresh : snapshot;
+                            for (int n = 0; n < 4; ++n, ++count) {
+                                const ParamMap& query = queries[i++ % queries.size()];
+                                if (*held->find(query) != *expected->find(query)) wrong.fetch_add(1);
+                            }
+                        }
+                        lookups.fetch_add(count);
+                        std::size_t refreshes = reader.refreshes(), most = most_refreshes.load();
+                        while (refreshes > most && !most_refreshes.compare_exchange_weak(most, refreshes)) {}
+                    });
+                }
+                auto start = std::chrono::steady_clock::now();
+                for (int swap = 0; swap < 100; ++swap) {
+                    slot.publish(swap % 2 ? snapshot : fresh);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+                stop = true;
+                for (auto& reader : pool) reader.join();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                double rate = rates[{through_reader, readers}] = lookups / seconds / 1e6;
+                std::cout << readers << " reader(s), " << (through_reader ? "Reader::get()" : "slot.get()   ") << ": "
+                          << std::setprecision(3) << rate << " M lookups/s during 100 swaps";
+                if (through_reader) std::cout << ", at most " << most_refreshes << " snapshot loads per reader";
+                std::cout << "\n";
+                if (wrong != 0) {
+                    std::cout << wrong << " lookups answered from the wrong snapshot" << std::endl;
+                    return 1;
+                }
+                // a Reader takes the slow path once per publish it sees (and once to start), not per request
+                if (through_reader && most_refreshes > 101) {
+                    std::cout << "Reader reloaded the snapshot " << most_refreshes << " times for 100 publishes" << std::endl;
+                    return 1;
+                }
+            }
+        }
+        // readers on separate cores must not serialize on the slot; only meaningful with cores to spare, and kept
+        // lenient since the machine may be busy
+        if (std::thread::hardware_concurrency() >= 4 && rates[{true, threads}] < 1.5 * rates[{true, 1u}]) {
+            std::cout << threads << " readers no faster than 1: " << rates[{true, threads}] << " vs "
+                      << rates[{true, 1u}] << " M lookups/s" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include "aq_c_api.h"
+#include "adaptive_gauss_batch.hpp"
+
+// x^k e^{-c x} at n points, with the parameters in the order of the keys {"k", "c"}; user_data counts calls and points
+extern "C" void integrand(const double* x, size_t n, const double* params, size_t n_params, double* out, void* user_data) {
+    long* counts = static_cast<long*>(user_data);
+    ++counts[0];
+    counts[1] += static_cast<long>(n);
+    for (size_t i = 0; i < n; ++i) out[i] = n_params == 2 ? std::pow(x[i], params[0]) * std::exp(-params[1] * x[i]) : std::nan("");
+}
+
+int main() {
+    aq_batch* built = nullptr;
+    aq_batch* loaded = nullptr;
+    try {
+        const char* keys[] = {"k", "c"};
+        const int is_int[] = {1, 0};
+        const double ks[] = {0, 1, 2, 3}, cs[] = {0.5, 2.0};
+        const double* values[] = {ks, cs};
+        const size_t n_values[] = {4, 2};
+        long calls[2] = {0, 0};
+        aq_settings settings = aq_default_settings();
+        settings.tol = 1e-13;
+        settings.min_depth = 0;
+        settings.max_depth = 30;
+        settings.n1 = 3;
+        settings.n2 = 5;
+        built = aq_batch_build_grid(integrand, calls, &settings, 2, keys, is_int, n_values, values);
+        if (!built) {
+            std::cout << "build failed: " << aq_last_error() << std::endl;
+            return 1;
+        }
+        std::cout << "api " << aq_api_version() << ": " << aq_batch_size(built) << " trees, " << calls[0] << " integrand calls for "
+                  << calls[1] << " points, keys";
+        for (size_t k = 0; k < aq_batch_key_count(built); ++k) std::cout << " " << aq_batch_key(built, k);
+        std::cout << "\n";
+        if (calls[1] != calls[0] * (settings.n1 + settings.n2)) {   // one call per rule evaluation
+            std::cout << "integrand not called once per rule" << std::endl;
+            return 1;
+        }
+
+        // the same batch through the C++ interface: bit for bit with the points integrand, to the tolerance with the
+        // one called per point
+        WeightsLoader legendre("../model_json/legendre.json");
+        WeightsLoader laguerre("../model_json/laguerre.json");
+        std::function<double(ParamMap, double)> func = [](ParamMap p, double x) {
+            return std::pow(x, std::get<int>(p.at("k"))) * std::exp(-std::get<double>(p.at("c")) * x);
+        };
+        ParamCollection parameters = {{"k", std::vector<int>{0, 1, 2, 3}}, {"c", std::vector<double>{0.5, 2.0}}};
+        AdaptiveGaussTreeBatch reference(func, 0.0, 1.0, 1e-13, 0, 30, 3, 5, 0.0, 0.0, false, false,
+                                         legendre, legendre, laguerre, laguerre, parameters);
+        PointsIntegrand points = [func](const ParamMap& p, const std::vector<double>& x, std::vector<double>& out) {
+            for (std::size_t i = 0; i < x.size(); ++i) out[i] = func(p, x[i]);
+        };
+        AdaptiveGaussTreeBatch rule_at_a_time(points, 0.0, 1.0, 1e-13, 0, 30, 3, 5, 0.0, 0.0, false, false,
+                                              legendre, legendre, laguerre, laguerre,
+                                              AdaptiveGaussTreeBatch::expand_grid(parameters));
+
+        // bulk lookup of every tree and one the batch does not have (k = 7), row-major as a NumPy array would be
+        std::vector<double> rows;
+        for (double k : ks)
+            for (double c : cs) rows.insert(rows.end(), {k, c});
+        rows.insert(rows.end(), {7, 0.5});
+        const size_t n = rows.size() / 2;
+        std::vector<double> integrals(n), errors(n);
+        if (aq_batch_lookup(built, 2, keys, is_int, n, rows.data(), integrals.data(), errors.data()) != 0) {
+            std::cout << "lookup failed: " << aq_last_error() << std::endl;
+            return 1;
+        }
+        for (size_t i = 0; i + 1 < n; ++i) {
+            ParamMap param_map{{"k", static_cast<int>(rows[2 * i])}, {"c", rows[2 * i + 1]}};
+            auto [integral, error] = rule_at_a_time.getCollection().at(param_map)->get_integral_and_error();
+            double per_point = reference.getCollection().at(param_map)->get_integral_and_error().first;
+            if (integrals[i] != integral || errors[i] != error || std::abs(integrals[i] - per_point) > 1e-13) {
+                std::cout << "C API differs from C++ at " << param_map << std::endl;
+                return 1;
+            }
+        }
+        if (!std::isnan(integrals[n - 1]) || !std::isnan(errors[n - 1])) {
+            std::cout << "missing tree not NaN" << std::endl;
+            return 1;
+        }
+
+        // save, load and look up again (errors not asked for)
+        if (aq_batch_save(built, "c_api_output.json", 0) != 0 || !(loaded = aq_batch_load("c_api_output.json"))) {
+            std::cout << "round trip failed: " << aq_last_error() << std::endl;
+            return 1;
+        }
+        std::vector<double> reloaded(n);
+        aq_batch_lookup(loaded, 2, keys, is_int, n, rows.data(), reloaded.data(), nullptr);
+        for (size_t i = 0; i + 1 < n; ++i) {
+            if (reloaded[i] != integrals[i]) {
+                std::cout << "loaded batch differs at row " << i << std::endl;
+                return 1;
+            }
+        }
+
+        // failures come back as NULL / -1 with a message, not as exceptions
+        aq_batch* missing = aq_batch_load("no_such_file.json");
+        std::string load_error = aq_last_error();
+        int status = aq_batch_lookup(nullptr, 2, keys, is_int, 1, rows.data(), integrals.data(), nullptr);
+        std::cout << "bad file: " << load_error << "\nno batch: " << aq_last_error() << "\n";
+        if (missing || load_error.empty() || status != -1 || std::string(aq_last_error()).empty()) {
+            std::cout << "failures not reported" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        aq_batch_free(built);
+        aq_batch_free(loaded);
+        return 1;
+    }
+    aq_batch_free(built);
+    aq_batch_free(loaded);
+    return 0;
+}
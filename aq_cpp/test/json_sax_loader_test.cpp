@@ -0,0 +1,137 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include "polylog_port.hpp"
+#include "adaptive_gauss_tree.hpp"
+#include "adaptive_gauss_batch.hpp"
+#include "json_sax_loader.hpp"
+
+// Benchmark: single pass SAX loader against the DOM path it replaces
+//   polylogs.json  (batch file, 9 x 21 trees)
+//   laguerre.json  (root table, orders 1..300)
+
+template <typename F>
+double best_of_ms(int repeats, F&& body) {
+    double best = 1e300;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        body();
+        auto stop = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+    return best;
+}
+
+// DOM path as the batch loader used to do it: parse everything, then copy each subtree into a
+// header object and hand that to the JSON constructor of AdaptiveGaussTree.
+void dom_collect(const json& level, ParamMap path, const json& data, std::vector<std::unique_ptr<AdaptiveGaussTree>>& trees) {
+    for (auto it = level.begin(); it != level.end(); ++it) {
+        if (it.key() == "tree") {
+            json json_head;
+            json_head["name"] = data["name"];
+            json_head["reference"] = data["reference"].is_null() ? json("") : data["reference"];
+            json_head["description"] = data["description"];
+            json_head["author"] = data["author"];
+            json_head["version"] = data["version"];
+            json_head["tolerance"] = data["tol"];
+            json_head["min_depth"] = data["min_depth"];
+            json_head["max_depth"] = data["max_depth"];
+            json_head["n1"] = data["n1"];
+            json_head["n2"] = data["n2"];
+            json tree_json = it.value();
+            json_head["tree"] = tree_json;
+            trees.push_back(std::make_unique<AdaptiveGaussTree>(json_head, polylog_wrapper,
+                WeightsLoader(), WeightsLoader(), WeightsLoader(), WeightsLoader(), path));
+            continue;
+        }
+        for (auto value = it->begin(); value != it->end(); ++value) {
+            ParamMap next = path;
+            next[it.key()] = JsonSaxLoader::parse_param_value(value.key());
+            dom_collect(*value, next, data, trees);
+        }
+    }
+}
+
+int main() {
+    const int repeats = 5;
+    std::cout << std::setprecision(15);
+
+    try {
+        // --- batch file ---------------------------------------------------------------------------------
+        const std::string batch_file = "../model_json/polylogs.json";
+        double dom_total = 0.0, sax_total = 0.0;
+        size_t dom_trees = 0, sax_trees = 0;
+
+        double dom_ms = best_of_ms(repeats, [&]() {
+            std::ifstream file(batch_file);
+            json data;
+            file >> data;
+            std::vector<std::unique_ptr<AdaptiveGaussTree>> trees;
+            dom_collect(data["parameters"], {}, data, trees);
+            dom_total = 0.0;
+            for (const auto& tree : trees) dom_total += tree->get_integral_and_error().first;
+            dom_trees = trees.size();
+        });
+
+        double sax_ms = best_of_ms(repeats, [&]() {
+            AdaptiveGaussTreeBatch batch(polylog_wrapper, batch_file);
+            sax_total = 0.0;
+            for (const auto& [params, tree] : batch.getCollection()) sax_total += tree->get_integral_and_error().first;
+            sax_trees = batch.getCollection().size();
+        });
+
+        std::cout << "=== " << batch_file << " ===\n";
+        std::cout << "DOM + subtree copies: " << dom_ms << " ms  (" << dom_trees << " trees, sum of integrals " << dom_total << ")\n";
+        std::cout << "SAX single pass:      " << sax_ms << " ms  (" << sax_trees << " trees, sum of integrals " << sax_total << ")\n";
+        std::cout << "Speedup: " << dom_ms / sax_ms << "x\n";
+        if (dom_trees != sax_trees || std::abs(dom_total - sax_total) > 1e-12 * std::abs(dom_total)) {
+            std::cerr << "Mismatch between DOM and SAX loads!" << std::endl;
+            return 1;
+        }
+
+        // --- root table ---------------------------------------------------------------------------------
+        const std::string weights_file = "../model_json/laguerre.json";
+        size_t dom_orders = 0, sax_orders = 0;
+        double dom_w_ms = best_of_ms(repeats, [&]() {
+            std::ifstream file(weights_file);
+            json data;
+            file >> data;
+            std::unordered_map<int, std::vector<double>> nodes, weights;
+            for (const auto& [key, value] : data["n"].items()) {
+                nodes[std::stoi(key)] = value["0"].get<std::vector<double>>();
+                weights[std::stoi(key)] = value["1"].get<std::vector<double>>();
+            }
+            dom_orders = nodes.size();
+        });
+        WeightsLoader laguerre;
+        double sax_w_ms = best_of_ms(repeats, [&]() {
+            JsonSaxLoader::load_weights(weights_file, laguerre);   // eager; WeightsLoader(filename) decodes lazily
+            sax_orders = laguerre.getNMax();
+        });
+
+        std::cout << "\n=== " << weights_file << " ===\n";
+        std::cout << "DOM:                  " << dom_w_ms << " ms  (" << dom_orders << " orders)\n";
+        std::cout << "SAX single pass:      " << sax_w_ms << " ms  (n_max " << sax_orders << ")\n";
+        std::cout << "Speedup: " << dom_w_ms / sax_w_ms << "x\n";
+        std::cout << "Order 2 nodes: " << laguerre.getNodes(2)[0] << " " << laguerre.getNodes(2)[1] << "\n";
+
+        // --- round trip through save_to_json --------------------------------------------------------------
+        AdaptiveGaussTreeBatch batch(polylog_wrapper, batch_file);
+        batch.save_to_json("sax_roundtrip.json", true, false, false);   // write_trees = false keeps every node
+        AdaptiveGaussTreeBatch reloaded(polylog_wrapper, "sax_roundtrip.json");
+        double roundtrip_total = 0.0;
+        for (const auto& [params, tree] : reloaded.getCollection()) roundtrip_total += tree->get_integral_and_error().first;
+        std::cout << "\nRound trip sum of integrals: " << roundtrip_total << "\n";
+        if (std::abs(roundtrip_total - sax_total) > 1e-12 * std::abs(sax_total)) {
+            std::cerr << "Round trip changed the integrals!" << std::endl;
+            return 1;
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
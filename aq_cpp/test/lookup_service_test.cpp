@@ -0,0 +1,218 @@
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "lookup_service.hpp"
+
+namespace {
+
+// Request body sent as is (LookupClient only writes well-formed ones); returns the response body
+std::string raw_exchange(const std::string& socket_path, const std::string& body) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        throw std::runtime_error("cannot connect to " + socket_path);
+    }
+    std::uint64_t length = body.size();
+    std::string message(reinterpret_cast<const char*>(&length), sizeof(length));
+    message += body;
+    std::string response;
+    if (::send(fd, message.data(), message.size(), 0) == static_cast<ssize_t>(message.size())
+        && ::recv(fd, &length, sizeof(length), MSG_WAITALL) == sizeof(length)) {
+        response.resize(length);
+        if (::recv(fd, &response[0], length, MSG_WAITALL) != static_cast<ssize_t>(length)) response.clear();
+    }
+    ::close(fd);
+    return response;
+}
+
+template <typename T>
+void put(std::string& body, T value) { body.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+void put_string(std::string& body, const std::string& value) {
+    put(body, static_cast<std::uint32_t>(value.size()));
+    body += value;
+}
+
+}  // namespace
+
+int main() {
+    try {
+        const std::string polylogs = "../model_json/polylogs.json", table_file = "lookup_table.json", socket = "lookup_service_test.sock";
+        auto start = std::chrono::steady_clock::now();
+        AdaptiveGaussTreeBatch reference(nullptr, polylogs);
+        double parse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // a small table that is retrained (tighter tolerance) while it is served
+        WeightsLoader legendre("../model_json/legendre.json");
+        WeightsLoader laguerre("../model_json/laguerre.json");
+        std::function<double(ParamMap, double)> func = [](ParamMap p, double x) {
+            return std::pow(x, std::get<int>(p.at("k"))) * std::exp(-std::get<double>(p.at("c")) * x);
+        };
+        ParamCollection parameters = {{"k", std::vector<int>{0, 1, 2, 3}}, {"c", std::vector<double>{0.5, 2.0, 0.1234567, 0.1234568}}};
+        AdaptiveGaussTreeBatch coarse(func, 0.0, 1.0, 1e-6, 0, 30, 3, 5, 0.0, 0.0, false, false,
+                                      legendre, legendre, laguerre, laguerre, parameters);
+        AdaptiveGaussTreeBatch fine(func, 0.0, 1.0, 1e-13, 0, 30, 3, 5, 0.0, 0.0, false, false,
+                                    legendre, legendre, laguerre, laguerre, parameters);
+        coarse.save_to_json(table_file, true, false, false);
+
+        LookupServer server(socket, {polylogs, table_file}, 0.05);
+        LookupClient client(socket);
+        auto tables = client.tables();
+        std::cout << "tables:";
+        for (const auto& [name, trees] : tables) std::cout << " " << name << " (" << trees << " trees)";
+        std::cout << "\n";
+        if (tables != std::vector<std::pair<std::string, std::size_t>>{{"lookup_table", 16}, {"polylogs", reference.getCollection().size()}}) {
+            std::cout << "wrong tables" << std::endl;
+            return 1;
+        }
+
+        // every polylog tree in one request, answered from the values the batch itself gives
+        std::vector<ParamMap> combinations;
+        for (const auto& [param_map, tree] : reference.getCollection()) combinations.push_back(param_map);
+        std::vector<std::pair<double, double>> values = client.lookup("polylogs", combinations);
+        for (std::size_t i = 0; i < combinations.size(); ++i) {
+            if (values[i] != reference.getCollection().at(combinations[i])->get_integral_and_error()) {
+                std::cout << "lookup differs at " << combinations[i] << std::endl;
+                return 1;
+            }
+        }
+
+        // a missing tree is NaN; so is a key of the wrong type (s = 2.0 is not the int 2)
+        ParamMap known = combinations.front(), wrong_type = known;
+        wrong_type["s"] = static_cast<double>(std::get<int>(known.at("s")));
+        auto missing = client.lookup("polylogs", std::vector<ParamMap>{{{"s", 1000}, {"z", 0.5}}, wrong_type});
+        if (!std::isnan(missing[0].first) || !std::isnan(missing[1].second)) {
+            std::cout << "missing trees not NaN" << std::endl;
+            return 1;
+        }
+        bool refused = false;
+        try {
+            client.lookup("no_such_table", known);
+        } catch (const std::runtime_error& e) {
+            refused = true;
+            std::cout << "unknown table: " << e.what() << "\n";
+        }
+        try {
+            LookupServer second(socket, {table_file});
+            refused = false;
+        } catch (const std::runtime_error& e) {
+            std::cout << "second server: " << e.what() << "\n";
+        }
+        if (!refused || client.lookup("polylogs", known) != values.front()) {
+            std::cout << "errors not reported, or the connection did not survive them" << std::endl;
+            return 1;
+        }
+
+        // parameters that differ only in the seventh digit are distinct trees of the served file
+        std::vector<ParamMap> close = {{{"k", 3}, {"c", 0.1234567}}, {{"k", 3}, {"c", 0.1234568}}};
+        auto close_values = client.lookup("lookup_table", close);
+        for (std::size_t i = 0; i < close.size(); ++i) {
+            if (close_values[i] != coarse.getCollection().at(close[i])->get_integral_and_error()) {
+                std::cout << "lookup differs at " << close[i] << std::endl;
+                return 1;
+            }
+        }
+        if (close_values[0] == close_values[1]) {
+            std::cout << "close parameters answered by one tree" << std::endl;
+            return 1;
+        }
+
+        // a lookup count not backed by values is refused at once: no reserve of 16 bytes per announced combination,
+        // no loop over combinations without keys
+        std::string no_keys, no_values;
+        for (std::string* body : {&no_keys, &no_values}) {
+            put(*body, static_cast<std::uint8_t>(LookupProtocol::Lookup));
+            put_string(*body, "lookup_table");
+        }
+        put(no_keys, std::uint32_t(0));
+        put(no_keys, std::uint32_t(4000000000u));
+        put(no_values, std::uint32_t(1));
+        put_string(no_values, "k");
+        put(no_values, std::uint32_t(0xffffffffu));
+        for (const std::string& body : {no_keys, no_values}) {
+            start = std::chrono::steady_clock::now();
+            std::string response = raw_exchange(socket, body);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (response.empty() || response[0] != LookupProtocol::Error || seconds > 1.0) {
+                std::cout << "oversized lookup count not refused (" << seconds << " s)" << std::endl;
+                return 1;
+            }
+            std::cout << "oversized count: " << response.substr(1 + sizeof(std::uint32_t)) << "\n";
+        }
+
+        const int repeats = 20000;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; ++i) client.lookup("polylogs", combinations[i % combinations.size()]);
+        double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 100; ++i) client.lookup("polylogs", combinations);
+        double bulk = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / (100.0 * combinations.size());
+        std::cout << "parse of " << polylogs << ": " << parse_seconds * 1e3 << " ms; lookup: " << single * 1e6
+                  << " us per request, " << bulk * 1e6 << " us per combination in bulk\n";
+
+        // hot reload: the retrained table replaces the file (written aside and renamed, as a careful writer does)
+        ParamMap probe{{"k", 2}, {"c", 2.0}};
+        auto before = client.lookup("lookup_table", probe);
+        fine.save_to_json(table_file + ".tmp", true, false, false);
+        std::filesystem::rename(table_file + ".tmp", table_file);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (server.reloads() == 0 && std::chrono::steady_clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        auto after = client.lookup("lookup_table", probe);
+        std::cout << "reloaded: error " << before.second << " -> " << after.second << "\n";
+        if (server.reloads() != 1 || after != fine.getCollection().at(probe)->get_integral_and_error() || after == before) {
+            std::cout << "table not reloaded" << std::endl;
+            return 1;
+        }
+
+        // half written in place: the old snapshot is kept, and the load is retried at every poll, so the file loads
+        // once finished even though its time and size are those of the failed attempt
+        coarse.save_to_json(table_file + ".tmp", true, false, false);
+        std::stringstream contents;
+        contents << std::ifstream(table_file + ".tmp").rdbuf();
+        std::filesystem::remove(table_file + ".tmp");
+        std::string full = contents.str();
+        std::ofstream(table_file, std::ios::trunc) << full.substr(0, full.size() / 2) << std::string(full.size() - full.size() / 2, ' ');
+        auto half_written = std::filesystem::last_write_time(table_file);
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        if (server.reloads() != 1 || client.lookup("lookup_table", probe) != after) {
+            std::cout << "half-written table replaced the snapshot" << std::endl;
+            return 1;
+        }
+        std::ofstream(table_file, std::ios::trunc) << full;
+        std::filesystem::last_write_time(table_file, half_written);
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (server.reloads() == 1 && std::chrono::steady_clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (server.reloads() != 2 || client.lookup("lookup_table", probe) != before) {
+            std::cout << "finished table not loaded" << std::endl;
+            return 1;
+        }
+        std::cout << "half-written table kept the last snapshot, loaded once finished\n";
+
+        server.stop();
+        bool gone = false;
+        try {
+            LookupClient late(socket);
+        } catch (const std::runtime_error&) {
+            gone = true;
+        }
+        if (!gone || std::filesystem::exists(socket)) {
+            std::cout << "server still reachable after stop" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
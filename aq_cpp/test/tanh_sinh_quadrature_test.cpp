@@ -0,0 +1,87 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include "tanh_sinh_quadrature.hpp"
+#include "adaptive_gauss_tree.hpp"
+#include "adaptive_gauss_batch.hpp"
+
+int main() {
+    try {
+        // rules computed in-process: every level starts with the points of the level before
+        WeightsLoader tanh_sinh = TanhSinhQuadrature::rules();
+        std::cout << tanh_sinh.getMethod() << " levels 0.." << tanh_sinh.getNMax() << ":";
+        for (int level = 0; level <= tanh_sinh.getNMax(); ++level) std::cout << " " << tanh_sinh.getNodes(level).size();
+        std::cout << " points\n";
+        for (int level = 1; level <= tanh_sinh.getNMax(); ++level) {
+            std::vector<double> coarse = tanh_sinh.getNodes(level - 1), fine = tanh_sinh.getNodes(level);
+            if (!std::equal(coarse.begin(), coarse.end(), fine.begin())) {
+                std::cout << "level " << level << " does not extend level " << level - 1 << std::endl;
+                return 1;
+            }
+        }
+
+        // endpoint singularities with one rule and no tree; the upper endpoint is 0 so that the integrand gets the
+        // distance to it exactly
+        struct Case { const char* name; std::function<double(ParamMap, double)> f; double lower, upper, exact; };
+        std::vector<Case> cases = {
+            {"1/sqrt(x)", [](ParamMap, double x) { return 1.0 / std::sqrt(x); }, 0.0, 1.0, 2.0},
+            {"log(x)", [](ParamMap, double x) { return std::log(x); }, 0.0, 1.0, -1.0},
+            {"log(x)/sqrt(x)", [](ParamMap, double x) { return std::log(x) / std::sqrt(x); }, 0.0, 1.0, -4.0},
+            {"x^-0.9", [](ParamMap, double x) { return std::pow(x, -0.9); }, 0.0, 1.0, 10.0},
+            {"1/sqrt(-x)", [](ParamMap, double x) { return 1.0 / std::sqrt(-x); }, -1.0, 0.0, 2.0},
+            {"exp(x)", [](ParamMap, double x) { return std::exp(x); }, 0.0, 1.0, std::exp(1.0) - 1.0}};
+        for (const Case& c : cases) {
+            long calls = 0;
+            auto counted = [&](ParamMap p, double x) { ++calls; return c.f(p, x); };
+            TanhSinhQuadrature rule(tanh_sinh, 4, 5, c.lower, c.upper);
+            double integral = rule.integrate(counted, {});
+            std::cout << std::setprecision(16) << c.name << ": " << integral << " (exact " << c.exact << "), error "
+                      << rule.getError() << ", " << calls << " calls\n";
+            if (std::abs(integral - c.exact) > 1e-14 * std::abs(c.exact) || calls != static_cast<long>(rule.getEvaluations())
+                || calls >= 400) {
+                std::cout << "tanh-sinh missed 1e-14" << std::endl;
+                return 1;
+            }
+        }
+
+        // as the rule of the tree: the root meets the tolerance, no Laguerre table and no alpha needed
+        WeightsLoader laguerre("../model_json/laguerre.json");
+        auto log_sqrt = [](ParamMap, double x) { return std::log(x) / std::sqrt(x); };
+        AdaptiveGaussTree tree(log_sqrt, 0.0, 1.0, 1e-12, 0, 30, 3, 4, 0.0, 0.0, false, false,
+                               tanh_sinh, tanh_sinh, laguerre, laguerre);
+        auto [integral, error] = tree.get_integral_and_error();
+        std::cout << "tree: " << integral << ", error " << error << ", " << tree.node_count() << " nodes\n";
+        if (std::abs(integral + 4.0) > 1e-12 || tree.node_count() != 1
+            || tree.get_tree_serialized()["method"] != TanhSinhQuadrature::method_name
+            || (TreeStats::enabled && tree.get_stats().evaluations != tanh_sinh.getNodes(4).size())) {
+            std::cout << "tanh-sinh tree failed" << std::endl;
+            return 1;
+        }
+        for (bool compact : {false, true}) {
+            tree.save_to_json("tanh_sinh_output.json", true, false, compact);
+            AdaptiveGaussTree loaded(log_sqrt, tanh_sinh, tanh_sinh, laguerre, laguerre, "tanh_sinh_output.json");
+            if (loaded.get_tree_serialized(false, compact) != tree.get_tree_serialized(false, compact)) {
+                std::cout << "tanh-sinh tree changed in the round trip (compact = " << compact << ")" << std::endl;
+                return 1;
+            }
+        }
+
+        // and in a batch: x^-a for a few a, every tree a single node
+        auto power = [](ParamMap p, double x) { return std::pow(x, -std::get<double>(p.at("a"))); };
+        AdaptiveGaussTreeBatch batch(power, 0.0, 1.0, 1e-12, 0, 30, 3, 4, 0.0, 0.0, false, false,
+                                     tanh_sinh, tanh_sinh, laguerre, laguerre, ParamCollection{{"a", std::vector<double>{0.25, 0.5, 0.75}}});
+        for (const auto& [param_map, batch_tree] : batch.getCollection()) {
+            double a = std::get<double>(param_map.at("a"));
+            double batch_integral = batch_tree->get_integral_and_error().first;
+            std::cout << "batch a = " << a << ": " << batch_integral << ", " << batch_tree->node_count() << " nodes\n";
+            if (std::abs(batch_integral - 1.0 / (1.0 - a)) > 1e-12 || batch_tree->node_count() != 1) {
+                std::cout << "tanh-sinh batch failed" << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
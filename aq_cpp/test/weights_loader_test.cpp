@@ -1,5 +1,8 @@
 #include <iostream>
+#include <chrono>
+#include <filesystem>
 #include "weights_loader.hpp"
+#include "json_sax_loader.hpp"
 
 int main() {
     try {
@@ -54,6 +57,65 @@ int main() {
     }
     std::cout << std::endl;  
 
+//   Indexed store: only the requested orders are decoded, and every loader on the same file shares them.
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+        WeightsLoader lazy_n1("../model_json/laguerre.json");
+        WeightsLoader lazy_n2("../model_json/laguerre.json");
+        auto rule_a = lazy_n1.getRule(40);
+        auto rule_b = lazy_n2.getRule(100);
+        auto stop = std::chrono::high_resolution_clock::now();
+        std::cout << "Indexed load + orders 40, 100: "
+                  << std::chrono::duration<double, std::milli>(stop - start).count() << " ms" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        WeightsLoader eager;
+        JsonSaxLoader::load_weights("../model_json/laguerre.json", eager);
+        stop = std::chrono::high_resolution_clock::now();
+        std::cout << "Eager load of all " << eager.getNMax() << " orders: "
+                  << std::chrono::duration<double, std::milli>(stop - start).count() << " ms" << std::endl;
+
+        bool shared = lazy_n1.getRule(100) == rule_b;                   // same decoded copy, not a new one
+        bool same = eager.getNodes(100) == lazy_n1.getNodes(100) && eager.getWeights(40) == rule_a->weights;
+        WeightsLoader copy = lazy_n1;                                    // copies share the index too
+        bool copy_shared = copy.getRule(40) == rule_a;
+        std::cout << "Method: " << lazy_n1.getMethod() << ", n_max: " << lazy_n1.getNMax()
+                  << ", has order 300: " << lazy_n1.hasOrder(300) << ", has order 301: " << lazy_n1.hasOrder(301) << std::endl;
+        std::cout << "Shared rule: " << shared << ", copy shares: " << copy_shared << ", matches eager load: " << same << std::endl;
+        if (!shared || !copy_shared || !same) return 1;
+
+        // a file rewritten while loaders come and go (as the lookup server reloads): the registry does not grow
+        std::size_t registered = RuleIndex::registered();
+        for (int i = 0; i < 5; ++i) {
+            std::ofstream("rules_rewritten.json") << "{\"method\": \"Legendre\", \"n_max\": 1, \"n\": {\"1\": {\"0\": [0.0], \"1\": [2.0]}}}";
+            std::filesystem::last_write_time("rules_rewritten.json", std::filesystem::file_time_type::clock::now() + std::chrono::seconds(i));
+            WeightsLoader rewritten("rules_rewritten.json");
+            if (rewritten.getWeights(1) != std::vector<double>{2.0}) return 1;
+        }
+        std::cout << "Registry entries: " << registered << " before, " << RuleIndex::registered() << " after 5 rewrites" << std::endl;
+        if (RuleIndex::registered() > registered + 1) return 1;   // only the last, expired entry is left until the next open
+
+        // rewritten under a live index: an order not decoded yet is refused instead of read at the old offsets
+        std::ofstream("rules_rewritten.json") << "{\"method\": \"Legendre\", \"n_max\": 2, \"n\": {\"1\": {\"0\": [0.0], \"1\": [2.0]}, "
+                                                 "\"2\": {\"0\": [-0.5773502691896257, 0.5773502691896257], \"1\": [1.0, 1.0]}}}";
+        WeightsLoader live("rules_rewritten.json");
+        std::ofstream("rules_rewritten.json") << "{\"method\": \"Legendre\", \"n_max\": 2, \"n\": {\"2\": {\"0\": [-0.5773502691896257, 0.5773502691896257], "
+                                                 "\"1\": [1.0, 1.0]}, \"1\": {\"0\": [0.0], \"1\": [2.0]}}}";
+        std::filesystem::last_write_time("rules_rewritten.json", std::filesystem::file_time_type::clock::now() + std::chrono::seconds(10));
+        bool refused = false;
+        try {
+            live.getRule(2);
+        } catch (const std::runtime_error& e) {
+            refused = true;
+            std::cout << "Stale index: " << e.what() << std::endl;
+        }
+        WeightsLoader reopened("rules_rewritten.json");
+        if (!refused || reopened.getWeights(2) != std::vector<double>{1.0, 1.0} || reopened.getWeights(1) != std::vector<double>{2.0}) return 1;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     return 0;
 }
 
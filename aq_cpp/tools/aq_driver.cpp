@@ -0,0 +1,291 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <filesystem>
+#include "adaptive_gauss_tree.hpp"
+#include "adaptive_gauss_batch.hpp"
+#include "integrand_registry.hpp"
+#include "trace.hpp"
+#include "summation.hpp"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Sharded batch training on one machine.
+//
+//   aq_driver <config.json>                                         coordinator
+//   aq_driver --worker <config.json> <shard.json> <output.json>     one shard (started by the coordinator)
+//
+// The coordinator expands the parameter grid, estimates the cost of every combination with a cheap pilot tree,
+// splits the grid into balanced shards (longest processing time first), runs one worker process per shard and
+// merges the shard files into a single batch file.  See README_TOOLS.md for the configuration keys.
+
+struct DriverConfig {
+    std::string integrand = "polylog";
+    double lower = 0.0, upper = 1.0, tol = 1e-12;
+    int min_depth = 2, max_depth = 20, n1 = 100, n2 = 150;
+    double alphaA = 0.0, alphaB = 0.0;
+    bool a_singular = true, b_singular = false;
+    std::string legendre = "../model_json/legendre.json", laguerre = "../model_json/laguerre.json";
+    ParamCollection parameters;
+    std::string name = "Project", author = "Author", description = "project description", reference = "references", version = "1.0";
+    int workers = 0;                  // 0 = std::thread::hardware_concurrency()
+    bool pilot = true;
+    double pilot_tol = 1e-8;          // pilot trees: low orders and a loose tolerance, so that the depth they
+    int pilot_n1 = 10, pilot_n2 = 20;  // reach reflects how hard the combination is
+    int pilot_max_depth = 10;
+    std::string work_dir = "aq_shards";
+    std::string output = "batch.json";
+    bool compact = false;
+    bool write_roots = false;
+    std::string trace;                // Chrome trace of the whole run (coordinator and workers); empty = off
+    bool trace_depth_levels = false;
+    Summation::Method summation = Summation::Method::Naive;   // of the shard batches, kept in their headers (summation.hpp)
+};
+
+DriverConfig read_config(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Error opening config file: " + filename);
+    }
+    json data = json::parse(file);
+    DriverConfig config;
+    config.integrand = data.value("integrand", config.integrand);
+    config.lower = data.value("lower", config.lower);
+    config.upper = data.value("upper", config.upper);
+    config.tol = data.value("tol", config.tol);
+    config.min_depth = data.value("min_depth", config.min_depth);
+    config.max_depth = data.value("max_depth", config.max_depth);
+    config.n1 = data.value("n1", config.n1);
+    config.n2 = data.value("n2", config.n2);
+    config.alphaA = data.value("alphaA", config.alphaA);
+    config.alphaB = data.value("alphaB", config.alphaB);
+    config.a_singular = data.value("a_singular", config.a_singular);
+    config.b_singular = data.value("b_singular", config.b_singular);
+    config.legendre = data.value("legendre", config.legendre);
+    config.laguerre = data.value("laguerre", config.laguerre);
+    config.name = data.value("name", config.name);
+    config.author = data.value("author", config.author);
+    config.description = data.value("description", config.description);
+    config.reference = data.value("reference", config.reference);
+    config.version = data.value("version", config.version);
+    config.workers = data.value("workers", config.workers);
+    config.pilot = data.value("pilot", config.pilot);
+    config.pilot_tol = data.value("pilot_tol", config.pilot_tol);
+    config.pilot_n1 = data.value("pilot_n1", config.pilot_n1);
+    config.pilot_n2 = data.value("pilot_n2", config.pilot_n2);
+    config.pilot_max_depth = data.value("pilot_max_depth", config.pilot_max_depth);
+    config.work_dir = data.value("work_dir", config.work_dir);
+    config.output = data.value("output", config.output);
+    config.compact = data.value("compact", config.compact);
+    config.write_roots = data.value("write_roots", config.write_roots);
+    config.trace = data.value("trace", config.trace);
+    config.trace_depth_levels = data.value("trace_depth_levels", config.trace_depth_levels);
+    config.summation = Summation::from_string(data.value("summation", Summation::to_string(config.summation)));
+
+    // "parameters": {"s": [2, 3], "z": [0.1, 0.5], "label": ["a", "b"]}.  An array of whole numbers is an int
+    // parameter, an array with any fractional number (1.0 counts) a double parameter.
+    if (!data.contains("parameters") || !data["parameters"].is_object()) {
+        throw std::runtime_error("Config needs a \"parameters\" object: " + filename);
+    }
+    config.parameters = AdaptiveGaussTreeBatch::parameters_from_json(data["parameters"]);
+    if (config.workers <= 0) config.workers = std::max(1u, std::thread::hardware_concurrency());
+    return config;
+}
+
+// Pilot cost: node count of a cheap tree for the combination (uniform when the pilot is off).  Every node costs
+// the same number of integrand evaluations, so the node count is proportional to the work.
+std::vector<double> estimate_costs(const DriverConfig& config, const std::vector<ParamMap>& grid,
+                                   const IntegrandRegistry::Integrand& func, const WeightsLoader& legendre, const WeightsLoader& laguerre) {
+    std::vector<double> costs(grid.size(), 1.0);
+    if (!config.pilot) return costs;
+    Trace::Span span("driver/pilot", "driver");
+    span.arg("combinations", grid.size());
+    int pilot_min_depth = std::min(config.min_depth, config.pilot_max_depth);
+    for (size_t i = 0; i < grid.size(); ++i) {
+        AdaptiveGaussTree pilot(func, config.lower, config.upper, config.pilot_tol, pilot_min_depth, config.pilot_max_depth,
+            config.pilot_n1, config.pilot_n2, config.alphaA, config.alphaB, config.a_singular, config.b_singular,
+            legendre, legendre, laguerre, laguerre, grid[i]);
+        costs[i] = static_cast<double>(pilot.node_count());
+    }
+    return costs;
+}
+
+// Longest processing time first: hand the most expensive remaining combination to the least loaded shard
+std::vector<std::vector<size_t>> partition(const std::vector<double>& costs, int shards, std::vector<double>& loads) {
+    std::vector<size_t> order(costs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+    using Load = std::pair<double, int>;
+    std::priority_queue<Load, std::vector<Load>, std::greater<Load>> heap;
+    for (int s = 0; s < shards; ++s) heap.push({0.0, s});
+    std::vector<std::vector<size_t>> assignment(shards);
+    loads.assign(shards, 0.0);
+    for (size_t index : order) {
+        auto [load, shard] = heap.top();
+        heap.pop();
+        assignment[shard].push_back(index);
+        loads[shard] = load + costs[index];
+        heap.push({loads[shard], shard});
+    }
+    return assignment;
+}
+
+// Trace of one worker, imported by the coordinator
+std::string worker_trace_file(const std::string& output_file) {
+    return output_file.substr(0, output_file.size() - 5) + "_trace.json";   // shard_<i>_out.json -> shard_<i>_out_trace.json
+}
+
+int run_worker(const std::string& config_file, const std::string& shard_file, const std::string& output_file) {
+    DriverConfig config = read_config(config_file);
+    bool trace = !config.trace.empty() && !Trace::enabled();   // in-process shards (Windows) use the coordinator's trace
+    if (trace) Trace::start(worker_trace_file(output_file), config.trace_depth_levels);
+    std::ifstream file(shard_file);
+    if (!file) {
+        throw std::runtime_error("Error opening shard file: " + shard_file);
+    }
+    json shard = json::parse(file);
+    std::vector<ParamMap> combinations;
+    for (const auto& entry : shard["combinations"]) combinations.push_back(AdaptiveGaussTreeBatch::combination_from_json(entry));
+
+    WeightsLoader legendre(config.legendre);
+    WeightsLoader laguerre(config.laguerre);
+    std::string message = "Shard " + std::to_string(shard["shard"].get<int>() + 1) + " of " + std::to_string(shard["shards"].get<int>())
+        + ": " + std::to_string(combinations.size()) + " combinations";
+    AdaptiveGaussTreeBatch batch(IntegrandRegistry::get(config.integrand),
+        config.lower, config.upper, config.tol, config.min_depth, config.max_depth, config.n1, config.n2,
+        config.alphaA, config.alphaB, config.a_singular, config.b_singular,
+        legendre, legendre, laguerre, laguerre, combinations,
+        config.name, config.author, config.description, config.reference, config.version, message,
+        {}, {}, nullptr, config.summation);
+    batch.save_to_json(output_file, true, config.write_roots, false, true);
+    if (trace) Trace::stop();
+    return 0;
+}
+
+std::string self_executable(const char* argv0) {
+    std::error_code ec;
+    auto exe = std::filesystem::read_symlink("/proc/self/exe", ec);
+    return ec ? std::string(argv0) : exe.string();
+}
+
+// One process per shard; returns when all of them finished
+void run_workers(const DriverConfig& config, const std::string& config_file, const char* argv0,
+                 const std::vector<std::string>& shard_files, const std::vector<std::string>& outputs) {
+    Trace::Span span("driver/workers", "driver");
+    span.arg("shards", outputs.size());
+#ifndef _WIN32
+    std::string exe = self_executable(argv0);
+    std::vector<pid_t> pids;
+    for (size_t s = 0; s < outputs.size(); ++s) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            // the shards already started would go on writing files nobody collects
+            for (pid_t started : pids) kill(started, SIGTERM);
+            for (pid_t started : pids) waitpid(started, nullptr, 0);
+            throw std::runtime_error("fork() failed for shard " + std::to_string(s) + "; the " + std::to_string(pids.size())
+                                     + " shard(s) already started were stopped");
+        }
+        if (pid == 0) {
+            execl(exe.c_str(), exe.c_str(), "--worker", config_file.c_str(), shard_files[s].c_str(), outputs[s].c_str(), (char*)nullptr);
+            std::perror("execl");
+            _exit(127);
+        }
+        pids.push_back(pid);
+    }
+    int failed = 0;
+    for (size_t s = 0; s < outputs.size(); ++s) {
+        int status = 0;
+        waitpid(pids[s], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "shard " << s << " failed (status " << status << ")" << std::endl;
+            ++failed;
+        }
+    }
+    if (failed) {
+        throw std::runtime_error(std::to_string(failed) + " shard(s) failed; partial outputs are in " + config.work_dir);
+    }
+#else
+    // No fork/exec: run the shards one after another in this process
+    (void)argv0;
+    for (size_t s = 0; s < outputs.size(); ++s) run_worker(config_file, shard_files[s], outputs[s]);
+#endif
+}
+
+int run_coordinator(const std::string& config_file, const char* argv0) {
+    auto start = std::chrono::steady_clock::now();
+    DriverConfig config = read_config(config_file);
+    if (!config.trace.empty()) Trace::start(config.trace, config.trace_depth_levels);
+    IntegrandRegistry::Integrand func = IntegrandRegistry::get(config.integrand);
+    std::vector<ParamMap> grid = AdaptiveGaussTreeBatch::expand_grid(config.parameters);
+    int shards = std::min<int>(config.workers, grid.size());
+
+    WeightsLoader legendre(config.legendre);
+    WeightsLoader laguerre(config.laguerre);
+    std::vector<double> costs = estimate_costs(config, grid, func, legendre, laguerre);
+    std::vector<double> loads;
+    auto assignment = partition(costs, shards, loads);
+    double pilot_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << grid.size() << " combinations, " << shards << " shards, pilot " << pilot_s << " s\n";
+
+    std::filesystem::create_directories(config.work_dir);
+    std::vector<std::string> shard_files, outputs;
+    for (int s = 0; s < shards; ++s) {
+        json shard;
+        shard["shard"] = s;
+        shard["shards"] = shards;
+        shard["estimated_cost"] = loads[s];
+        shard["combinations"] = json::array();
+        for (size_t index : assignment[s]) shard["combinations"].push_back(AdaptiveGaussTreeBatch::combination_to_json(grid[index]));
+        shard_files.push_back((std::filesystem::path(config.work_dir) / ("shard_" + std::to_string(s) + ".json")).string());
+        outputs.push_back((std::filesystem::path(config.work_dir) / ("shard_" + std::to_string(s) + "_out.json")).string());
+        std::ofstream(shard_files.back()) << shard.dump(4);
+        std::cout << "  shard " << s << ": " << assignment[s].size() << " combinations, estimated cost " << loads[s] << "\n";
+    }
+
+    run_workers(config, config_file, argv0, shard_files, outputs);
+    if (!config.trace.empty()) {
+        for (const auto& output : outputs) {
+            if (std::filesystem::exists(worker_trace_file(output))) Trace::import_file(worker_trace_file(output));
+        }
+    }
+
+    AdaptiveGaussTreeBatch merged = AdaptiveGaussTreeBatch::merge_files(func, outputs, shards);
+    double total_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    merged.add_update_log("aq_driver: " + std::to_string(grid.size()) + " combinations in " + std::to_string(shards)
+        + " shards from " + config_file + " (" + std::to_string(total_s) + " s)");
+    merged.save_to_json(config.output, true, config.write_roots, false, config.compact);
+    std::cout << "wrote " << merged.getCollection().size() << " trees to " << config.output << " in " << total_s << " s\n";
+    if (!config.trace.empty()) {
+        Trace::stop();
+        std::cout << "wrote trace " << config.trace << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        if (argc == 5 && std::string(argv[1]) == "--worker") {
+            return run_worker(argv[2], argv[3], argv[4]);
+        }
+        if (argc == 2) {
+            return run_coordinator(argv[1], argv[0]);
+        }
+        std::cerr << "usage: " << argv[0] << " <config.json>\n"
+                  << "       " << argv[0] << " --worker <config.json> <shard.json> <output.json>" << std::endl;
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,225 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include "adaptive_gauss_tree.hpp"
+#include "adaptive_gauss_batch.hpp"
+#include "integrand_registry.hpp"
+
+// Accuracy and performance regression check against a stored reference table (`make regress`).
+//
+//   aq_regress <config.json> [--record | --record-counts]
+//
+// Rebuilds every tree of the reference batch file with the settings stored in its header and compares integral and
+// error estimate with the stored values.  The numbers of integrand evaluations and nodes, which do not depend on the 
+// machine, are compared with the counts file kept in the repository; a missing counts file is a failure, and 
+// --record-counts rewrites it after an intended change.  The build time (median of `reps` builds) is compared with the
+// local, machine specific baseline when there is one; only --record writes it.  Exits with 1 if any check fails.  See
+// README_TOOLS.md for the configuration keys.
+
+struct RegressConfig {
+    std::string integrand = "polylog";
+    std::string reference_file = "../model_json/polylogs.json";
+    double lower = 0.0, upper = 1.0, alphaA = 0.0, alphaB = 0.0;   // not stored in batch files
+    std::string legendre = "../model_json/legendre.json", laguerre = "../model_json/laguerre.json";
+    double integral_abs_tol = 1e-13, integral_rel_tol = 1e-12;
+    double error_abs_tol = 1e-13, error_rel_tol = 1e-6;
+    std::string counts = "tools/regress_polylogs_counts.json";   // evaluations and nodes, in the repository
+    std::string baseline = "regress_baseline.json";              // build time, local
+    double max_slowdown = 0.25;            // fraction of the baseline build time
+    double max_evaluation_increase = 0.0;  // fraction of the committed evaluations
+    double max_node_increase = 0.0;        // fraction of the committed nodes
+    int reps = 5;
+};
+
+RegressConfig read_config(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Error opening config file: " + filename);
+    }
+    json data = json::parse(file);
+    RegressConfig config;
+    config.integrand = data.value("integrand", config.integrand);
+    config.reference_file = data.value("reference", config.reference_file);
+    config.lower = data.value("lower", config.lower);
+    config.upper = data.value("upper", config.upper);
+    config.alphaA = data.value("alphaA", config.alphaA);
+    config.alphaB = data.value("alphaB", config.alphaB);
+    config.legendre = data.value("legendre", config.legendre);
+    config.laguerre = data.value("laguerre", config.laguerre);
+    config.integral_abs_tol = data.value("integral_abs_tol", config.integral_abs_tol);
+    config.integral_rel_tol = data.value("integral_rel_tol", config.integral_rel_tol);
+    config.error_abs_tol = data.value("error_abs_tol", config.error_abs_tol);
+    config.error_rel_tol = data.value("error_rel_tol", config.error_rel_tol);
+    config.counts = data.value("counts", config.counts);
+    config.baseline = data.value("baseline", config.baseline);
+    config.max_slowdown = data.value("max_slowdown", config.max_slowdown);
+    config.max_evaluation_increase = data.value("max_evaluation_increase", config.max_evaluation_increase);
+    config.max_node_increase = data.value("max_node_increase", config.max_node_increase);
+    config.reps = std::max(1, data.value("reps", config.reps));
+    return config;
+}
+
+// Settings of the reference build, from the scalar header of the batch file
+json read_header(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Error opening reference file: " + filename);
+    }
+    json data = json::parse(file);
+    for (const char* key : {"tol", "min_depth", "max_depth", "n1", "n2", "a_singular", "b_singular"}) {
+        if (!data.contains(key)) {
+            throw std::runtime_error("Reference file has no \"" + std::string(key) + "\": " + filename);
+        }
+    }
+    data.erase("parameters");
+    return data;
+}
+
+bool within(double value, double expected, double abs_tol, double rel_tol) {
+    return std::abs(value - expected) <= abs_tol + rel_tol * std::abs(expected);
+}
+
+std::string now_timestamp() {
+    std::time_t now = std::time(nullptr);
+    char timestamp[20];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+    return timestamp;
+}
+
+int main(int argc, char* argv[]) {
+    bool record = argc == 3 && std::string(argv[2]) == "--record";
+    bool record_counts = argc == 3 && std::string(argv[2]) == "--record-counts";
+    if (argc != 2 && !record && !record_counts) {
+        std::cerr << "usage: " << argv[0] << " <config.json> [--record | --record-counts]" << std::endl;
+        return 2;
+    }
+    try {
+        RegressConfig config = read_config(argv[1]);
+        IntegrandRegistry::Integrand integrand = IntegrandRegistry::get(config.integrand);
+        long long evaluations = 0;
+        std::function<double(ParamMap, double)> counted = [&](ParamMap p, double t) {
+            ++evaluations;
+            return integrand(std::move(p), t);
+        };
+
+        json header = read_header(config.reference_file);
+        AdaptiveGaussTreeBatch reference(integrand, config.reference_file);
+        std::vector<ParamMap> combinations;
+        for (const auto& [param_map, tree] : reference.getCollection()) combinations.push_back(param_map);
+        WeightsLoader legendre(config.legendre);
+        WeightsLoader laguerre(config.laguerre);
+        std::cout << "reference " << config.reference_file << ": " << combinations.size() << " trees, tol "
+                  << header["tol"].get<double>() << ", n1/n2 " << header["n1"] << "/" << header["n2"] << std::endl;
+
+        // Rebuild reps times; the first build is the one checked, the median time is the one compared
+        std::vector<double> seconds;
+        std::unique_ptr<AdaptiveGaussTreeBatch> rebuilt;
+        long long build_evaluations = 0;
+        for (int rep = 0; rep < config.reps; ++rep) {
+            evaluations = 0;
+            auto start = std::chrono::steady_clock::now();
+            auto batch = std::make_unique<AdaptiveGaussTreeBatch>(counted, config.lower, config.upper, header["tol"].get<double>(),
+                header["min_depth"].get<int>(), header["max_depth"].get<int>(), header["n1"].get<int>(), header["n2"].get<int>(),
+                config.alphaA, config.alphaB, header["a_singular"].get<bool>(), header["b_singular"].get<bool>(),
+                legendre, legendre, laguerre, laguerre, combinations);
+            seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            if (!rebuilt) {
+                rebuilt = std::move(batch);
+                build_evaluations = evaluations;
+            }
+        }
+        std::sort(seconds.begin(), seconds.end());
+        double median_seconds = seconds[seconds.size() / 2];
+
+        // --- accuracy ---------------------------------------------------------------------------------------
+        int failures = 0;
+        size_t nodes = 0;
+        double worst_integral = 0.0, worst_error = 0.0;
+        for (const auto& [param_map, tree] : reference.getCollection()) {
+            const AdaptiveGaussTree& fresh = *rebuilt->getCollection().at(param_map);
+            nodes += fresh.node_count();
+            auto [integral, error] = fresh.get_integral_and_error();
+            auto [stored_integral, stored_error] = tree->get_integral_and_error();
+            worst_integral = std::max(worst_integral, std::abs(integral - stored_integral));
+            worst_error = std::max(worst_error, std::abs(error - stored_error));
+            bool integral_ok = within(integral, stored_integral, config.integral_abs_tol, config.integral_rel_tol);
+            bool error_ok = within(error, stored_error, config.error_abs_tol, config.error_rel_tol);
+            if (!integral_ok || !error_ok) {
+                ++failures;
+                std::cout << std::setprecision(17) << "  FAIL " << param_map << " integral " << integral << " (stored " << stored_integral
+                          << "), error " << error << " (stored " << stored_error << ")" << std::setprecision(6) << std::endl;
+            }
+        }
+        std::cout << "accuracy: " << failures << " of " << combinations.size() << " trees outside tolerance; worst |dI| = "
+                  << worst_integral << ", worst |d error| = " << worst_error << std::endl;
+
+        // --- performance ------------------------------------------------------------------------------------
+        std::cout << "build: " << median_seconds << " s (median of " << config.reps << "), " << build_evaluations
+                  << " evaluations, " << nodes << " nodes" << std::endl;
+        // machine independent: evaluation and node counts against the committed counts file
+        if (record_counts) {
+            json counts = {{"timestamp", now_timestamp()}, {"reference", config.reference_file}, {"trees", combinations.size()},
+                           {"evaluations", build_evaluations}, {"nodes", nodes}};
+            std::ofstream(config.counts) << counts.dump(4) << std::endl;
+            std::cout << "recorded counts " << config.counts << " (commit it with the change)" << std::endl;
+        } else if (!std::filesystem::exists(config.counts)) {
+            ++failures;
+            std::cout << "  FAIL no counts file " << config.counts << " (write it with --record-counts)" << std::endl;
+        } else {
+            std::ifstream file(config.counts);
+            json counts = json::parse(file);
+            long long base_evaluations = counts["evaluations"].get<long long>();
+            long long base_nodes = counts["nodes"].get<long long>();
+            double increase = static_cast<double>(build_evaluations - base_evaluations) / base_evaluations;
+            double node_increase = static_cast<double>(static_cast<long long>(nodes) - base_nodes) / base_nodes;
+            std::cout << std::fixed << std::setprecision(1) << "against counts " << config.counts << ": evaluations " << std::showpos
+                      << 100.0 * increase << " %, nodes " << 100.0 * node_increase << " %" << std::noshowpos << std::defaultfloat << std::endl;
+            if (counts["trees"].get<std::size_t>() != combinations.size()) {
+                ++failures;
+                std::cout << "  FAIL counts were recorded for " << counts["trees"] << " trees" << std::endl;
+            }
+            if (increase > config.max_evaluation_increase) {
+                ++failures;
+                std::cout << "  FAIL evaluations exceed the counts file by more than " << 100.0 * config.max_evaluation_increase << " %" << std::endl;
+            }
+            if (node_increase > config.max_node_increase) {
+                ++failures;
+                std::cout << "  FAIL nodes exceed the counts file by more than " << 100.0 * config.max_node_increase << " %" << std::endl;
+            }
+        }
+
+        // machine specific: build time against the local baseline, when one was recorded
+        if (record) {
+            json baseline = {{"timestamp", now_timestamp()}, {"reference", config.reference_file}, {"trees", combinations.size()},
+                             {"seconds", median_seconds}};
+            std::ofstream(config.baseline) << baseline.dump(4) << std::endl;
+            std::cout << "recorded time baseline " << config.baseline << std::endl;
+        } else if (!std::filesystem::exists(config.baseline)) {
+            std::cout << "no local time baseline " << config.baseline << " (record one with --record); build time not checked" << std::endl;
+        } else {
+            std::ifstream file(config.baseline);
+            json baseline = json::parse(file);
+            double base_seconds = baseline["seconds"].get<double>();
+            double slowdown = (median_seconds - base_seconds) / base_seconds;
+            std::cout << std::fixed << std::setprecision(1) << "against time baseline " << config.baseline << " (" << baseline["timestamp"].get<std::string>()
+                      << "): " << std::showpos << 100.0 * slowdown << " %" << std::noshowpos << std::defaultfloat << std::endl;
+            if (slowdown > config.max_slowdown) {
+                ++failures;
+                std::cout << "  FAIL build time exceeds the baseline by more than " << 100.0 * config.max_slowdown << " %" << std::endl;
+            }
+        }
+
+        std::cout << (failures ? "REGRESSION" : "PASS") << std::endl;
+        return failures ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "lookup_service.hpp"
+
+#ifndef _WIN32
+#include <csignal>
+#include <pthread.h>
+#endif
+
+// Lookup server for batch files (see lookup_service.hpp).
+//
+//   aq_server [--poll <seconds>] <socket> <batch file>...
+//
+// Loads every batch file once, then answers LookupClient requests on the Unix domain socket until SIGINT or SIGTERM.
+// A file that changes on disk is reloaded (checked every --poll seconds, default 1).  See README_TOOLS.md.
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    double poll = 1.0;
+    if (args.size() >= 2 && args[0] == "--poll") {
+        poll = std::stod(args[1]);
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    if (args.size() < 2) {
+        std::cerr << "usage: " << argv[0] << " [--poll <seconds>] <socket> <batch file>..." << std::endl;
+        return 2;
+    }
+#ifndef _WIN32
+    // the signals are taken by sigwait below; blocked before the server starts its threads, which inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+    try {
+        LookupServer server(args[0], std::vector<std::string>(args.begin() + 1, args.end()), poll);
+        for (const auto& [name, trees] : server.tables()) std::cout << name << ": " << trees << " trees" << std::endl;
+        std::cout << "serving on " << args[0] << std::endl;
+#ifndef _WIN32
+        int signal = 0;
+        sigwait(&signals, &signal);
+        std::cout << "stopping (signal " << signal << "), " << server.reloads() << " reloads" << std::endl;
+#endif
+        server.stop();
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include "adaptive_gauss_tree.hpp"
+#include "adaptive_gauss_batch.hpp"
+#include "integrand_registry.hpp"
+
+// Order tuning for one integrand family.
+//
+//   aq_tune <config.json>
+//
+// Builds a sample of the parameter grid with every candidate (n1, n2, min_depth, max_depth) at the production
+// tolerance and compares each integral with a high precision reference build.  The report lists the total integrand
+// evaluations, the build time and the worst error of every candidate, marks the Pareto front (no other candidate is
+// both cheaper and more accurate) and recommends the cheapest candidate whose worst error meets `target_error`.
+// See README_TOOLS.md for the configuration keys.
+
+struct Candidate {
+    int n1, n2, min_depth, max_depth;
+};
+
+struct TuneConfig {
+    std::string integrand = "polylog";
+    double lower = 0.0, upper = 1.0, tol = 1e-12;
+    double alphaA = 0.0, alphaB = 0.0;
+    bool a_singular = true, b_singular = false;
+    std::string legendre = "../model_json/legendre.json", laguerre = "../model_json/laguerre.json";
+    ParamCollection parameters;
+    int sample = 12;                            // combinations taken evenly spaced from the grid (0 = all)
+    std::vector<std::pair<int, int>> orders = {{10, 20}, {20, 40}, {40, 100}, {60, 120}, {100, 150}};
+    std::vector<int> min_depths = {2};
+    std::vector<int> max_depths = {20};
+    double target_error = 0.0;                  // 0 = tol
+    Candidate reference = {150, 300, 2, 20};    // high order reference build ...
+    double reference_tol = 1e-14;               // ... at a tighter tolerance
+    std::string output = "aq_tune.json";
+};
+
+TuneConfig read_config(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Error opening config file: " + filename);
+    }
+    json data = json::parse(file);
+    TuneConfig config;
+    config.integrand = data.value("integrand", config.integrand);
+    config.lower = data.value("lower", config.lower);
+    config.upper = data.value("upper", config.upper);
+    config.tol = data.value("tol", config.tol);
+    config.alphaA = data.value("alphaA", config.alphaA);
+    config.alphaB = data.value("alphaB", config.alphaB);
+    config.a_singular = data.value("a_singular", config.a_singular);
+    config.b_singular = data.value("b_singular", config.b_singular);
+    config.legendre = data.value("legendre", config.legendre);
+    config.laguerre = data.value("laguerre", config.laguerre);
+    config.sample = data.value("sample", config.sample);
+    config.orders = data.value("orders", config.orders);
+    config.min_depths = data.value("min_depth", config.min_depths);
+    config.max_depths = data.value("max_depth", config.max_depths);
+    config.target_error = data.value("target_error", config.target_error);
+    if (data.contains("reference")) {
+        const json& reference = data["reference"];
+        config.reference.n1 = reference.value("n1", config.reference.n1);
+        config.reference.n2 = reference.value("n2", config.reference.n2);
+        config.reference.min_depth = reference.value("min_depth", config.reference.min_depth);
+        config.reference.max_depth = reference.value("max_depth", config.reference.max_depth);
+        config.reference_tol = reference.value("tol", config.reference_tol);
+    }
+    config.output = data.value("output", config.output);
+
+    if (!data.contains("parameters") || !data["parameters"].is_object()) {
+        throw std::runtime_error("Config needs a \"parameters\" object: " + filename);
+    }
+    config.parameters = AdaptiveGaussTreeBatch::parameters_from_json(data["parameters"]);
+    if (config.target_error <= 0.0) config.target_error = config.tol;
+    return config;
+}
+
+// Evenly spaced over the (sorted) grid, so that every region of the parameter space is represented
+std::vector<ParamMap> sample_grid(const std::vector<ParamMap>& grid, int sample) {
+    if (sample <= 0 || static_cast<size_t>(sample) >= grid.size()) return grid;
+    std::vector<ParamMap> result;
+    for (int i = 0; i < sample; ++i) {
+        result.push_back(grid[static_cast<size_t>(i) * (grid.size() - 1) / std::max(1, sample - 1)]);
+    }
+    return result;
+}
+
+struct TuneResult {
+    Candidate candidate;
+    long long evaluations = 0;       // integrand calls, n1 + n2 per node
+    size_t nodes = 0;
+    double seconds = 0.0;
+    double max_error = 0.0;          // worst |integral - reference|
+    double max_relative_error = 0.0;
+    double max_estimated_error = 0.0;   // worst error the tree reports about itself
+    int failures = 0;                // combinations whose error exceeds target_error
+    bool pareto = false;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <config.json>" << std::endl;
+        return 2;
+    }
+    try {
+        TuneConfig config = read_config(argv[1]);
+        IntegrandRegistry::Integrand func = IntegrandRegistry::get(config.integrand);
+        WeightsLoader legendre(config.legendre);
+        WeightsLoader laguerre(config.laguerre);
+        std::vector<ParamMap> grid = AdaptiveGaussTreeBatch::expand_grid(config.parameters);
+        std::vector<ParamMap> sample = sample_grid(grid, config.sample);
+
+        auto build = [&](const Candidate& c, double tol, const ParamMap& args) {
+            return AdaptiveGaussTree(func, config.lower, config.upper, tol, c.min_depth, c.max_depth, c.n1, c.n2,
+                config.alphaA, config.alphaB, config.a_singular, config.b_singular,
+                legendre, legendre, laguerre, laguerre, args);
+        };
+
+        std::cout << "reference (" << config.reference.n1 << "/" << config.reference.n2 << ", tol " << config.reference_tol
+                  << ") for " << sample.size() << " of " << grid.size() << " combinations" << std::endl;
+        std::vector<double> reference;
+        for (const auto& args : sample) reference.push_back(build(config.reference, config.reference_tol, args).get_integral_and_error().first);
+
+        std::vector<TuneResult> results;
+        for (const auto& [n1, n2] : config.orders) {
+            for (int min_depth : config.min_depths) {
+                for (int max_depth : config.max_depths) {
+                    if (min_depth > max_depth) continue;
+                    TuneResult r;
+                    r.candidate = {n1, n2, min_depth, max_depth};
+                    for (size_t i = 0; i < sample.size(); ++i) {
+                        auto start = std::chrono::steady_clock::now();
+                        AdaptiveGaussTree tree = build(r.candidate, config.tol, sample[i]);
+                        r.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                        auto [integral, estimated] = tree.get_integral_and_error();
+                        double error = std::abs(integral - reference[i]);
+                        r.nodes += tree.node_count();
+                        r.evaluations += static_cast<long long>(tree.node_count()) * (n1 + n2);
+                        r.max_error = std::max(r.max_error, error);
+                        if (reference[i] != 0.0) r.max_relative_error = std::max(r.max_relative_error, error / std::abs(reference[i]));
+                        r.max_estimated_error = std::max(r.max_estimated_error, estimated);
+                        if (!(error <= config.target_error)) ++r.failures;
+                    }
+                    results.push_back(r);
+                }
+            }
+        }
+
+        // Pareto front in (evaluations, max_error): nothing else is at least as good in both and better in one
+        for (auto& r : results) {
+            r.pareto = std::none_of(results.begin(), results.end(), [&](const TuneResult& o) {
+                return o.evaluations <= r.evaluations && o.max_error <= r.max_error
+                    && (o.evaluations < r.evaluations || o.max_error < r.max_error);
+            });
+        }
+        // Cheapest candidate that meets the target everywhere; otherwise the most accurate one
+        const TuneResult* best = nullptr;
+        for (const auto& r : results) {
+            if (r.failures == 0 && (!best || r.evaluations < best->evaluations
+                                    || (r.evaluations == best->evaluations && r.seconds < best->seconds))) best = &r;
+        }
+        bool target_met = best != nullptr;
+        if (!best) {
+            for (const auto& r : results) {
+                if (!best || r.max_error < best->max_error) best = &r;
+            }
+        }
+        if (!best) {
+            throw std::runtime_error("No candidates: check \"orders\", \"min_depth\" and \"max_depth\".");
+        }
+
+        std::cout << "\n     n1/n2   depth   evaluations    time [s]     max error   max est. error  fail  pareto\n";
+        for (const auto& r : results) {
+            std::ostringstream orders, depths;
+            orders << r.candidate.n1 << "/" << r.candidate.n2;
+            depths << r.candidate.min_depth << "-" << r.candidate.max_depth;
+            std::cout << std::setw(10) << orders.str() << std::setw(8) << depths.str() << std::setw(14) << r.evaluations
+                      << std::setw(12) << std::fixed << std::setprecision(4) << r.seconds
+                      << std::setw(14) << std::scientific << std::setprecision(2) << r.max_error
+                      << std::setw(17) << r.max_estimated_error << std::setw(6) << r.failures
+                      << std::setw(8) << (r.pareto ? "*" : "") << (&r == best ? "  <- recommended" : "") << std::defaultfloat << "\n";
+        }
+        std::cout << "\nrecommended: n1 = " << best->candidate.n1 << ", n2 = " << best->candidate.n2 << ", min_depth = "
+                  << best->candidate.min_depth << ", max_depth = " << best->candidate.max_depth
+                  << (target_met ? "" : "  (no candidate meets target_error; most accurate shown)") << std::endl;
+
+        json report;
+        report["integrand"] = config.integrand;
+        report["tol"] = config.tol;
+        report["target_error"] = config.target_error;
+        report["reference"] = {{"n1", config.reference.n1}, {"n2", config.reference.n2}, {"min_depth", config.reference.min_depth},
+                               {"max_depth", config.reference.max_depth}, {"tol", config.reference_tol}};
+        report["sample"] = json::array();
+        for (const auto& args : sample) report["sample"].push_back(AdaptiveGaussTreeBatch::combination_to_json(args));
+        report["candidates"] = json::array();
+        for (const auto& r : results) {
+            report["candidates"].push_back({{"n1", r.candidate.n1}, {"n2", r.candidate.n2}, {"min_depth", r.candidate.min_depth},
+                {"max_depth", r.candidate.max_depth}, {"evaluations", r.evaluations}, {"nodes", r.nodes}, {"seconds", r.seconds},
+                {"max_error", r.max_error}, {"max_relative_error", r.max_relative_error},
+                {"max_estimated_error", r.max_estimated_error}, {"failures", r.failures}, {"pareto", r.pareto}});
+        }
+        report["recommended"] = {{"n1", best->candidate.n1}, {"n2", best->candidate.n2}, {"min_depth", best->candidate.min_depth},
+                                 {"max_depth", best->candidate.max_depth}, {"meets_target", target_met}};
+        std::ofstream(config.output) << report.dump(4) << std::endl;
+        std::cout << "wrote " << config.output << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+}
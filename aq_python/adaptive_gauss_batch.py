@@ -202,6 +202,8 @@ class AdaptiveGaussTreeBatch:
             for key, value in d.items():
                 if key == "tree" and isinstance(value, dict):
                     yield {**params, **value}
+                elif key == "stats":
+                    continue  # build statistics written by the C++ code (save_to_json(..., write_stats=True))
                 elif isinstance(value, dict):
                     for sub_key, sub_value in value.items():
                         yield from flatten_results(sub_value, {**params, key: sub_key})
@@ -4,6 +4,40 @@ import numpy as np
 from scipy.special import roots_legendre, roots_laguerre
 from math import factorial
 
+def expand_compact_tree(data):
+    """Expands a leaf-compact tree (as written by the C++ save_to_json with compact=true) into the nested node dictionaries.
+
+    The in-order leaf depths fix the bisection tree; interior integrals and errors are the sums of their children.
+    Trees split at breakpoints carry "leaf_a", the lower bound of every leaf, which then replaces the midpoints.
+    """
+    depths, integrals, errors = data["leaf_depths"], data["integral"], data["error"]
+    methods, method_index = data["methods"], data["method"]
+    leaf_a = data.get("leaf_a")
+    position = [0]
+
+    def expand(a, b, depth, tol):
+        i = position[0]
+        if i >= len(depths) or depths[i] < depth:
+            raise ValueError("Invalid leaf-compact tree: leaf_depths is not a bisection sequence")
+        if depths[i] == depth:
+            position[0] += 1
+            if leaf_a is not None:
+                a, b = leaf_a[i], leaf_a[i + 1] if i + 1 < len(depths) else data["b"]
+            return {"a": a, "b": b, "depth": depth, "tol": tol, "error": errors[i], "integral": integrals[i],
+                    "method": methods[method_index[i]], "left": None, "right": None}
+        mid = (a + b) / 2
+        left = expand(a, mid, depth + 1, tol / 2)
+        right = expand(mid, b, depth + 1, tol / 2)
+        a, b = left["a"], right["b"]
+        method = "Gauss-Laguerre" if "Gauss-Laguerre" in (left["method"], right["method"]) else left["method"]
+        return {"a": a, "b": b, "depth": depth, "tol": tol, "error": left["error"] + right["error"],
+                "integral": left["integral"] + right["integral"], "method": method, "left": left, "right": right}
+
+    root = expand(data["a"], data["b"], 0, data["tol"])
+    if position[0] != len(depths):
+        raise ValueError("Invalid leaf-compact tree: leaves left over after the bisection tree closed")
+    return root
+
 class AdaptiveGaussTree:
     class Node:
         """Represents a node in the adaptive quadrature tree."""
@@ -122,6 +156,8 @@ class AdaptiveGaussTree:
         """Recursively reconstructs the tree from a dictionary."""
         if data is None:
             return None
+        if "leaf_depths" in data:
+            data = expand_compact_tree(data)
         node = self.Node(
             a=data["a"], 
             b=data["b"], 
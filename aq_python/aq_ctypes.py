@@ -0,0 +1,213 @@
+import ctypes
+import os
+import numpy as np
+
+# Thin wrapper of the C interface of the C++ engine (aq_cpp/include/aq_c_api.h), loaded from bin/libaq.so
+# (`make lib` in aq_cpp) or from the path in the AQ_LIB environment variable.
+
+_here = os.path.dirname(os.path.abspath(__file__))
+_model_json = os.path.join(_here, '..', 'model_json')
+
+API_VERSION = 2
+
+# void f(const double* x, size_t n, const double* params, size_t n_params, double* out, void* user_data)
+integrand_type = ctypes.CFUNCTYPE(None, ctypes.POINTER(ctypes.c_double), ctypes.c_size_t, ctypes.POINTER(ctypes.c_double),
+                                  ctypes.c_size_t, ctypes.POINTER(ctypes.c_double), ctypes.c_void_p)
+
+
+class Settings(ctypes.Structure):
+    _fields_ = [('lower', ctypes.c_double), ('upper', ctypes.c_double), ('tol', ctypes.c_double),
+                ('min_depth', ctypes.c_int), ('max_depth', ctypes.c_int), ('n1', ctypes.c_int), ('n2', ctypes.c_int),
+                ('alpha_a', ctypes.c_double), ('alpha_b', ctypes.c_double),
+                ('a_singular', ctypes.c_int), ('b_singular', ctypes.c_int),
+                ('legendre_file', ctypes.c_char_p), ('laguerre_file', ctypes.c_char_p)]
+
+
+def _load_library(path=None):
+    path = path or os.environ.get('AQ_LIB') or os.path.join(_here, '..', 'aq_cpp', 'bin', 'libaq.so')
+    lib = ctypes.CDLL(path)
+    double_p = ctypes.POINTER(ctypes.c_double)
+    strings = ctypes.POINTER(ctypes.c_char_p)
+    ints = ctypes.POINTER(ctypes.c_int)
+    sizes = ctypes.POINTER(ctypes.c_size_t)
+    signatures = {
+        'aq_api_version': (ctypes.c_int, []),
+        'aq_last_error': (ctypes.c_char_p, []),
+        'aq_default_settings': (Settings, []),
+        'aq_batch_build_grid': (ctypes.c_void_p, [ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(Settings),
+                                                  ctypes.c_size_t, strings, ints, sizes, ctypes.POINTER(double_p)]),
+        'aq_batch_build': (ctypes.c_void_p, [ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(Settings),
+                                             ctypes.c_size_t, strings, ints, ctypes.c_size_t, double_p]),
+        'aq_batch_load': (ctypes.c_void_p, [ctypes.c_char_p]),
+        'aq_batch_save': (ctypes.c_int, [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]),
+        'aq_batch_free': (None, [ctypes.c_void_p]),
+        'aq_batch_size': (ctypes.c_size_t, [ctypes.c_void_p]),
+        'aq_batch_key_count': (ctypes.c_size_t, [ctypes.c_void_p]),
+        'aq_batch_key': (ctypes.c_char_p, [ctypes.c_void_p, ctypes.c_size_t]),
+        'aq_batch_lookup': (ctypes.c_int, [ctypes.c_void_p, ctypes.c_size_t, strings, ints, ctypes.c_size_t,
+                                           double_p, double_p, double_p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    if lib.aq_api_version() != API_VERSION:
+        raise RuntimeError(f"{path} implements C API version {lib.aq_api_version()}, expected {API_VERSION}.")
+    return lib
+
+
+_lib = None
+
+
+def library():
+    """The loaded libaq, loaded on first use."""
+    global _lib
+    if _lib is None:
+        _lib = _load_library()
+    return _lib
+
+
+def _check(ok):
+    """Raises the message of the failed call unless `ok` (a handle that is not NULL, or a status of 0)."""
+    if not ok:
+        raise RuntimeError(library().aq_last_error().decode())
+
+
+def _doubles(array):
+    """C-contiguous float64 view of `array` (no copy if it already is one) and its data pointer."""
+    array = np.ascontiguousarray(array, dtype=np.float64)
+    return array, array.ctypes.data_as(ctypes.POINTER(ctypes.c_double))
+
+
+def _keys(keys, int_keys):
+    keys = list(keys)
+    names = (ctypes.c_char_p * len(keys))(*[key.encode() for key in keys])
+    is_int = (ctypes.c_int * len(keys))(*[key in int_keys for key in keys])
+    return keys, names, is_int
+
+
+class _Integrand:
+    """C function pointer of `func`: a Python callable func(x, params) called once per rule with x the array of its
+    points and params the parameter values (NumPy views, no copy), returning f at every point (an array of x's shape,
+    or anything NumPy broadcasts to it); or the address of a compiled one with the C signature, e.g. numba's
+    cfunc(...).address.
+
+    An exception cannot cross the C++ engine, so the first one the callable raises is kept, that call and all later
+    ones give NaN, and check() re-raises it once the build is back in Python."""
+
+    def __init__(self, func):
+        self.error = None
+        if isinstance(func, int):
+            self.address, self._callback = func, None
+            return
+
+        def call(x, n, params, n_params, out, user_data):
+            values = np.ctypeslib.as_array(out, shape=(n,))
+            if self.error is not None:
+                values[:] = np.nan
+                return
+            try:
+                values[:] = func(np.ctypeslib.as_array(x, shape=(n,)), np.ctypeslib.as_array(params, shape=(n_params,)))
+            except BaseException as error:
+                self.error = error
+                values[:] = np.nan
+        self._callback = integrand_type(call)   # must live until the build returns
+        self.address = ctypes.cast(self._callback, ctypes.c_void_p).value
+
+    def check(self, handle):
+        """`handle` (the batch the build returned) unless the callable raised: then the batch is freed and the
+        exception raised again."""
+        if self.error is not None:
+            if handle:
+                library().aq_batch_free(handle)
+            raise self.error
+        return handle
+
+
+def settings(lower=0.0, upper=1.0, tol=1e-12, min_depth=2, max_depth=20, n1=100, n2=150, alpha_a=0.0, alpha_b=0.0,
+             a_singular=False, b_singular=False, legendre_file=None, laguerre_file=None):
+    """Build settings; the root tables default to model_json/legendre.json and laguerre.json of this repository."""
+    legendre_file = legendre_file or os.path.join(_model_json, 'legendre.json')
+    laguerre_file = laguerre_file or os.path.join(_model_json, 'laguerre.json')
+    return Settings(lower, upper, tol, min_depth, max_depth, n1, n2, alpha_a, alpha_b, int(a_singular),
+                    int(b_singular), legendre_file.encode(), laguerre_file.encode())
+
+
+class Batch:
+    """A batch of trees held by the C++ engine.
+
+    Parameters are passed as NumPy arrays, one column per key in the order of `keys`; keys in `int_keys` are int
+    parameters.  The integrand is called as func(x, params), x the array of the points of one rule, with params in
+    that same order."""
+
+    def __init__(self, handle):
+        _check(handle)
+        self._handle = ctypes.c_void_p(handle)
+
+    def __del__(self):
+        if getattr(self, '_handle', None) and _lib is not None:
+            _lib.aq_batch_free(self._handle)
+            self._handle = None
+
+    @classmethod
+    def build_grid(cls, func, parameters, int_keys=(), **kwargs):
+        """One tree per combination of parameters {key: values}; kwargs are those of settings()."""
+        keys, names, is_int = _keys(parameters.keys(), int_keys)
+        columns = [_doubles(parameters[key]) for key in keys]
+        n_values = (ctypes.c_size_t * len(keys))(*[len(array) for array, _ in columns])
+        values = (ctypes.POINTER(ctypes.c_double) * len(keys))(*[pointer for _, pointer in columns])
+        integrand = _Integrand(func)
+        s = settings(**kwargs)
+        handle = library().aq_batch_build_grid(integrand.address, None, ctypes.byref(s), len(keys), names, is_int,
+                                               n_values, values)
+        return cls(integrand.check(handle))
+
+    @classmethod
+    def build(cls, func, keys, combinations, int_keys=(), **kwargs):
+        """One tree per row of `combinations` (n x len(keys)); kwargs are those of settings()."""
+        keys, names, is_int = _keys(keys, int_keys)
+        combinations, pointer = _doubles(combinations)
+        if combinations.ndim != 2 or combinations.shape[1] != len(keys):
+            raise ValueError(f"combinations must have shape (n, {len(keys)}).")
+        integrand = _Integrand(func)
+        s = settings(**kwargs)
+        handle = library().aq_batch_build(integrand.address, None, ctypes.byref(s), len(keys), names, is_int,
+                                          combinations.shape[0], pointer)
+        return cls(integrand.check(handle))
+
+    @classmethod
+    def load(cls, filename):
+        """Batch file of the C++ engine (plain, compact or log)."""
+        return cls(library().aq_batch_load(os.fspath(filename).encode()))
+
+    def save(self, filename, compact=False):
+        _check(library().aq_batch_save(self._handle, os.fspath(filename).encode(), int(compact)) == 0)
+
+    def keys(self):
+        """Parameter names of the trees, sorted."""
+        return [library().aq_batch_key(self._handle, k).decode()
+                for k in range(library().aq_batch_key_count(self._handle))]
+
+    def __len__(self):
+        return library().aq_batch_size(self._handle)
+
+    def lookup(self, keys, combinations, int_keys=(), integrals=None, errors=None):
+        """Integrals and errors of the trees of the rows of `combinations` (n x len(keys)), NaN where the batch has
+        no tree.  They are written into `integrals` and `errors` if given (float64, C-contiguous, length n)."""
+        keys, names, is_int = _keys(keys, int_keys)
+        combinations, pointer = _doubles(np.reshape(combinations, (-1, len(keys))) if np.ndim(combinations) < 2
+                                         else combinations)
+        if combinations.shape[1] != len(keys):
+            raise ValueError(f"combinations must have shape (n, {len(keys)}).")
+        n = combinations.shape[0]
+        outputs = []
+        for output in (integrals, errors):
+            if output is None:
+                output = np.empty(n)
+            elif output.dtype != np.float64 or not output.flags.c_contiguous or output.shape != (n,):
+                raise ValueError(f"outputs must be C-contiguous float64 arrays of length {n}.")
+            outputs.append(output)
+        _check(library().aq_batch_lookup(self._handle, len(keys), names, is_int, n, pointer,
+                                         *[output.ctypes.data_as(ctypes.POINTER(ctypes.c_double))
+                                           for output in outputs]) == 0)
+        return outputs[0], outputs[1]